@@ -33,6 +33,11 @@
 #  endif
 #else /* !(USE_ZLIB || CRC_TABLE_ONLY) */
    ulg      crc32           OF((ulg crc, const uch *buf, extent len));
+   ulg      crc32_combine   OF((ulg crc1, ulg crc2, zoff_t len2));
+#  ifdef IZ_CRC_SLICE16
+   ulg      crc32_slice16   OF((ulg crc, const uch *buf, extent len));
+   const char *crc32_engine OF((void));
+#  endif
 #endif /* ?(USE_ZLIB || CRC_TABLE_ONLY) */
 
 #ifndef CRC_32_TAB
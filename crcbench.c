@@ -0,0 +1,113 @@
+/*
+  Copyright (c) 1990-2009 Info-ZIP.  All rights reserved.
+
+  See the accompanying file LICENSE, version 2009-Jan-02 or later
+  (the contents of which are also included in unzip.h) for terms of use.
+  If, for some reason, all these files are missing, the Info-ZIP license
+  also may be found at:  ftp://ftp.info-zip.org/pub/infozip/license.html
+*/
+/*---------------------------------------------------------------------------
+
+  crcbench.c
+
+  Microbenchmark for crc32():  runs the same data through the original
+  byte-at-a-time table loop and through each of the kernels in crc32.c,
+  one 64K window (WSIZE, what flush() hands over) at a time, checks that
+  they agree and prints their speed; crc32_combine() is checked as well.
+  Run by "meson test --benchmark"; an optional argument gives the megabytes
+  to do per kernel (default 256).
+
+  Contains:  bytewise()
+             timeit()
+             main()
+
+  ---------------------------------------------------------------------------*/
+
+
+#include "zip.h"
+#include "crc32.h"
+#include <time.h>
+
+#define WINDOW  65536           /* bytes per crc32() call */
+
+
+
+/*************************/
+/*  Function bytewise()  */
+/*************************/
+
+static ulg bytewise(ulg crc, const uch *buf, extent len)
+{
+    const ulg *crc_32_tab = get_crc_table();
+    z_uint4 c = (REV_BE((z_uint4)crc) ^ 0xffffffffL);
+
+    while (len--)
+        c = CRC32(c, *buf++, crc_32_tab);
+    return REV_BE(c) ^ 0xffffffffL;
+}
+
+
+
+/***********************/
+/*  Function timeit()  */
+/***********************/
+
+static ulg timeit(const char *name, ulg (*kernel)(ulg, const uch *, extent),
+                  const uch *buf, ulg windows)
+{
+    struct timespec t0, t1;
+    ulg crc = 0L, n;
+    double secs;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (n = 0;  n < windows;  ++n)
+        crc = (*kernel)(crc, buf + (n & 7), WINDOW);   /* (vary alignment) */
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("%-10s %08lx  %8.1f MB/s\n", name, crc,
+           windows * (WINDOW / 1048576.0) / (secs > 0 ? secs : 1e-9));
+    return crc;
+}
+
+
+
+/*********************/
+/*  Function main()  */
+/*********************/
+
+int main(int argc, char **argv)
+{
+    static uch buf[WINDOW + 8];
+    ulg seed = 1L, windows, crc;
+    int i, bad = 0;
+
+    windows = (argc > 1 ? strtoul(argv[1], NULL, 10) : 256L) *
+              (1048576L / WINDOW);
+    if (windows == 0)
+        windows = 1;
+    for (i = 0;  i < (int)sizeof(buf);  ++i) {
+        seed = seed * 1103515245L + 12345L;
+        buf[i] = (uch)(seed >> 16);
+    }
+
+    /* known answer first:  CRC-32 of "123456789", also put together
+     * from two pieces */
+    if (crc32(0L, (const uch *)"123456789", 9) != 0xcbf43926L ||
+        crc32_combine(crc32(0L, (const uch *)"1234", 4),
+                      crc32(0L, (const uch *)"56789", 5), 5) != 0xcbf43926L)
+    {
+        fprintf(stderr, "crc32() gives the wrong check value\n");
+        return 1;
+    }
+
+    crc = timeit("bytewise", bytewise, buf, windows);
+#ifdef IZ_CRC_SLICE16
+    bad |= (timeit("slice16", crc32_slice16, buf, windows) != crc);
+    bad |= (timeit(crc32_engine(), crc32, buf, windows) != crc);
+#else
+    bad |= (timeit("crc32", crc32, buf, windows) != crc);
+#endif
+    if (bad)
+        fprintf(stderr, "kernels disagree\n");
+    return bad;
+}
@@ -345,6 +345,13 @@ explode_lit (
           }
           else                  /* do it slow to avoid memcpy() overlap */
 #endif /* !NOMEMCPY */
+          if (redirSlack)       /* (but not byte by byte) */
+          {
+            copy_match(redirSlide + w, redirSlide + d, e);
+            w += e;
+            d += e;
+          }
+          else
             do {
               redirSlide[w++] = redirSlide[d++];
             } while (--e);
@@ -467,6 +474,13 @@ explode_nolit (
           }
           else                  /* do it slow to avoid memcpy() overlap */
 #endif /* !NOMEMCPY */
+          if (redirSlack)       /* (but not byte by byte) */
+          {
+            copy_match(redirSlide + w, redirSlide + d, e);
+            w += e;
+            d += e;
+          }
+          else
             do {
               redirSlide[w++] = redirSlide[d++];
             } while (--e);
@@ -0,0 +1,283 @@
+/*
+  Copyright (c) 1990-2009 Info-ZIP.  All rights reserved.
+
+  See the accompanying file LICENSE, version 2009-Jan-02 or later
+  (the contents of which are also included in unzip.h) for terms of use.
+  If, for some reason, all these files are missing, the Info-ZIP license
+  also may be found at:  ftp://ftp.info-zip.org/pub/infozip/license.html
+*/
+/*---------------------------------------------------------------------------
+
+  extinfl.c
+
+  Inflating by a library instead of by inflate.c, chosen at build time
+  (meson option "inflate"):  zlib's inflateBack() (EXT_INFLATE_ZLIB), the
+  same in zlib-ng's native interface (EXT_INFLATE_ZLIBNG), or libdeflate
+  (EXT_INFLATE_LIBDEFLATE), which does a whole member in one call.  The
+  built-in inflate() is always there as well:  ext_inflate() declines
+  Deflate64 members, which none of the libraries can do, and whatever
+  does not suit libdeflate, and the environment variable UNZIP_INFLATE
+  set to "builtin" makes it decline everything, for comparison.  Unlike
+  USE_ZLIB, this leaves the CRC-32 code alone.
+
+  Contains:  ext_inflate_name()
+             inbackCB()               (zlib or zlib-ng only)
+             outbackCB()              (zlib or zlib-ng only)
+             ext_inflate()
+
+  ---------------------------------------------------------------------------*/
+
+
+#define __EXTINFL_C     /* identifies this source module */
+#define UNZIP_INTERNAL
+#include "unzip.h"
+
+#ifdef EXT_INFLATE
+
+#if (defined(EXT_INFLATE_ZLIB))
+#  define inflate zlib_inflate  /* not used; inflate() is inflate.c's here */
+#  include <zlib.h>
+#  undef inflate
+#  define z_stream_t        z_stream
+#  define z_inbackInit(s,w) inflateBackInit(s, 15, w)
+#  define z_inback          inflateBack
+#  define z_inbackEnd       inflateBackEnd
+#  define Z_INPTR           z_const unsigned char FAR * FAR *
+#  define Z_INCOUNT         unsigned
+#  define Z_OUTCOUNT        unsigned
+#elif (defined(EXT_INFLATE_ZLIBNG))
+#  include <zlib-ng.h>
+#  define z_stream_t        zng_stream
+#  define z_inbackInit(s,w) zng_inflateBackInit(s, 15, w)
+#  define z_inback          zng_inflateBack
+#  define z_inbackEnd       zng_inflateBackEnd
+#  define Z_INPTR           const uint8_t **
+#  define Z_INCOUNT         uint32_t
+#  define Z_OUTCOUNT        uint32_t
+#else /* EXT_INFLATE_LIBDEFLATE */
+#  include <libdeflate.h>
+#  ifndef EXT_INFLATE_BUDGET    /* largest member done in memory */
+#    define EXT_INFLATE_BUDGET  (256L << 20)
+#  endif
+#endif
+
+#ifndef EXT_INFLATE_LIBDEFLATE
+static Z_INCOUNT inbackCB OF((void *pG, Z_INPTR pInbuf));
+static int outbackCB OF((void *pG, unsigned char *outbuf,
+                         Z_OUTCOUNT outcnt));
+#endif
+
+
+
+/*********************************/
+/*  Function ext_inflate_name()  */
+/*********************************/
+
+const char *
+ext_inflate_name (void)         /* for unzip -v */
+{
+#if (defined(EXT_INFLATE_ZLIB))
+    return "zlib";
+#elif (defined(EXT_INFLATE_ZLIBNG))
+    return "zlib-ng";
+#else
+    return "libdeflate";
+#endif
+}
+
+
+
+#ifndef EXT_INFLATE_LIBDEFLATE
+
+/*************************/
+/*  Function inbackCB()  */
+/*************************/
+
+static Z_INCOUNT 
+inbackCB (void *pG, Z_INPTR pInbuf)
+{
+    Z_INCOUNT count = (Z_INCOUNT)fillinbuf(pG);
+
+    /* (refilling may move inbuf when the zipfile is memory-mapped) */
+    *pInbuf = (*(Uz_Globs *)pG).inbuf;
+    return count;
+}
+
+
+
+/**************************/
+/*  Function outbackCB()  */
+/**************************/
+
+static int 
+outbackCB (void *pG, unsigned char *outbuf, Z_OUTCOUNT outcnt)
+{
+    return flush((Uz_Globs *)pG, outbuf, (ulg)outcnt, 0);
+}
+
+#endif /* !EXT_INFLATE_LIBDEFLATE */
+
+
+
+
+/****************************/
+/*  Function ext_inflate()  */
+/****************************/
+
+int 
+ext_inflate (   /* returns as inflate() does, or -1 to leave it to that */
+    Uz_Globs *pG,
+    int is_defl64
+)
+{
+    char *p;
+#ifdef EXT_INFLATE_LIBDEFLATE
+    struct libdeflate_decompressor *d;
+    enum libdeflate_result lr;
+    zoff_t next, len;
+    uch *in, *inmem = NULL, *out;
+    size_t got;
+    ulg n, chunk;
+    int r, mapped = 0;
+#else
+    z_stream_t strm;
+    int err, retval = 0;
+#endif
+
+/*---------------------------------------------------------------------------
+    Called instead of inflate() for a member, with the input buffer set up
+    as inflate() would find it.  Returns -1, with nothing read or written,
+    if inflate() is to do it after all.
+  ---------------------------------------------------------------------------*/
+
+    if (is_defl64 || (*(Uz_Globs *)pG).mem_mode)
+        return -1;
+#if (defined(DLL) && !defined(NO_SLIDE_REDIR))
+    if ((*(Uz_Globs *)pG).redirect_slide)
+        return -1;
+#endif
+    if ((p = getenv("UNZIP_INFLATE")) != NULL && strcmp(p, "builtin") == 0)
+        return -1;
+
+#ifdef EXT_INFLATE_LIBDEFLATE
+/*---------------------------------------------------------------------------
+    libdeflate wants all of the data at once, and room for all of the
+    output:  take the data straight from the zipfile mapping if there is
+    one, else read it in, and inflate into the mapped outfile if there is
+    one, else into memory, as long as what is in memory (the output's
+    size is in the headers) keeps within EXT_INFLATE_BUDGET.  Encrypted
+    data cannot be taken from the zipfile as they are.  Should libdeflate
+    fail for any reason, inflate() goes over it again, to report the
+    trouble just as always.
+  ---------------------------------------------------------------------------*/
+
+#ifdef USE_MMAP_OUTPUT
+    mapped = (*(Uz_Globs *)pG).redirect_slide;      /* see map_outfile() */
+#endif
+    if ((*(Uz_Globs *)pG).pInfo->encrypted || (*(Uz_Globs *)pG).incnt < 0 ||
+        (*(Uz_Globs *)pG).lrec.ucsize == 0 ||
+        (!mapped && (*(Uz_Globs *)pG).lrec.ucsize > (zusz_t)EXT_INFLATE_BUDGET))
+        return -1;
+    len = (*(Uz_Globs *)pG).csize + (*(Uz_Globs *)pG).incnt;
+    next = (*(Uz_Globs *)pG).cur_zipfile_bufstart + (*(Uz_Globs *)pG).inbuf_len;
+    if ((*(Uz_Globs *)pG).csize == 0)       /* all in the input buffer */
+        in = (*(Uz_Globs *)pG).inptr;
+#ifdef USE_MMAP_INPUT
+    else if (zipmap_covers(pG, next, (*(Uz_Globs *)pG).csize))
+        in = (*(Uz_Globs *)pG).zipmap + (size_t)(next - (*(Uz_Globs *)pG).incnt);
+#endif
+    else {
+        if (len + (mapped ? 0 : (zoff_t)(*(Uz_Globs *)pG).lrec.ucsize) >
+            EXT_INFLATE_BUDGET ||
+            (inmem = (uch *)malloc((size_t)len)) == (uch *)NULL)
+            return -1;
+        memcpy(inmem, (*(Uz_Globs *)pG).inptr, (extent)(*(Uz_Globs *)pG).incnt);
+        for (n = (ulg)(*(Uz_Globs *)pG).incnt;  n < (ulg)len;  n += r) {
+            chunk = MIN((ulg)len - n, 0x40000000L);
+            if ((r = zipf_pread(pG, inmem + n, (unsigned)chunk,
+                                next + (zoff_t)n - (*(Uz_Globs *)pG).incnt)) <= 0)
+            {
+                free(inmem);
+                return -1;
+            }
+        }
+        in = inmem;
+    }
+
+#ifdef USE_MMAP_OUTPUT
+    if (mapped)
+        out = (*(Uz_Globs *)pG).redirect_buffer;
+    else
+#endif
+    out = (uch *)malloc((size_t)(*(Uz_Globs *)pG).lrec.ucsize);
+    if (out == (uch *)NULL || (d = libdeflate_alloc_decompressor()) == NULL) {
+        if (out != (uch *)NULL && !mapped)
+            free(out);
+        if (inmem != (uch *)NULL)
+            free(inmem);
+        return -1;
+    }
+    lr = libdeflate_deflate_decompress(d, in, (size_t)len, out,
+                                       (size_t)(*(Uz_Globs *)pG).lrec.ucsize, &got);
+    libdeflate_free_decompressor(d);
+    if (inmem != (uch *)NULL)
+        free(inmem);
+    if (lr != LIBDEFLATE_SUCCESS || got != (size_t)(*(Uz_Globs *)pG).lrec.ucsize) {
+        if (!mapped)
+            free(out);
+        return -1;
+    }
+
+    /* all of the data used up; the output goes the usual way from here
+     * (text conversion works a window at a time) */
+    (*(Uz_Globs *)pG).csize = 0;
+    (*(Uz_Globs *)pG).inptr += (*(Uz_Globs *)pG).incnt;
+    (*(Uz_Globs *)pG).incnt = 0;
+    r = 0;
+    for (n = 0;  n < (ulg)got && r == 0;  n += chunk) {
+        chunk = (*(Uz_Globs *)pG).pInfo->textmode ? MIN((ulg)got - n, WSIZE) :
+                                      (ulg)got - n;
+        r = flush(pG, out + n, chunk, 0);
+    }
+    if (!mapped)
+        free(out);
+    return r;
+
+#else /* !EXT_INFLATE_LIBDEFLATE */
+/*---------------------------------------------------------------------------
+    zlib's inflateBack() (or zlib-ng's) reads through fillinbuf() and
+    writes into slide[], which it hands to flush() when full; the same as
+    the USE_ZLIB code in inflate.c, less the Deflate64 part.
+  ---------------------------------------------------------------------------*/
+
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    if ((err = z_inbackInit(&strm, slide)) != Z_OK)
+        return (err == Z_MEM_ERROR) ? 3 : 2;
+
+    strm.next_in = (*(Uz_Globs *)pG).inptr;
+    strm.avail_in = (*(Uz_Globs *)pG).incnt > 0 ? (*(Uz_Globs *)pG).incnt : 0;
+    err = z_inback(&strm, inbackCB, pG, outbackCB, pG);
+    if (err != Z_STREAM_END) {
+        if (err == Z_MEM_ERROR)
+            retval = 3;
+        else if (err == Z_BUF_ERROR && strm.next_in != Z_NULL)
+            /* output write failure */
+            retval = ((*(Uz_Globs *)pG).disk_full != 0 ? PK_DISK : IZ_CTRLC);
+        else                    /* bad data, or ran out of them */
+            retval = 2;
+    }
+    if (strm.next_in != Z_NULL) {
+        (*(Uz_Globs *)pG).inptr = (uch *)strm.next_in;
+        (*(Uz_Globs *)pG).incnt = (int)strm.avail_in;
+    }
+    if (z_inbackEnd(&strm) != Z_OK && retval == 0)
+        retval = 2;
+    return retval;
+
+#endif /* ?EXT_INFLATE_LIBDEFLATE */
+
+} /* end function ext_inflate() */
+
+#endif /* EXT_INFLATE */
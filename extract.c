@@ -15,9 +15,26 @@
   explode.c, inflate.c, unreduce.c and unshrink.c.
 
   Contains:  extract_or_test_files()
+             grow_info()
              store_info()
              find_compr_idx()
+             asks_questions()         (USE_PARALLEL only)
+             offset_order()
              extract_or_test_entrylist()
+             parallel_threads()       (USE_PARALLEL only)
+             parallel_globs()         (USE_PARALLEL only)
+             free_parallel_globs()    (USE_PARALLEL only)
+             parallel_message()       (USE_PARALLEL only)
+             queue_start()            (USE_PARALLEL only)
+             queue_next()             (USE_PARALLEL only)
+             parallel_worker()        (USE_PARALLEL only)
+             output_key()             (USE_PARALLEL only)
+             chain_collisions()       (USE_PARALLEL only)
+             extract_parallel()       (USE_PARALLEL only)
+             crc_split()              (USE_PARALLEL only)
+             crc_thread()             (USE_PARALLEL only)
+             crc_join()               (USE_PARALLEL only)
+             copy_stored()            (USE_COPY_RANGE only)
              extract_or_test_member()
              TestExtraField()
              test_compr_eb()
@@ -27,6 +44,7 @@
              set_deferred_symlink()   (SYMLINKS only)
              fnfilter()
              dircomp()                (SET_DIR_ATTRIB only)
+             offsetcomp()
              UZbunzip2()              (USE_BZIP2 only)
 
   ---------------------------------------------------------------------------*/
@@ -84,17 +102,58 @@
     } \
 }
 
+static int grow_info OF((Uz_Globs *pG, unsigned need));
 static int store_info OF((Uz_Globs *pG));
+#ifdef USE_PARALLEL
+   static int asks_questions OF((Uz_Globs *pG, unsigned numchunk));
+#endif
+static int offset_order OF((Uz_Globs *pG, unsigned numchunk));
 #ifdef SET_DIR_ATTRIB
 static int extract_or_test_entrylist OF((Uz_Globs *pG, unsigned numchunk,
+                min_info **order,
                 ulg *pfilnum, ulg *pnum_bad_pwd, zoff_t *pold_extra_bytes,
                 unsigned *pnum_dirs, direntry **pdirlist,
                 int error_in_archive));
 #else
 static int extract_or_test_entrylist OF((Uz_Globs *pG, unsigned numchunk,
+                min_info **order,
                 ulg *pfilnum, ulg *pnum_bad_pwd, zoff_t *pold_extra_bytes,
                 int error_in_archive));
 #endif
+#ifdef USE_PARALLEL
+static unsigned parallel_threads OF((Uz_Globs *pG, unsigned numchunk));
+static Uz_Globs *parallel_globs OF((Uz_Globs *pG));
+static void free_parallel_globs OF((Uz_Globs *pG));
+static int UZ_EXP parallel_message OF((void *pG, uch *buf, ulg size,
+                int flag));
+typedef struct xqueue xqueue;
+static xqueue *queue_start OF((Uz_Globs *pG, unsigned numchunk));
+static void queue_next OF((Uz_Globs *pG, xqueue *queue, unsigned i));
+static void *parallel_worker OF((void *arg));
+static char *output_key OF((Uz_Globs *pG, const char *name));
+typedef struct xpool xpool;
+static int chain_collisions OF((Uz_Globs *pG, xpool *pool));
+#ifdef SET_DIR_ATTRIB
+static int extract_parallel OF((Uz_Globs *pG, unsigned numchunk,
+                unsigned nthreads, min_info **order,
+                ulg *pfilnum, ulg *pnum_bad_pwd, zoff_t *pold_extra_bytes,
+                unsigned *pnum_dirs, direntry **pdirlist,
+                int error_in_archive));
+#else
+static int extract_parallel OF((Uz_Globs *pG, unsigned numchunk,
+                unsigned nthreads, min_info **order,
+                ulg *pfilnum, ulg *pnum_bad_pwd, zoff_t *pold_extra_bytes,
+                int error_in_archive));
+#endif
+typedef struct crcpiece crcpiece;
+static unsigned crc_split OF((Uz_Globs *pG, crcpiece **ppieces));
+static void *crc_thread OF((void *arg));
+static void crc_join OF((Uz_Globs *pG, crcpiece *pieces, unsigned npieces,
+                uch *buf, unsigned bufsize));
+#endif /* USE_PARALLEL */
+#ifdef USE_COPY_RANGE
+static int copy_stored OF((Uz_Globs *pG, uch *buf, unsigned bufsize));
+#endif
 static int extract_or_test_member OF((Uz_Globs *pG));
    static int TestExtraField OF((Uz_Globs *pG, uch *ef, unsigned ef_len));
    static int test_compr_eb OF((Uz_Globs *pG, uch *eb, unsigned eb_size,
@@ -111,6 +170,10 @@ static int extract_or_test_member OF((Uz_Globs *pG));
 #ifdef SET_DIR_ATTRIB
    static int Cdecl dircomp OF((const void *a, const void *b));
 #endif
+static int Cdecl offsetcomp OF((const void *a, const void *b));
+#ifdef USE_PARALLEL
+   static int Cdecl keycomp OF((const void *a, const void *b));
+#endif
 
 
 
@@ -264,6 +327,10 @@ static const char Inflate[] = "inflate";
 static const char FileUnknownCompMethod[] =
   "%s:  unknown compression method\n";
 static const char BadCRC[] = " bad CRC %08lx  (should be %08lx)\n";
+#ifdef USE_MMAP_INPUT
+   static const char ZipfileShrunk[] =
+     " zipfile read error (zipfile truncated while being read)\n";
+#endif
 
       /* TruncEAs[] also used in OS/2 mapname(), close_outfile() */
 char const TruncEAs[] = " compressed EA data missing (%d bytes)%s";
@@ -306,13 +373,20 @@ int extract_or_test_files(pG)    /* return PK-type error code */
 {
     unsigned i, j;
     zoff_t cd_bufstart;
-    uch *cd_inptr;
+    unsigned cd_inoff;
     int cd_incnt;
-    ulg filnum=0L, blknum=0L;
+    unsigned cd_inlen;
+    ulg filnum=0L;
     int reached_end;
     int no_endsig_found;
     int error, error_in_archive=PK_COOL;
     int *fn_matched=NULL, *xn_matched=NULL;
+    min_info **order=(min_info **)NULL;
+    unsigned order_max=0;
+    int sorted;
+#ifdef USE_PARALLEL
+    unsigned nthreads;
+#endif
     zucn_t members_processed;
     ulg num_skipped=0L, num_bad_pwd=0L;
     zoff_t old_extra_bytes = 0L;
@@ -343,7 +417,8 @@ int extract_or_test_files(pG)    /* return PK-type error code */
     this would lead to a whole lot of disk-grinding, especially if each mem-
     ber file is small.  Instead, we read from the central directory the per-
     tinent information for a block of files, then go extract/test the whole
-    block.  Thus this routine contains two small(er) loops within a very
+    block.  (The block is the whole central directory if info[] can be grown
+    to hold it, up to DIR_MAXENTRIES entries.)  Thus this routine contains two small(er) loops within a very
     large outer loop:  the first of the small ones reads a block of files
     from the central directory; the second extracts or tests each file; and
     the outer one loops over blocks.  There's some file-pointer positioning
@@ -353,8 +428,6 @@ int extract_or_test_files(pG)    /* return PK-type error code */
     since we know the offset of each from the beginning of the zipfile.
   ---------------------------------------------------------------------------*/
 
-    (*(Uz_Globs *)pG).pInfo = (*(Uz_Globs *)pG).info;
-
     (*(Uz_Globs *)pG).reported_backslash = FALSE;
 
     /* malloc space for check on unmatched filespecs (OK if one or both NULL) */
@@ -388,7 +461,14 @@ int extract_or_test_files(pG)    /* return PK-type error code */
          * size is reached.
          */
 
-        while ((j < DIR_BLKSIZ)) {
+        for (;;) {
+            if (j >= (*(Uz_Globs *)pG).info_max && !grow_info(pG, j + 1)) {
+                if (j == 0) {           /* not even room to start a block */
+                    error_in_archive = PK_MEM;
+                    reached_end = TRUE;
+                }
+                break;                  /* do this block, then the next */
+            }
             (*(Uz_Globs *)pG).pInfo = &(*(Uz_Globs *)pG).info[j];
 
             if (readbuf(pG, (*(Uz_Globs *)pG).sig, 4) == 0) {
@@ -419,7 +499,7 @@ int extract_or_test_files(pG)    /* return PK-type error code */
                      * -> report it and stop searching for more Zip entries
                      */
                     Info(slide, 0x401, ((char *)slide,
-                      LoadFarString(CentSigMsg), j + blknum*DIR_BLKSIZ + 1));
+                      LoadFarString(CentSigMsg), j + filnum + 1));
                     Info(slide, 0x401, ((char *)slide,
                       LoadFarString(ReportMsg)));
                     error_in_archive = PK_BADERR;
@@ -521,15 +601,50 @@ int extract_or_test_files(pG)    /* return PK-type error code */
 
         /* save position in central directory so can come back later */
         cd_bufstart = (*(Uz_Globs *)pG).cur_zipfile_bufstart;
-        cd_inptr = (*(Uz_Globs *)pG).inptr;
+        cd_inlen = (*(Uz_Globs *)pG).inbuf_len;
+        cd_inoff = (unsigned)((*(Uz_Globs *)pG).inptr - (*(Uz_Globs *)pG).inbuf);
         cd_incnt = (*(Uz_Globs *)pG).incnt;
 
+        /* visit the members in the order they are stored in the zipfile,
+         * rather than in central-directory order, if that is wanted */
+        sorted = (j > 1 && offset_order(pG, j));
+        if (sorted && order_max < j) {
+            if (order)
+                free((void *)order);
+            order_max = (*(Uz_Globs *)pG).info_max;
+            if ((order = (min_info **)malloc(order_max*sizeof(min_info *)))
+                == (min_info **)NULL) {
+                order_max = 0;
+                sorted = FALSE; /* no harm done, just slower */
+            }
+        }
+        if (sorted) {
+            for (i = 0;  i < j;  ++i)
+                order[i] = &(*(Uz_Globs *)pG).info[i];
+            qsort((char *)order, j, sizeof(min_info *), offsetcomp);
+            for (i = 0;  i < j && order[i] == &(*(Uz_Globs *)pG).info[i];  ++i)
+                ;
+            sorted = (i < j);   /* (no need to if it is in order already) */
+        }
+
     /*-----------------------------------------------------------------------
         Second loop:  process files in current block, extracting or testing
         each one.
       -----------------------------------------------------------------------*/
 
+#ifdef USE_PARALLEL
+        if ((nthreads = parallel_threads(pG, j)) > 1)
+            error = extract_parallel(pG, j, nthreads,
+                        sorted? order : (min_info **)NULL,
+                        &filnum, &num_bad_pwd, &old_extra_bytes,
+#ifdef SET_DIR_ATTRIB
+                        &num_dirs, &dirlist,
+#endif
+                        error_in_archive);
+        else
+#endif
         error = extract_or_test_entrylist(pG, j,
+                        sorted? order : (min_info **)NULL,
                         &filnum, &num_bad_pwd, &old_extra_bytes,
 #ifdef SET_DIR_ATTRIB
                         &num_dirs, &dirlist,
@@ -553,12 +668,13 @@ int extract_or_test_files(pG)    /* return PK-type error code */
          * the next batch of files.
          */
 
-        zfseeko((*(Uz_Globs *)pG).zipfd, cd_bufstart, SEEK_SET);
-        (*(Uz_Globs *)pG).cur_zipfile_bufstart = zftello((*(Uz_Globs *)pG).zipfd);
-        read((*(Uz_Globs *)pG).zipfd, (char *)(*(Uz_Globs *)pG).inbuf, INBUFSIZ);  /* been here before... */
-        (*(Uz_Globs *)pG).inptr = cd_inptr;
+#ifdef USE_IO_URING
+        drop_readahead(pG);     /* (reads of this block left unused) */
+#endif
+        fill_inbuf_at(pG, cd_bufstart, cd_inlen);  /* been here before... */
+        /* (inbuf may have moved, so restore inptr relative to it) */
+        (*(Uz_Globs *)pG).inptr = (*(Uz_Globs *)pG).inbuf + cd_inoff;
         (*(Uz_Globs *)pG).incnt = cd_incnt;
-        ++blknum;
 
 #ifdef TEST
         printf("\ncd_bufstart = %ld (%.8lXh)\n", cd_bufstart, cd_bufstart);
@@ -676,6 +792,8 @@ int extract_or_test_files(pG)    /* return PK-type error code */
                   LoadFarString(ExclFilenameNotMatched), (*(Uz_Globs *)pG).pxnames[i]));
         free((void *)xn_matched);
     }
+    if (order)
+        free((void *)order);
 
 /*---------------------------------------------------------------------------
     Now, all locally allocated memory has been released.  When the central
@@ -741,6 +859,56 @@ int extract_or_test_files(pG)    /* return PK-type error code */
 
 
 
+/**************************/
+/*  Function grow_info()  */
+/**************************/
+
+static int
+grow_info (   /* return 0 if info[] cannot hold need entries */
+    Uz_Globs *pG,
+    unsigned need
+)
+{
+    unsigned n = (*(Uz_Globs *)pG).info_max;
+    zucn_t entries;
+    min_info *p;
+
+    if (need > DIR_MAXENTRIES)
+        return FALSE;
+
+    /* first time:  make room for the whole central directory at once, as
+     * far as the end record's count of entries is believable; the zipfile
+     * cannot hold more entries than fit in it */
+    entries = (*(Uz_Globs *)pG).ecrec.total_entries_central_dir;
+    if ((zoff_t)entries > (*(Uz_Globs *)pG).ziplen / (CREC_SIZE+4))
+        entries = (zucn_t)((*(Uz_Globs *)pG).ziplen / (CREC_SIZE+4));
+    if (n == 0 && entries <= DIR_MAXENTRIES)
+        n = (unsigned)entries;
+    if (n < 64)
+        n = 64;
+    while (n < need)            /* more entries than the end record said */
+        n = (n > DIR_MAXENTRIES/2)? DIR_MAXENTRIES : 2*n;
+
+    p = (min_info *)realloc((*(Uz_Globs *)pG).info, n*sizeof(min_info));
+    if (p == (min_info *)NULL && n > need) {
+        n = need;               /* count was bogus, or memory is short */
+        p = (min_info *)realloc((*(Uz_Globs *)pG).info, n*sizeof(min_info));
+    }
+    if (p == (min_info *)NULL)
+        return FALSE;           /* old table still intact */
+
+    memzero(p + (*(Uz_Globs *)pG).info_max,
+            (n - (*(Uz_Globs *)pG).info_max)*sizeof(min_info));
+    (*(Uz_Globs *)pG).info = p;
+    (*(Uz_Globs *)pG).info_max = n;
+    return TRUE;
+
+} /* end function grow_info() */
+
+
+
+
+
 /***************************/
 /*  Function store_info()  */
 /***************************/
@@ -900,11 +1068,67 @@ find_compr_idx (unsigned compr_methodnum)
 
 
 
+#ifdef USE_PARALLEL
+
+/*******************************/
+/*  Function asks_questions()  */
+/*******************************/
+
+static int asks_questions(pG, numchunk)  /* return TRUE if block may prompt */
+    Uz_Globs *pG;
+    unsigned numchunk;
+{
+    unsigned i;
+
+    if (uO.tflag || uO.cflag || IS_OVERWRT_ALL)
+        return FALSE;
+    if (!IS_OVERWRT_NONE)
+        return TRUE;
+    for (i = 0;  i < numchunk;  ++i)    /* -n still asks about VMS files */
+        if ((*(Uz_Globs *)pG).info[i].hostnum == VMS_)
+            return TRUE;
+    return FALSE;
+
+} /* end function asks_questions() */
+
+#endif /* USE_PARALLEL */
+
+
+
+
+
+/*****************************/
+/*  Function offset_order()  */
+/*****************************/
+
+static int offset_order(pG, numchunk)   /* return TRUE to sort the block */
+    Uz_Globs *pG;
+    unsigned numchunk;
+{
+    /* never with -c or -p:  what goes to the one output stream stays in
+     * central-directory order; nor if the first member in that order must
+     * tell whether the offsets need correcting (see AttemptRecompensate) */
+    if (uO.cflag || uO.G_flag < 0 || (*(Uz_Globs *)pG).extra_bytes != 0)
+        return FALSE;
+    if (uO.G_flag > 0)
+        return TRUE;
+#ifdef USE_PARALLEL
+    /* by default only where there are no prompts, whose answers cannot
+     * wait:  then the messages are kept for central-directory order */
+    return !asks_questions(pG, numchunk);
+#else
+    return FALSE;
+#endif
+
+} /* end function offset_order() */
+
+
+
 /******************************************/
 /*  Function extract_or_test_entrylist()  */
 /******************************************/
 
-static int extract_or_test_entrylist(pG, numchunk,
+static int extract_or_test_entrylist(pG, numchunk, order,
                 pfilnum, pnum_bad_pwd, pold_extra_bytes,
 #ifdef SET_DIR_ATTRIB
                 pnum_dirs, pdirlist,
@@ -912,6 +1136,7 @@ static int extract_or_test_entrylist(pG, numchunk,
                 error_in_archive)    /* return PK-type error code */
     Uz_Globs *pG;
     unsigned numchunk;
+    min_info **order;   /* info[] in processing order, or NULL:  as is */
     ulg *pfilnum;
     ulg *pnum_bad_pwd;
     zoff_t *pold_extra_bytes;
@@ -921,25 +1146,67 @@ static int extract_or_test_entrylist(pG, numchunk,
 #endif
     int error_in_archive;
 {
-    unsigned i;
+    unsigned i, k;
+    ulg filnum0 = *pfilnum;
     int renamed, query;
     int skip_entry;
     zoff_t bufstart, inbuf_offset, request;
     int error, errcode;
+#ifdef USE_PARALLEL
+    xqueue *queue = (xqueue *)NULL;
+#endif
+#ifdef USE_IO_URING
+    unsigned ra_next = 0;       /* next member to queue a read-ahead for */
+    min_info *ra_info;
+    zoff_t ra_start;
+#endif
 
 /* possible values for local skip_entry flag: */
 #define SKIP_NO         0       /* do not skip this entry */
 #define SKIP_Y_EXISTING 1       /* skip this entry, do not overwrite file */
 #define SKIP_Y_NONEXIST 2       /* skip this entry, do not create new file */
 
+#ifdef USE_PARALLEL
+    /* members in zipfile order, where nothing prompts:  their messages are
+     * kept and printed in central-directory order, as if they were done in
+     * that order (and if there is no memory for that, they are) */
+    if (order != (min_info **)NULL && numchunk > 1 &&
+        !asks_questions(pG, numchunk) &&
+        (queue = queue_start(pG, numchunk)) == (xqueue *)NULL)
+        order = (min_info **)NULL;
+#endif
+
     /*-----------------------------------------------------------------------
         Second loop:  process files in current block, extracting or testing
         each one.
       -----------------------------------------------------------------------*/
 
-    for (i = 0; i < numchunk; ++i) {
-        (*pfilnum)++;   /* *pfilnum = i + blknum*DIR_BLKSIZ + 1; */
+    for (k = 0; k < numchunk; ++k) {
+        /* (numbered in central-directory order either way) */
+        i = (order != (min_info **)NULL)?
+            (unsigned)(order[k] - (*(Uz_Globs *)pG).info) : k;
+        *pfilnum = filnum0 + i + 1;
         (*(Uz_Globs *)pG).pInfo = &(*(Uz_Globs *)pG).info[i];
+#ifdef USE_PARALLEL
+        queue_next(pG, queue, i);
+#endif
+
+#ifdef USE_IO_URING
+        /* get the local headers and data of the next members read while
+         * this one is being processed (the end is a guess:  the local
+         * filename and extra field are not known yet) */
+        if (ra_next < k)
+            ra_next = k;
+        for (;  ra_next < numchunk;  ++ra_next) {
+            ra_info = (order != (min_info **)NULL)? order[ra_next] :
+                      &(*(Uz_Globs *)pG).info[ra_next];
+            ra_start = ra_info->offset + (*(Uz_Globs *)pG).extra_bytes;
+            if (!queue_readahead(pG, ra_start, ra_start + LREC_SIZE + 4 +
+                                 (zoff_t)ra_info->compr_size + INBUFSIZ))
+                break;
+        }
+        submit_readahead(pG);
+#endif
 
         /* if the target position is not within the current input buffer
          * (either haven't yet read far enough, or (maybe) skipping back-
@@ -988,11 +1255,11 @@ static int extract_or_test_entrylist(pG, numchunk,
             }
         }
 
-        if (bufstart != (*(Uz_Globs *)pG).cur_zipfile_bufstart) {
-            Trace((stderr, "debug: bufstart != cur_zipfile_bufstart\n"));
-            zfseeko((*(Uz_Globs *)pG).zipfd, bufstart, SEEK_SET);
-            (*(Uz_Globs *)pG).cur_zipfile_bufstart = zftello((*(Uz_Globs *)pG).zipfd);
-            if (((*(Uz_Globs *)pG).incnt = read((*(Uz_Globs *)pG).zipfd, (char *)(*(Uz_Globs *)pG).inbuf, INBUFSIZ)) <= 0)
+        if (request < (*(Uz_Globs *)pG).cur_zipfile_bufstart ||
+            request - (*(Uz_Globs *)pG).cur_zipfile_bufstart >=
+            (zoff_t)(*(Uz_Globs *)pG).inbuf_len) {
+            Trace((stderr, "debug: request not within current inbuf\n"));
+            if (fill_inbuf_at(pG, bufstart, (*(Uz_Globs *)pG).inbufsiz) <= 0)
             {
                 Info(slide, 0x401, ((char *)slide, LoadFarString(OffsetMsg),
                   *pfilnum, "lseek", (long)bufstart));
@@ -1002,6 +1269,7 @@ static int extract_or_test_entrylist(pG, numchunk,
             (*(Uz_Globs *)pG).inptr = (*(Uz_Globs *)pG).inbuf + (int)inbuf_offset;
             (*(Uz_Globs *)pG).incnt -= (int)inbuf_offset;
         } else {
+            inbuf_offset = request - (*(Uz_Globs *)pG).cur_zipfile_bufstart;
             (*(Uz_Globs *)pG).incnt += (int)((*(Uz_Globs *)pG).inptr-(*(Uz_Globs *)pG).inbuf) - (int)inbuf_offset;
             (*(Uz_Globs *)pG).inptr = (*(Uz_Globs *)pG).inbuf + (int)inbuf_offset;
         }
@@ -1415,6 +1683,9 @@ reprompt:
         if (((*(Uz_Globs *)pG).statreportcb != NULL) &&
             (*(*(Uz_Globs *)pG).statreportcb)(pG, UZ_ST_START_EXTRACT, (*(Uz_Globs *)pG).zipfn,
                               (*(Uz_Globs *)pG).filename, NULL)) {
+#ifdef USE_PARALLEL
+            queue_next(pG, queue, numchunk);
+#endif
             return IZ_CTRLC;        /* cancel operation by user request */
         }
 #endif
@@ -1425,13 +1696,23 @@ reprompt:
         (*(Uz_Globs *)pG).filenote_slot = i;
 #endif
         (*(Uz_Globs *)pG).disk_full = 0;
-        if ((error = extract_or_test_member(pG)) != PK_COOL) {
+        /* stream the member data in large reads, then go back to small */
+        set_inbufsiz(pG, (zusz_t)(*(Uz_Globs *)pG).csize);
+#ifdef USE_PREFETCH
+        prefetch_member(pG);
+#endif
+        error = extract_or_test_member(pG);
+        set_inbufsiz(pG, (zusz_t)0);
+        if (error != PK_COOL) {
             if (error > error_in_archive)
                 error_in_archive = error;       /* ...and keep going */
 #ifdef DLL
             if ((*(Uz_Globs *)pG).disk_full > 1 || error_in_archive == IZ_CTRLC) {
 #else
             if ((*(Uz_Globs *)pG).disk_full > 1) {
+#endif
+#ifdef USE_PARALLEL
+                queue_next(pG, queue, numchunk);
 #endif
                 return error_in_archive;        /* (unless disk full) */
             }
@@ -1440,14 +1721,21 @@ reprompt:
         if (((*(Uz_Globs *)pG).statreportcb != NULL) &&
             (*(*(Uz_Globs *)pG).statreportcb)(pG, UZ_ST_FINISH_MEMBER, (*(Uz_Globs *)pG).zipfn,
                               (*(Uz_Globs *)pG).filename, (void *)&(*(Uz_Globs *)pG).lrec.ucsize)) {
+#ifdef USE_PARALLEL
+            queue_next(pG, queue, numchunk);
+#endif
             return IZ_CTRLC;        /* cancel operation by user request */
         }
 #endif
 #ifdef MACOS  /* MacOS is no preemptive OS, thus call event-handling by hand */
         UserStop();
 #endif
-    } /* end for-loop (i:  files in current block) */
+    } /* end for-loop (k:  files in current block) */
 
+#ifdef USE_PARALLEL
+    queue_next(pG, queue, numchunk);
+#endif
+    *pfilnum = filnum0 + numchunk;
     return error_in_archive;
 
 } /* end function extract_or_test_entrylist() */
@@ -1456,6 +1744,1003 @@ reprompt:
 
 
 
+#ifdef USE_PARALLEL
+
+/* one member's outcome in extract_parallel():  Info() output is collected
+ * here by the worker and printed by the main thread in member order */
+typedef struct xreport {
+    uch *msg;                   /* messages:  xmsghdr, text, 2 spare bytes */
+    ulg len, size;
+    int state;
+    int error;                  /* extract_or_test_entrylist() result */
+#ifdef SYMLINKS
+    slinkentry *slink_head;     /* its deferred symlinks, kept in order */
+    slinkentry *slink_last;
+#endif
+} xreport;
+
+#define XR_PENDING  0           /* not handed out yet */
+#define XR_TAKEN    1           /* a worker is on it */
+#define XR_DONE     2           /* finished; messages can be printed */
+#define XR_CHAINED  3           /* for the worker of the one before it */
+
+typedef struct xmsghdr {
+    ulg size;
+    int flag;
+} xmsghdr;
+
+/* the reports of a block done in zipfile order on one thread, kept until
+ * they can be printed in central-directory order */
+struct xqueue {
+    xreport *rep;               /* one per member, as in info[] */
+    MsgFn *message;             /* what prints them */
+    unsigned numchunk;
+    unsigned next;              /* first member not printed yet */
+#ifdef SYMLINKS
+    slinkentry *slink_head;     /* deferred symlinks of the printed ones */
+    slinkentry *slink_last;
+#endif
+};
+
+struct xpool {
+    pthread_mutex_t lock;
+    pthread_cond_t done;        /* signalled whenever a member is finished */
+    min_info **list;            /* members, in the order to hand them out */
+    xreport *rep;
+    int *chain;                 /* next member for the same file, or -1 */
+    unsigned numchunk;
+    unsigned next;              /* first member that may still be pending */
+    int stop;                   /* disk full:  hand out no more members */
+    ulg filnum0;
+};
+
+/* a member and the file it goes to, for chain_collisions() */
+typedef struct xname {
+    char *key;
+    unsigned k;                 /* in xpool.list */
+    min_info *info;
+} xname;
+
+typedef struct xworker {
+    xpool *pool;
+    Uz_Globs *wG;               /* the worker's own globals */
+    pthread_t thread;
+    ulg num_bad_pwd;
+    zoff_t old_extra_bytes;
+#ifdef SET_DIR_ATTRIB
+    unsigned num_dirs;
+    direntry *dirlist;
+#endif
+} xworker;
+
+
+
+/*********************************/
+/*  Function parallel_threads()  */
+/*********************************/
+
+static unsigned parallel_threads(pG, numchunk)  /* return 0/1:  don't */
+    Uz_Globs *pG;
+    unsigned numchunk;
+{
+    long n = uO.w_threads;
+
+    /* workers cannot prompt, and their output must not mix on stdout;
+     * testing (-t) writes nothing, so its members can go on any thread */
+    if (n == 0 || numchunk < 2 || uO.cflag ||
+        asks_questions(pG, numchunk))
+        return 0;
+#ifdef USE_PAR_INFLATE
+    if (uO.H_size != 0)         /* -H:  the threads go to single members */
+        return 0;
+#endif
+#ifdef USE_INFLATE_INDEX
+    if (uO.k_size != 0)         /* -k:  the index is kept by the main thread */
+        return 0;
+#endif
+    if (n < 0 && (n = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+        n = 1;
+    if (n > MAX_THREADS)
+        n = MAX_THREADS;
+    return (n > (long)numchunk)? numchunk : (unsigned)n;
+
+} /* end function parallel_threads() */
+
+
+
+/*******************************/
+/*  Function parallel_globs()  */
+/*******************************/
+
+static Uz_Globs *parallel_globs(pG)   /* return NULL if no memory or file */
+    Uz_Globs *pG;
+{
+    Uz_Globs *wG;
+
+    if ((wG = globalsCtor()) == (Uz_Globs *)NULL)
+        return (Uz_Globs *)NULL;
+
+    /* everything extract_or_test_entrylist() needs to know of the run;
+     * info[] is shared, each worker only touches the members it takes */
+    (*wG).UzO = uO;
+#if (defined(IZ_CHECK_TZ) && defined(USE_EF_UT_TIME))
+    (*wG).tz_is_valid = (*(Uz_Globs *)pG).tz_is_valid;
+#endif
+    (*wG).process_all_files = (*(Uz_Globs *)pG).process_all_files;
+    (*wG).overwrite_mode = (*(Uz_Globs *)pG).overwrite_mode;
+    (*wG).create_dirs = (*(Uz_Globs *)pG).create_dirs;
+    (*wG).extract_flag = (*(Uz_Globs *)pG).extract_flag;
+    (*wG).wildzipfn = (*(Uz_Globs *)pG).wildzipfn;
+    (*wG).zipfn = (*(Uz_Globs *)pG).zipfn;
+    (*wG).ziplen = (*(Uz_Globs *)pG).ziplen;
+    (*wG).extra_bytes = (*(Uz_Globs *)pG).extra_bytes;
+    (*wG).ecrec = (*(Uz_Globs *)pG).ecrec;
+    (*wG).info = (*(Uz_Globs *)pG).info;
+    (*wG).crc_32_tab = CRC_32_TAB;
+    (*wG).reported_backslash = (*(Uz_Globs *)pG).reported_backslash;
+    (*wG).statreportcb = (*(Uz_Globs *)pG).statreportcb;
+#ifdef UNICODE_SUPPORT
+    (*wG).unicode_escape_all = (*(Uz_Globs *)pG).unicode_escape_all;
+    (*wG).unicode_mismatch = (*(Uz_Globs *)pG).unicode_mismatch;
+#ifdef UTF8_MAYBE_NATIVE
+    (*wG).native_is_utf8 = (*(Uz_Globs *)pG).native_is_utf8;
+#endif
+#endif
+
+    /* own buffers and zipfile handle, as in process_zipfiles() */
+    (*wG).inbuf_max = (*(Uz_Globs *)pG).inbuf_max;
+    (*wG).inbuf_memsiz = MIN((*wG).inbuf_max, STRMINBUFSIZ);
+    (*wG).inbuf = (uch *)malloc((*wG).inbuf_memsiz + 4);
+    (*wG).outbuf = (uch *)malloc(OUTBUFSIZ + 1);
+    (*wG).inbuf_mem = (*wG).inbuf;
+    if ((*wG).inbuf == (uch *)NULL || (*wG).outbuf == (uch *)NULL ||
+        open_input_file(wG))
+    {
+        (*wG).info = (min_info *)NULL;
+        free_G_buffers(wG);
+        free(wG);
+        return (Uz_Globs *)NULL;
+    }
+    (*wG).hold = (*wG).inbuf + INBUFSIZ;
+    set_inbufsiz(wG, (zusz_t)0);
+    (*wG).cur_zipfile_bufstart = 0;
+    (*wG).inbuf_len = 0;
+    (*wG).inptr = (*wG).inbuf;
+    (*wG).incnt = 0;
+
+#ifdef USE_ASYNC_WRITE
+    (*wG).write_sync = TRUE;    /* (one writer thread each would be many) */
+#endif
+    (*wG).message = parallel_message;
+    (*wG).mpause = NULL;
+    return wG;
+
+} /* end function parallel_globs() */
+
+
+
+/************************************/
+/*  Function free_parallel_globs()  */
+/************************************/
+
+static void free_parallel_globs(pG)
+    Uz_Globs *pG;                       /* worker's globals */
+{
+    CLOSE_INFILE();
+    (*(Uz_Globs *)pG).info = (min_info *)NULL;   /* (not ours) */
+    (*(Uz_Globs *)pG).pInfo = (min_info *)NULL;
+    free_G_buffers(pG);
+    free(pG);
+
+} /* end function free_parallel_globs() */
+
+
+
+/*********************************/
+/*  Function parallel_message()  */
+/*********************************/
+
+static int UZ_EXP parallel_message(
+    void *pG,       /* globals struct of a worker */
+    uch *buf,
+    ulg size,
+    int flag)
+{
+    xreport *rep = (xreport *)((Uz_Globs *)pG)->msgsink;
+    xmsghdr hdr;
+    ulg need = sizeof(xmsghdr) + size + 2;
+    uch *p;
+
+    if (rep == (xreport *)NULL)
+        return 0;
+    if (rep->len + need > rep->size) {
+        ulg n = (rep->size ? rep->size : 256);
+
+        while (n < rep->len + need)
+            n <<= 1;
+        if ((p = (uch *)realloc(rep->msg, n)) == (uch *)NULL)
+            return 0;           /* message lost, but keep going */
+        rep->msg = p;
+        rep->size = n;
+    }
+    hdr.size = size;
+    hdr.flag = flag;
+    memcpy(rep->msg + rep->len, &hdr, sizeof(xmsghdr));
+    memcpy(rep->msg + rep->len + sizeof(xmsghdr), buf, (extent)size);
+    rep->len += need;   /* (2 spare:  UzpMessagePrnt() may append a '\n') */
+    return 0;
+
+} /* end function parallel_message() */
+
+
+
+/****************************/
+/*  Function queue_start()  */
+/****************************/
+
+static xqueue *queue_start(pG, numchunk)   /* return NULL if no memory */
+    Uz_Globs *pG;
+    unsigned numchunk;
+{
+    xqueue *queue;
+
+    if ((queue = (xqueue *)malloc(sizeof(xqueue))) == (xqueue *)NULL)
+        return (xqueue *)NULL;
+    if ((queue->rep = (xreport *)calloc(numchunk, sizeof(xreport))) ==
+        (xreport *)NULL) {
+        free((void *)queue);
+        return (xqueue *)NULL;
+    }
+    queue->message = (*(Uz_Globs *)pG).message;
+    queue->numchunk = numchunk;
+    queue->next = 0;
+#ifdef SYMLINKS
+    /* (those of earlier blocks come first, as they would anyway) */
+    queue->slink_head = (*(Uz_Globs *)pG).slink_head;
+    queue->slink_last = (*(Uz_Globs *)pG).slink_last;
+    (*(Uz_Globs *)pG).slink_head = (*(Uz_Globs *)pG).slink_last = NULL;
+#endif
+    (*(Uz_Globs *)pG).message = parallel_message;
+    return queue;
+
+} /* end function queue_start() */
+
+
+
+/***************************/
+/*  Function queue_next()  */
+/***************************/
+
+static void queue_next(pG, queue, i)
+    Uz_Globs *pG;
+    xqueue *queue;      /* NULL:  nothing kept */
+    unsigned i;         /* info[] index of the next member; numchunk:  end */
+{
+    xreport *rep = (xreport *)(*(Uz_Globs *)pG).msgsink;
+    uch *p;
+    xmsghdr hdr;
+
+/*---------------------------------------------------------------------------
+    The member before is done:  print its messages and those of the ones
+    after it in central-directory order that are done as well, then catch
+    those of member i.  At the end, print what is left (members not done,
+    after a full disk, have nothing to print), and put things back.
+  ---------------------------------------------------------------------------*/
+
+    if (queue == (xqueue *)NULL)
+        return;
+    if (rep != (xreport *)NULL) {
+        rep->state = XR_DONE;
+#ifdef SYMLINKS
+        rep->slink_head = (*(Uz_Globs *)pG).slink_head;
+        rep->slink_last = (*(Uz_Globs *)pG).slink_last;
+        (*(Uz_Globs *)pG).slink_head = (*(Uz_Globs *)pG).slink_last = NULL;
+#endif
+    }
+    for (;  queue->next < queue->numchunk;  ++queue->next) {
+        rep = &queue->rep[queue->next];
+        if (rep->state != XR_DONE && i < queue->numchunk)
+            break;
+        for (p = rep->msg;  p < rep->msg + rep->len;
+             p += sizeof(xmsghdr) + hdr.size + 2) {
+            memcpy(&hdr, p, sizeof(xmsghdr));
+            (*queue->message)((void *)pG, p + sizeof(xmsghdr), hdr.size,
+                              hdr.flag);
+        }
+        if (rep->msg)
+            free((void *)rep->msg);
+#ifdef SYMLINKS
+        if (rep->slink_head != (slinkentry *)NULL) {
+            if (queue->slink_last != (slinkentry *)NULL)
+                queue->slink_last->next = rep->slink_head;
+            else
+                queue->slink_head = rep->slink_head;
+            queue->slink_last = rep->slink_last;
+        }
+#endif
+    }
+
+    if (i < queue->numchunk) {
+        queue->rep[i].state = XR_TAKEN;
+        (*(Uz_Globs *)pG).msgsink = (void *)&queue->rep[i];
+        return;
+    }
+    (*(Uz_Globs *)pG).msgsink = NULL;
+    (*(Uz_Globs *)pG).message = queue->message;
+#ifdef SYMLINKS
+    (*(Uz_Globs *)pG).slink_head = queue->slink_head;
+    (*(Uz_Globs *)pG).slink_last = queue->slink_last;
+#endif
+    free((void *)queue->rep);
+    free((void *)queue);
+
+} /* end function queue_next() */
+
+
+
+/********************************/
+/*  Function parallel_worker()  */
+/********************************/
+
+static void *parallel_worker(arg)
+    void *arg;
+{
+    xworker *w = (xworker *)arg;
+    xpool *pool = w->pool;
+    Uz_Globs *pG = w->wG;
+    unsigned k;
+    ulg filnum;
+    int error, chained = -1;    /* the next member for the same file */
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        if (chained < 0) {
+            while (pool->next < pool->numchunk &&
+                   pool->rep[pool->next].state != XR_PENDING)
+                ++pool->next;
+            chained = (int)pool->next++;
+        }
+        if (pool->stop || chained >= (int)pool->numchunk) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        k = (unsigned)chained;
+        pool->rep[k].state = XR_TAKEN;
+        pthread_mutex_unlock(&pool->lock);
+
+        (*(Uz_Globs *)pG).msgsink = (void *)&pool->rep[k];
+        filnum = pool->filnum0;
+        error = extract_or_test_entrylist(pG, 1, &pool->list[k],
+                        &filnum, &w->num_bad_pwd, &w->old_extra_bytes,
+#ifdef SET_DIR_ATTRIB
+                        &w->num_dirs, &w->dirlist,
+#endif
+                        PK_COOL);
+        (*(Uz_Globs *)pG).msgsink = NULL;
+#ifdef SYMLINKS
+        pool->rep[k].slink_head = (*(Uz_Globs *)pG).slink_head;
+        pool->rep[k].slink_last = (*(Uz_Globs *)pG).slink_last;
+        (*(Uz_Globs *)pG).slink_head = (*(Uz_Globs *)pG).slink_last = NULL;
+#endif
+
+        pthread_mutex_lock(&pool->lock);
+        pool->rep[k].error = error;
+        pool->rep[k].state = XR_DONE;
+        if ((*(Uz_Globs *)pG).disk_full > 1)
+            pool->stop = TRUE;
+        pthread_cond_broadcast(&pool->done);
+        pthread_mutex_unlock(&pool->lock);
+        /* members for the same file are this worker's, one after another */
+        chained = (pool->chain != (int *)NULL)? pool->chain[k] : -1;
+    }
+    return NULL;
+
+} /* end function parallel_worker() */
+
+
+
+/***************************/
+/*  Function output_key()  */
+/***************************/
+
+static char *output_key(pG, name)   /* return NULL if no memory */
+    Uz_Globs *pG;
+    const char *name;
+{
+    const char *p, *comp;
+    char *key, *q;
+    extent len;
+
+/*---------------------------------------------------------------------------
+    The name of the file a member goes to, near enough to tell which of an
+    archive's members go to the same one:  without the path components
+    mapname() drops ("", "." and ".."), with only the last one for -j, and
+    in lowercase, since the filesystem may ignore case.  (The -d directory
+    is the same for all of them.)  Names it takes for the same that are
+    not are merely extracted one after the other.
+  ---------------------------------------------------------------------------*/
+
+    if ((key = (char *)malloc(strlen(name) + 1)) == (char *)NULL)
+        return (char *)NULL;
+    for (p = name, q = key;  *p != '\0';  ) {
+        for (comp = p;  *p != '\0' && *p != '/' && *p != '\\';  ++p)
+            ;
+        len = (extent)(p - comp);
+        if (*p != '\0')
+            ++p;
+        if (len == 0 || (comp[0] == '.' && (len == 1 ||
+                                            (len == 2 && comp[1] == '.'))))
+            continue;
+        if (uO.jflag && *p != '\0')
+            continue;
+        if (q != key)
+            *q++ = '/';
+        while (len-- > 0)
+            *q++ = (char)tolower((uch)*comp++);
+    }
+    *q = '\0';
+    return key;
+
+} /* end function output_key() */
+
+
+
+/*********************************/
+/*  Function chain_collisions()  */
+/*********************************/
+
+static int chain_collisions(pG, pool)   /* return FALSE if no memory */
+    Uz_Globs *pG;
+    xpool *pool;
+{
+    xname *names;
+    unsigned k, n = 0;
+    int ok = TRUE;
+
+/*---------------------------------------------------------------------------
+    Members of an archive that go to the same file (see output_key()) must
+    not be extracted at the same time, as each one's open_outfile() would
+    truncate the file under the others.  Such members are chained up here
+    in central-directory order, so that the last of them wins as in a
+    serial run; the first one is handed out as usual, and the worker that
+    takes it does the rest of its chain after it (XR_CHAINED).
+  ---------------------------------------------------------------------------*/
+
+    pool->chain = (int *)malloc(pool->numchunk * sizeof(int));
+    names = (xname *)malloc(pool->numchunk * sizeof(xname));
+    if (pool->chain == (int *)NULL || names == (xname *)NULL)
+        ok = FALSE;
+    for (k = 0;  ok && k < pool->numchunk;  ++k) {
+        pool->chain[k] = -1;
+        if (pool->rep[k].state != XR_PENDING ||
+            pool->list[k]->cfilname == (char *)NULL)
+            continue;
+        if ((names[n].key = output_key(pG, pool->list[k]->cfilname)) ==
+            (char *)NULL)
+            ok = FALSE;
+        else {
+            names[n].k = k;
+            names[n++].info = pool->list[k];
+        }
+    }
+    if (ok) {
+        qsort((char *)names, n, sizeof(xname), keycomp);
+        for (k = 1;  k < n;  ++k)
+            if (strcmp(names[k-1].key, names[k].key) == 0) {
+                pool->chain[names[k-1].k] = (int)names[k].k;
+                pool->rep[names[k].k].state = XR_CHAINED;
+            }
+    }
+    while (n > 0)
+        free((void *)names[--n].key);
+    if (names)
+        free((void *)names);
+    if (!ok && pool->chain) {
+        free((void *)pool->chain);
+        pool->chain = (int *)NULL;
+    }
+    return ok;
+
+} /* end function chain_collisions() */
+
+
+
+/*********************************/
+/*  Function extract_parallel()  */
+/*********************************/
+
+static int extract_parallel(pG, numchunk, nthreads, order,
+                pfilnum, pnum_bad_pwd, pold_extra_bytes,
+#ifdef SET_DIR_ATTRIB
+                pnum_dirs, pdirlist,
+#endif
+                error_in_archive)    /* return PK-type error code */
+    Uz_Globs *pG;
+    unsigned numchunk;
+    unsigned nthreads;
+    min_info **order;   /* info[] in processing order, or NULL:  as is */
+    ulg *pfilnum;
+    ulg *pnum_bad_pwd;
+    zoff_t *pold_extra_bytes;
+#ifdef SET_DIR_ATTRIB
+    unsigned *pnum_dirs;
+    direntry **pdirlist;
+#endif
+    int error_in_archive;
+{
+    xpool pool;
+    xworker *w;
+    unsigned *at = (unsigned *)NULL;    /* where info[i] is in pool.list */
+    unsigned i, k, t, nstarted;
+    ulg filnum;
+    uch *p;
+    xmsghdr hdr;
+    MsgFn *message = (*(Uz_Globs *)pG).message;
+    sigset_t all, old;
+
+/*---------------------------------------------------------------------------
+    Each member is extracted by extract_or_test_entrylist() on a worker
+    thread with globals of its own (buffers, zipfile handle, decompression
+    state); their messages are caught and printed here, in the order a
+    serial run would have printed them, and their results are combined
+    into error_in_archive.  When extracting, directory entries are done
+    first, on this thread, so that they are created (and have their
+    attributes restored) as if they had come before any file in them.
+    The first member of an archive with leading junk is done here as well,
+    since it decides whether the offsets need correcting for all others
+    (see AttemptRecompensate).
+  ---------------------------------------------------------------------------*/
+
+    memzero(&pool, sizeof(pool));
+    pool.numchunk = numchunk;
+    pool.filnum0 = *pfilnum;
+    if ((pool.rep = (xreport *)calloc(numchunk, sizeof(xreport))) ==
+        (xreport *)NULL ||
+        (w = (xworker *)calloc(nthreads, sizeof(xworker))) == (xworker *)NULL)
+    {
+        if (pool.rep)
+            free((void *)pool.rep);
+        return extract_or_test_entrylist(pG, numchunk, order, pfilnum,
+                        pnum_bad_pwd, pold_extra_bytes,
+#ifdef SET_DIR_ATTRIB
+                        pnum_dirs, pdirlist,
+#endif
+                        error_in_archive);
+    }
+    if (order != (min_info **)NULL) {
+        if ((at = (unsigned *)malloc(numchunk*sizeof(unsigned))) !=
+            (unsigned *)NULL) {
+            pool.list = order;
+            for (k = 0;  k < numchunk;  ++k)
+                at[order[k] - (*(Uz_Globs *)pG).info] = k;
+        }
+    } else if ((pool.list = (min_info **)malloc(numchunk*sizeof(min_info *)))
+               != (min_info **)NULL)
+        for (k = 0;  k < numchunk;  ++k)
+            pool.list[k] = &(*(Uz_Globs *)pG).info[k];
+    if (pool.list == (min_info **)NULL) {
+        free((void *)w);
+        free((void *)pool.rep);
+        return extract_or_test_entrylist(pG, numchunk, order, pfilnum,
+                        pnum_bad_pwd, pold_extra_bytes,
+#ifdef SET_DIR_ATTRIB
+                        pnum_dirs, pdirlist,
+#endif
+                        error_in_archive);
+    }
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.done, NULL);
+
+    (*(Uz_Globs *)pG).message = parallel_message;
+    for (k = 0;  k < numchunk && !pool.stop;  ++k) {
+        char *name = pool.list[k]->cfilname;
+
+        if (!(pool.filnum0 == 0 && pool.list[k] == &(*(Uz_Globs *)pG).info[0] &&
+              (*(Uz_Globs *)pG).extra_bytes != 0) &&
+            (uO.tflag || name == (char *)NULL || *name == '\0' ||
+             lastchar(name, strlen(name)) != '/'))
+            continue;
+        (*(Uz_Globs *)pG).msgsink = (void *)&pool.rep[k];
+        filnum = pool.filnum0;
+        pool.rep[k].error = extract_or_test_entrylist(pG, 1, &pool.list[k],
+                        &filnum, pnum_bad_pwd, pold_extra_bytes,
+#ifdef SET_DIR_ATTRIB
+                        pnum_dirs, pdirlist,
+#endif
+                        PK_COOL);
+        pool.rep[k].state = XR_DONE;
+        if ((*(Uz_Globs *)pG).disk_full > 1)
+            pool.stop = TRUE;
+    }
+    (*(Uz_Globs *)pG).msgsink = NULL;
+    if (!uO.tflag && !pool.stop && !chain_collisions(pG, &pool))
+        nthreads = 0;           /* no memory:  all of it on this thread */
+
+    /* signals are for the main thread only; the new threads inherit
+     * the blocked mask */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    for (nstarted = 0;  nstarted < nthreads && !pool.stop;  ++nstarted) {
+        w[nstarted].pool = &pool;
+        if ((w[nstarted].wG = parallel_globs(pG)) == (Uz_Globs *)NULL)
+            break;
+        w[nstarted].old_extra_bytes = *pold_extra_bytes;
+        if (pthread_create(&w[nstarted].thread, NULL, parallel_worker,
+                           &w[nstarted]) != 0) {
+            free_parallel_globs(w[nstarted].wG);
+            break;
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (nstarted == 0) {
+        /* no threads to be had:  do the rest here, then print it all */
+        w[0].pool = &pool;
+        w[0].wG = pG;
+        w[0].old_extra_bytes = *pold_extra_bytes;
+        parallel_worker(&w[0]);
+        *pnum_bad_pwd += w[0].num_bad_pwd;
+        *pold_extra_bytes = w[0].old_extra_bytes;
+#ifdef SET_DIR_ATTRIB
+        while (w[0].dirlist != (direntry *)NULL) {
+            direntry *d = w[0].dirlist;
+
+            w[0].dirlist = d->next;
+            d->next = *pdirlist;
+            *pdirlist = d;
+            ++(*pnum_dirs);
+        }
+#endif
+    }
+    (*(Uz_Globs *)pG).message = message;
+
+    /* print each member's messages as soon as it and all before it in the
+     * central directory are done */
+    for (i = 0;  i < numchunk;  ++i) {
+        k = (at != (unsigned *)NULL)? at[i] : i;
+        pthread_mutex_lock(&pool.lock);
+        while (pool.rep[k].state == XR_TAKEN ||
+               (pool.rep[k].state != XR_DONE && !pool.stop))
+            pthread_cond_wait(&pool.done, &pool.lock);
+        pthread_mutex_unlock(&pool.lock);
+
+        for (p = pool.rep[k].msg;  p < pool.rep[k].msg + pool.rep[k].len;
+             p += sizeof(xmsghdr) + hdr.size + 2) {
+            memcpy(&hdr, p, sizeof(xmsghdr));
+            (*message)((void *)pG, p + sizeof(xmsghdr), hdr.size, hdr.flag);
+        }
+        if (pool.rep[k].msg)
+            free((void *)pool.rep[k].msg);
+#ifdef SYMLINKS
+        if (pool.rep[k].slink_head != (slinkentry *)NULL) {
+            if ((*(Uz_Globs *)pG).slink_last != (slinkentry *)NULL)
+                (*(Uz_Globs *)pG).slink_last->next = pool.rep[k].slink_head;
+            else
+                (*(Uz_Globs *)pG).slink_head = pool.rep[k].slink_head;
+            (*(Uz_Globs *)pG).slink_last = pool.rep[k].slink_last;
+        }
+#endif
+        if (pool.rep[k].state == XR_DONE &&
+            pool.rep[k].error > error_in_archive)
+            error_in_archive = pool.rep[k].error;
+    }
+
+    /* collect what the workers left for the end of extract_or_test_files() */
+    for (t = 0;  t < nstarted;  ++t) {
+        Uz_Globs *wG = w[t].wG;
+
+        pthread_join(w[t].thread, NULL);
+        *pnum_bad_pwd += w[t].num_bad_pwd;
+        if ((*wG).extra_bytes != (*(Uz_Globs *)pG).extra_bytes) {
+            *pold_extra_bytes = w[t].old_extra_bytes;
+            (*(Uz_Globs *)pG).extra_bytes = (*wG).extra_bytes;
+        }
+        if ((*wG).disk_full > (*(Uz_Globs *)pG).disk_full)
+            (*(Uz_Globs *)pG).disk_full = (*wG).disk_full;
+        if ((*wG).reported_backslash)
+            (*(Uz_Globs *)pG).reported_backslash = TRUE;
+#ifdef SET_DIR_ATTRIB
+        while (w[t].dirlist != (direntry *)NULL) {
+            direntry *d = w[t].dirlist;
+
+            w[t].dirlist = d->next;
+            d->next = *pdirlist;
+            *pdirlist = d;
+            ++(*pnum_dirs);
+        }
+#endif
+        free_parallel_globs(wG);
+    }
+
+    pthread_cond_destroy(&pool.done);
+    pthread_mutex_destroy(&pool.lock);
+    if (pool.list != order)
+        free((void *)pool.list);
+    if (at)
+        free((void *)at);
+    if (pool.chain)
+        free((void *)pool.chain);
+    free((void *)pool.rep);
+    free((void *)w);
+
+    *pfilnum = pool.filnum0 + numchunk;
+    return error_in_archive;
+
+} /* end function extract_parallel() */
+
+
+
+
+
+/* a piece of a large STORED member, whose CRC is found on a thread of its
+ * own while extract_or_test_member() copies the data as usual */
+struct crcpiece {
+    Uz_Globs *pG;               /* (for zipf_pread() only) */
+    zoff_t start;               /* zipfile offset */
+    zoff_t len;
+    ulg crc;
+    int ok;                     /* all of it could be read */
+    pthread_t thread;
+};
+
+#ifndef CRC_PIECE_MIN
+#  define CRC_PIECE_MIN  0x400000L  /* smallest piece; members of less */
+#endif                              /* than two are not split up */
+#define CRC_PIECE_STEP  0x40000L    /* bytes read and run through at once */
+
+
+
+/**************************/
+/*  Function crc_split()  */
+/**************************/
+
+static unsigned crc_split(pG, ppieces)   /* return number of pieces, */
+    Uz_Globs *pG;                         /* 0 if flush() does the CRC */
+    crcpiece **ppieces;
+{
+    long n = uO.w_threads;
+    zoff_t start, len;
+    crcpiece *pc;
+    unsigned k;
+    sigset_t all, old;
+
+/*---------------------------------------------------------------------------
+    Called at the start of a STORED member, after defer_leftover_input():
+    its data are the csize + incnt bytes at inptr.  With -w, split them
+    into up to one piece per thread and start a thread on each; flush()
+    then leaves crc32val alone.  Not done for the members extract_parallel()
+    hands out (those threads are busy already), nor when zipf_pread() could
+    not be called from several threads at once.
+  ---------------------------------------------------------------------------*/
+
+    len = (*(Uz_Globs *)pG).csize + (zoff_t)(*(Uz_Globs *)pG).incnt;
+    if (n == 0 || (*(Uz_Globs *)pG).msgsink != NULL || (*(Uz_Globs *)pG).pInfo->encrypted ||
+        len < 2 * CRC_PIECE_MIN)
+        return 0;
+#ifndef USE_PREAD
+#ifdef USE_MMAP_INPUT
+    if ((*(Uz_Globs *)pG).zipmap == (uch *)NULL)
+#endif
+        return 0;
+#endif
+    if (n < 0 && (n = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+        n = 1;
+    if (n > MAX_THREADS)
+        n = MAX_THREADS;
+    if ((zoff_t)n > len / CRC_PIECE_MIN)
+        n = (long)(len / CRC_PIECE_MIN);
+    if (n < 2 ||
+        (pc = (crcpiece *)calloc((extent)n, sizeof(crcpiece))) ==
+        (crcpiece *)NULL)
+        return 0;
+
+    start = (*(Uz_Globs *)pG).cur_zipfile_bufstart +
+            ((*(Uz_Globs *)pG).inptr - (*(Uz_Globs *)pG).inbuf);
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    for (k = 0;  k < (unsigned)n;  ++k) {
+        pc[k].pG = pG;
+        pc[k].start = start + len / n * k;
+        pc[k].len = (k == (unsigned)n - 1)? start + len - pc[k].start :
+                    len / n;
+        if (pthread_create(&pc[k].thread, NULL, crc_thread, &pc[k]) != 0)
+            break;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (k < (unsigned)n) {      /* not all of it covered:  leave it be */
+        while (k > 0)
+            pthread_join(pc[--k].thread, NULL);
+        free((void *)pc);
+        return 0;
+    }
+
+    (*(Uz_Globs *)pG).crc_elsewhere = TRUE;
+    (*(Uz_Globs *)pG).crc_passed = 0;
+    *ppieces = pc;
+    return (unsigned)n;
+
+} /* end function crc_split() */
+
+
+
+/***************************/
+/*  Function crc_thread()  */
+/***************************/
+
+static void *crc_thread(arg)
+    void *arg;
+{
+    crcpiece *pc = (crcpiece *)arg;
+    Uz_Globs *pG = pc->pG;
+    zoff_t pos = pc->start, end = pc->start + pc->len;
+    unsigned n;
+    uch *buf;
+
+    pc->crc = CRCVAL_INITIAL;
+#ifdef USE_MMAP_INPUT
+    if (zipmap_covers(pG, pos, pc->len)) {
+        for (;  pos < end;  pos += n) {
+            n = (end - pos > CRC_PIECE_STEP)? CRC_PIECE_STEP :
+                (unsigned)(end - pos);
+            pc->crc = crc32(pc->crc, (*(Uz_Globs *)pG).zipmap + (size_t)pos, n);
+        }
+        pc->ok = TRUE;
+        return NULL;
+    }
+#endif
+    if ((buf = (uch *)malloc(CRC_PIECE_STEP)) == (uch *)NULL)
+        return NULL;
+    for (;  pos < end;  pos += n) {
+        n = (end - pos > CRC_PIECE_STEP)? CRC_PIECE_STEP :
+            (unsigned)(end - pos);
+        if (zipf_pread(pG, buf, n, pos) != (int)n)
+            break;
+        pc->crc = crc32(pc->crc, buf, n);
+    }
+    pc->ok = (pos >= end);
+    free((void *)buf);
+    return NULL;
+
+} /* end function crc_thread() */
+
+
+
+/*************************/
+/*  Function crc_join()  */
+/*************************/
+
+static void crc_join(pG, pieces, npieces, buf, bufsize)
+    Uz_Globs *pG;
+    crcpiece *pieces;
+    unsigned npieces;
+    uch *buf;           /* for reading the data again, if it comes to that */
+    unsigned bufsize;
+{
+    ulg crc = CRCVAL_INITIAL;
+    zoff_t total = 0, pos, end;
+    unsigned k, n;
+    int ok = TRUE;
+
+    for (k = 0;  k < npieces;  ++k) {
+        pthread_join(pieces[k].thread, NULL);
+        ok = ok && pieces[k].ok;
+        crc = crc32_combine(crc, pieces[k].crc, pieces[k].len);
+        total += pieces[k].len;
+    }
+    (*(Uz_Globs *)pG).crc_elsewhere = FALSE;
+
+    if (ok && (*(Uz_Globs *)pG).crc_passed == total)
+        (*(Uz_Globs *)pG).crc32val = crc;
+    else {
+        /* flush() got less than all of it (short zipfile, disk full, ...):
+         * a serial run would have the CRC of what flush() did get */
+        (*(Uz_Globs *)pG).crc32val = CRCVAL_INITIAL;
+        end = pieces[0].start + (*(Uz_Globs *)pG).crc_passed;
+        for (pos = pieces[0].start;  pos < end;  pos += n) {
+            n = (end - pos > (zoff_t)bufsize)? bufsize : (unsigned)(end - pos);
+            if (zipf_pread(pG, buf, n, pos) != (int)n)
+                break;
+            (*(Uz_Globs *)pG).crc32val = crc32((*(Uz_Globs *)pG).crc32val, buf, n);
+        }
+    }
+    free((void *)pieces);
+
+} /* end function crc_join() */
+
+#endif /* USE_PARALLEL */
+
+
+
+
+
+#ifdef USE_COPY_RANGE
+
+#ifndef COPY_RANGE_MIN
+#  define COPY_RANGE_MIN  0x10000L  /* less is written just as fast */
+#endif
+
+/****************************/
+/*  Function copy_stored()  */
+/****************************/
+
+static int copy_stored(pG, buf, bufsize)   /* return PK-type error code */
+    Uz_Globs *pG;
+    uch *buf;           /* scratch space for copy_zipdata() */
+    unsigned bufsize;
+{
+    zoff_t start, len;
+#ifdef USE_MMAP_INPUT
+    zoff_t n;
+#endif
+    int error;
+
+/*---------------------------------------------------------------------------
+    Called at the start of a STORED member, after defer_leftover_input()
+    and crc_split().  Binary output to a file is the same as the data in
+    the zipfile, so let copy_zipdata() have the kernel copy whatever is not
+    in the input buffer yet (csize bytes, following it), leaving csize 0.
+    The CRC is then found straight from the zipfile mapping, or by the
+    crc_split() threads; without either, the data are read after all, and
+    it is not worth it.  PK_COOL is also returned when nothing was done.
+  ---------------------------------------------------------------------------*/
+
+    start = (*(Uz_Globs *)pG).cur_zipfile_bufstart + (*(Uz_Globs *)pG).inbuf_len;
+    len = (*(Uz_Globs *)pG).csize;
+    if (uO.tflag || uO.cflag || (*(Uz_Globs *)pG).pInfo->textmode ||
+        (*(Uz_Globs *)pG).disk_full || len < COPY_RANGE_MIN ||
+#ifdef USE_SPARSE
+        (*(Uz_Globs *)pG).sparse_blk ||  /* (would write all the zeros) */
+#endif
+        start + len > (*(Uz_Globs *)pG).ziplen)
+        return PK_COOL;
+#ifdef DLL
+    if ((*(Uz_Globs *)pG).redirect_data)
+        return PK_COOL;
+#endif
+    if (!(*(Uz_Globs *)pG).crc_elsewhere) {
+#ifdef USE_MMAP_INPUT
+        if (!zipmap_covers(pG, start, len))
+#endif
+            return PK_COOL;
+    }
+
+    /* what the input buffer holds already goes the usual way */
+    if ((*(Uz_Globs *)pG).incnt > 0) {
+        error = flush(pG, (*(Uz_Globs *)pG).inptr, (ulg)(*(Uz_Globs *)pG).incnt, 0);
+        (*(Uz_Globs *)pG).inptr += (*(Uz_Globs *)pG).incnt;
+        (*(Uz_Globs *)pG).incnt = 0;
+        if (error != PK_COOL || (*(Uz_Globs *)pG).disk_full)
+            return error;
+    }
+#ifdef USE_WRITEV
+    if ((error = drain_outfile(pG)) != PK_OK)
+        return error;
+#endif
+    if (fflush((*(Uz_Globs *)pG).outfile) != 0 ||
+        (error = copy_zipdata(pG, start, len, buf, bufsize)) < 0)
+        return PK_COOL;         /* NEXTBYTE reads on from here */
+
+    (*(Uz_Globs *)pG).csize = 0;
+    if ((*(Uz_Globs *)pG).crc_elsewhere)
+        (*(Uz_Globs *)pG).crc_passed += len;
+#ifdef USE_MMAP_INPUT
+    else
+        for (;  len > 0;  start += n, len -= n) {
+            n = MIN(len, (zoff_t)0x40000000L);
+            (*(Uz_Globs *)pG).crc32val = crc32((*(Uz_Globs *)pG).crc32val,
+              (*(Uz_Globs *)pG).zipmap + (size_t)start, (extent)n);
+        }
+#endif
+    return error;
+
+} /* end function copy_stored() */
+
+#endif /* USE_COPY_RANGE */
+
+
+
+
+
 /* wsize is used in extract_or_test_member() and UZbunzip2() */
 #if (defined(DLL) && !defined(NO_SLIDE_REDIR))
 #  define wsize (*(Uz_Globs *)pG)._wsize    /* wsize is a variable */
@@ -1476,6 +2761,11 @@ static int extract_or_test_member(pG)    /* return PK-type error code */
 #endif
     register int b;
     int r, error=PK_COOL;
+    ulg n;
+#ifdef USE_PARALLEL
+    crcpiece *pieces;
+    unsigned npieces;
+#endif
 
 
 /*---------------------------------------------------------------------------
@@ -1487,6 +2777,14 @@ static int extract_or_test_member(pG)    /* return PK-type error code */
     (*(Uz_Globs *)pG).zipeof = 0;
     (*(Uz_Globs *)pG).newfile = TRUE;
     (*(Uz_Globs *)pG).crc32val = CRCVAL_INITIAL;
+    (*(Uz_Globs *)pG).range_at = 0;
+    (*(Uz_Globs *)pG).range_part = FALSE;
+#ifdef USE_SPARSE
+    (*(Uz_Globs *)pG).sparse_blk = 0;
+#endif
+#ifdef USE_WRITEV
+    (*(Uz_Globs *)pG).wbuf_len = 0;
+#endif
 
 #ifdef SYMLINKS
     /* If file is a (POSIX-compatible) symbolic link and we are extracting
@@ -1545,6 +2843,12 @@ static int extract_or_test_member(pG)    /* return PK-type error code */
         } else if (open_outfile(pG))
             return PK_DISK;
 #endif /* ?VMS */
+#ifdef USE_SPARSE
+        sparse_outfile(pG);     /* -S:  (binary files only) */
+#endif
+#ifdef USE_PREALLOC
+        prealloc_outfile(pG);   /* (large binary files only) */
+#endif
     }
 
 /*---------------------------------------------------------------------------
@@ -1576,19 +2880,58 @@ static int extract_or_test_member(pG)    /* return PK-type error code */
 #endif
             (*(Uz_Globs *)pG).outptr = redirSlide;
             (*(Uz_Globs *)pG).outcnt = 0L;
-            while ((b = NEXTBYTE) != EOF) {
-                *(*(Uz_Globs *)pG).outptr++ = (uch)b;
-                if (++(*(Uz_Globs *)pG).outcnt == wsize) {
-                    error = flush(pG, redirSlide, (*(Uz_Globs *)pG).outcnt, 0);
-                    (*(Uz_Globs *)pG).outptr = redirSlide;
-                    (*(Uz_Globs *)pG).outcnt = 0L;
-                    if (error != PK_COOL || (*(Uz_Globs *)pG).disk_full) break;
-                }
+#ifdef USE_INFLATE_INDEX
+            if ((r = range_member(pG)) >= 0) {   /* -r:  just the range */
+                error = r;
+                break;
             }
-            if ((*(Uz_Globs *)pG).outcnt) {        /* flush final (partial) buffer */
-                r = flush(pG, redirSlide, (*(Uz_Globs *)pG).outcnt, 0);
-                if (error < r) error = r;
+#endif
+#ifdef USE_PARALLEL
+            npieces = crc_split(pG, &pieces);
+#endif
+#ifdef USE_COPY_RANGE
+            error = copy_stored(pG, redirSlide, (unsigned)wsize);
+#endif
+#if (defined(DLL) && !defined(NO_SLIDE_REDIR))
+            if ((*(Uz_Globs *)pG).redirect_slide) {  /* data must pass through slide */
+                while ((b = NEXTBYTE) != EOF) {
+                    *(*(Uz_Globs *)pG).outptr++ = (uch)b;
+                    if (++(*(Uz_Globs *)pG).outcnt == wsize) {
+                        error = flush(pG, redirSlide, (*(Uz_Globs *)pG).outcnt, 0);
+                        (*(Uz_Globs *)pG).outptr = redirSlide;
+                        (*(Uz_Globs *)pG).outcnt = 0L;
+                        if (error != PK_COOL || (*(Uz_Globs *)pG).disk_full) break;
+                    }
+                }
+                if ((*(Uz_Globs *)pG).outcnt) {    /* flush final (partial) buffer */
+                    r = flush(pG, redirSlide, (*(Uz_Globs *)pG).outcnt, 0);
+                    if (error < r) error = r;
+                }
+            } else
+#endif
+            /* no need to copy the data into slide[] first:  hand flush()
+             * whatever the input buffer holds, which it runs through the
+             * CRC and writes out in one go (only text conversion has no
+             * room for more than wsize bytes at once) */
+            for (;;) {
+                if ((*(Uz_Globs *)pG).incnt <= 0) {
+                    if ((b = NEXTBYTE) == EOF)  /* refill, or end of data */
+                        break;
+                    --(*(Uz_Globs *)pG).inptr;  /* (give back that byte) */
+                    ++(*(Uz_Globs *)pG).incnt;
+                }
+                n = (ulg)(*(Uz_Globs *)pG).incnt;
+                if ((*(Uz_Globs *)pG).pInfo->textmode && n > (ulg)wsize)
+                    n = (ulg)wsize;
+                error = flush(pG, (*(Uz_Globs *)pG).inptr, n, 0);
+                (*(Uz_Globs *)pG).inptr += n;
+                (*(Uz_Globs *)pG).incnt -= (int)n;
+                if (error != PK_COOL || (*(Uz_Globs *)pG).disk_full) break;
             }
+#ifdef USE_PARALLEL
+            if (npieces)
+                crc_join(pG, pieces, npieces, redirSlide, (unsigned)wsize);
+#endif
             break;
 
         case SHRUNK:
@@ -1698,9 +3041,39 @@ static int extract_or_test_member(pG)    /* return PK-type error code */
 #ifndef USE_ZLIB  /* zlib's function is called inflate(), too */
 #  define UZinflate inflate
 #endif
-            if ((r = UZinflate(pG,
-                               ((*(Uz_Globs *)pG).lrec.compression_method == ENHDEFLATED)))
-                != 0) {
+            r = -1;
+#ifdef USE_INFLATE_INDEX
+            /* just a byte range (-r), or with checkpoints for one (-k)? */
+            if ((r = range_member(pG)) < 0)
+                r = index_inflate(pG,
+                                  ((*(Uz_Globs *)pG).lrec.compression_method == ENHDEFLATED));
+#endif
+#ifdef USE_PAR_INFLATE
+            /* a very large member on several threads (-H)? */
+            if (r < 0)
+                r = par_inflate(pG,
+                                ((*(Uz_Globs *)pG).lrec.compression_method == ENHDEFLATED));
+#endif
+            if (r < 0) {
+#ifdef USE_MMAP_OUTPUT
+                map_outfile(pG);    /* inflate straight into the outfile? */
+#endif
+#ifdef EXT_INFLATE
+                /* the library backend first; it declines (-1) what it can't do */
+                if ((r = ext_inflate(pG,
+                                   ((*(Uz_Globs *)pG).lrec.compression_method == ENHDEFLATED)))
+                    < 0)
+#endif
+                r = UZinflate(pG,
+                              ((*(Uz_Globs *)pG).lrec.compression_method == ENHDEFLATED));
+#ifdef USE_MMAP_OUTPUT
+                if (r == 0)
+                    r = unmap_outfile(pG);
+                else
+                    unmap_outfile(pG);
+#endif
+            }
+            if (r != 0) {
                 if (r < PK_DISK) {
                     if ((uO.tflag && uO.qflag) || (!uO.tflag && !QCOND2))
                         Info(slide, 0x401, ((char *)slide,
@@ -1768,6 +3141,17 @@ static int extract_or_test_member(pG)    /* return PK-type error code */
     machines (redundant on 32-bit machines).
   ---------------------------------------------------------------------------*/
 
+#ifdef USE_WRITEV
+    if (drain_outfile(pG) != PK_OK && error < PK_DISK)   /* (the last of it) */
+        error = PK_DISK;
+#endif
+#ifdef USE_SPARSE
+    if (finish_sparse(pG) != PK_OK && error < PK_DISK)   /* (trailing hole) */
+        error = PK_DISK;
+#endif
+#ifdef USE_PREALLOC
+    trim_outfile(pG);       /* (what was reserved past the end of the data) */
+#endif
 #ifdef VMS                  /* VMS:  required even for stdout! (final flush) */
     if (!uO.tflag)           /* don't close NULL file */
         close_outfile(pG);
@@ -1806,11 +3190,23 @@ static int extract_or_test_member(pG)    /* return PK-type error code */
         }
     }
 
+#ifdef USE_MMAP_INPUT
+    /* zipmap_fault() put zeros in place of some of the data read */
+    if (zipmap_faulted(pG) && error <= PK_WARN) {
+        if ((uO.tflag && uO.qflag) || (!uO.tflag && !QCOND2))
+            Info(slide, 0x401, ((char *)slide, "%-22s ",
+              FnFilter1((*(Uz_Globs *)pG).filename)));
+        Info(slide, 0x401, ((char *)slide, LoadFarString(ZipfileShrunk)));
+        error = PK_ERR;
+    }
+#endif
+
     if (error > PK_WARN) {/* don't print redundant CRC error if error already */
         undefer_input(pG);
         return error;
     }
-    if ((*(Uz_Globs *)pG).crc32val != (*(Uz_Globs *)pG).lrec.crc32) {
+    if (!(*(Uz_Globs *)pG).range_part &&
+        (*(Uz_Globs *)pG).crc32val != (*(Uz_Globs *)pG).lrec.crc32) {
         /* if quiet enough, we haven't output the filename yet:  do it */
         if ((uO.tflag && uO.qflag) || (!uO.tflag && !QCOND2))
             Info(slide, 0x401, ((char *)slide, "%-22s ",
@@ -2509,6 +3905,45 @@ static int Cdecl dircomp(a, b)  /* used by qsort(); swiped from Zip */
 #endif /* SET_DIR_ATTRIB */
 
 
+
+
+/***************************/
+/*  Function offsetcomp()  */
+/***************************/
+
+static int Cdecl offsetcomp(a, b)  /* used by qsort() */
+    const void *a, *b;
+{
+    zoff_t oa = (*(min_info **)a)->offset, ob = (*(min_info **)b)->offset;
+
+    /* (entries claiming the same offset keep central-directory order) */
+    if (oa != ob)
+        return (oa < ob)? -1 : 1;
+    return (*(min_info **)a < *(min_info **)b)? -1 : 1;
+}
+
+
+
+#ifdef USE_PARALLEL
+
+/************************/
+/*  Function keycomp()  */
+/************************/
+
+static int Cdecl keycomp(a, b)  /* used by qsort() */
+    const void *a, *b;
+{
+    int r = strcmp(((xname *)a)->key, ((xname *)b)->key);
+
+    /* (the same file:  central-directory order) */
+    if (r != 0)
+        return r;
+    return (((xname *)a)->info < ((xname *)b)->info)? -1 : 1;
+}
+
+#endif /* USE_PARALLEL */
+
+
 #ifdef USE_BZIP2
 
 /**************************/
@@ -2631,7 +4066,7 @@ Uz_Globs *pG;
 #endif
 
     (*(Uz_Globs *)pG).inptr = (uch *)bstrm.next_in;
-    (*(Uz_Globs *)pG).incnt = ((*(Uz_Globs *)pG).inbuf + INBUFSIZ) - (*(Uz_Globs *)pG).inptr;  /* reset for other routines */
+    (*(Uz_Globs *)pG).incnt = ((*(Uz_Globs *)pG).inbuf + (*(Uz_Globs *)pG).inbuf_len) - (*(Uz_Globs *)pG).inptr;  /* reset for other routines */
 
 uzbunzip_cleanup_exit:
     err = BZ2_bzDecompressEnd(&bstrm);
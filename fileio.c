@@ -15,14 +15,46 @@
   of the stuff has to do with opening, closing, reading and/or writing files.
 
   Contains:  open_input_file()
+             grow_inbuf()
+             close_infile()           (USE_MMAP_INPUT, USE_PREFETCH or
+                                       USE_IO_URING only)
              open_outfile()           (not: VMS, AOS/VS, CMSMVS, MACOS, TANDEM)
              undefer_input()
              defer_leftover_input()
              readbuf()
              readbyte()
-             fillinbuf()
+             fillinbuf()              (USE_ZLIB, USE_BZIP2, EXT_INFLATE)
+             zipmap_covers()          (USE_MMAP_INPUT only)
+             zipmap_faulted()         (USE_MMAP_INPUT only)
+             zipf_pread()
+             fill_inbuf_at()
+             set_inbufsiz()
+             prefetch_member()
+             prefetch_free()
+             queue_readahead()        (USE_IO_URING only)
+             submit_readahead()       (USE_IO_URING only)
+             drop_readahead()         (USE_IO_URING only)
+             free_readahead()         (USE_IO_URING only)
              seek_zipf()
              flush()                  (non-VMS)
+             kernel_copy()            (non-VMS, USE_COPY_RANGE only)
+             copy_zipdata()           (non-VMS, USE_COPY_RANGE only)
+             prealloc_outfile()       (non-VMS, USE_PREALLOC only)
+             trim_outfile()           (non-VMS, USE_PREALLOC only)
+             sparse_outfile()         (non-VMS, USE_SPARSE only)
+             zero_block()             (non-VMS, USE_SPARSE only)
+             write_sparse()           (non-VMS, USE_SPARSE only)
+             finish_sparse()          (non-VMS, USE_SPARSE only)
+             writev_all()             (non-VMS, USE_WRITEV only)
+             writer_thread()          (non-VMS, USE_ASYNC_WRITE only)
+             start_writer()           (non-VMS, USE_ASYNC_WRITE only)
+             queue_outbuf()           (non-VMS, USE_ASYNC_WRITE only)
+             write_outbuf()           (non-VMS, USE_WRITEV only)
+             drain_outfile()          (non-VMS, USE_WRITEV only)
+             free_writer()            (non-VMS, USE_ASYNC_WRITE only)
+             map_outfile()            (non-VMS, USE_MMAP_OUTPUT only)
+             flush_outmap()           (non-VMS, USE_MMAP_OUTPUT only)
+             unmap_outfile()          (non-VMS, USE_MMAP_OUTPUT only)
              is_vms_varlen_txt()      (non-VMS, VMS_TEXT_CONV only)
              disk_error()             (non-VMS)
              UzpMessagePrnt()
@@ -73,6 +105,9 @@
 #include "ttyio.h"
 
 #include "ebcdic.h"   /* definition/initialization of ebcdic[] */
+#if (defined(USE_SPARSE) && defined(__SSE2__))
+#  include <emmintrin.h>  /* zero_block() */
+#endif
 
 
 /*
@@ -117,6 +152,63 @@
 */
 #  define WriteTxtErr(buf,len,strm)  WriteError(buf,len,strm)
 
+#ifdef USE_MMAP_INPUT
+/* the mappings zipmap_fault() takes care of:  the main one and -w's */
+static struct {
+    uch *volatile map;
+    volatile size_t len;
+} guard_maps[MAX_THREADS + 1];
+static size_t guard_page;
+static volatile sig_atomic_t guard_faults = 0;
+#endif
+
+/* localtime()'s static result would be shared by all extraction threads */
+#ifdef USE_PARALLEL
+#  define LOCALTIME(t, buf)  localtime_r(t, buf)
+#else
+#  define LOCALTIME(t, buf)  localtime(t)
+#endif
+
+static int next_inbuf OF((Uz_Globs *pG));
+static void grow_inbuf OF((Uz_Globs *pG));
+#ifdef USE_MMAP_INPUT
+   static int guard_zipmap OF((Uz_Globs *pG, int on));
+   static void zipmap_fault OF((int sig, siginfo_t *si, void *ctx));
+#endif
+#ifdef USE_PREAD
+   static int pread_full OF((int fd, uch *buf, unsigned size, zoff_t offset));
+#endif
+#ifdef USE_PREFETCH
+   static void *prefetch_thread OF((void *arg));
+   static int prefetch_take OF((Uz_Globs *pG, zoff_t bufstart, unsigned size));
+   static void prefetch_cancel OF((Uz_Globs *pG));
+#endif
+#ifdef USE_IO_URING
+   static void *readahead_init OF((Uz_Globs *pG));
+   static void readahead_reap OF((void *ra, int until));
+   static int readahead_take OF((Uz_Globs *pG, zoff_t bufstart,
+                                 unsigned *plen));
+#endif
+#ifdef USE_COPY_RANGE
+   static zoff_t kernel_copy OF((int infd, int outfd, zoff_t offset,
+                                 zoff_t len, int *err));
+#endif
+#ifdef USE_SPARSE
+   static int zero_block OF((const uch *p, unsigned n));
+   static int write_sparse OF((Uz_Globs *pG, uch *buf, ulg size));
+#endif
+#ifdef USE_WRITEV
+   static int writev_all OF((int fd, struct iovec *iov, int cnt));
+   static int write_outbuf OF((Uz_Globs *pG, uch *buf, ulg size));
+#endif
+#ifdef USE_ASYNC_WRITE
+   static void *writer_thread OF((void *arg));
+   static void start_writer OF((Uz_Globs *pG));
+   static int queue_outbuf OF((Uz_Globs *pG));
+#endif
+#ifdef USE_MMAP_OUTPUT
+   static int flush_outmap OF((Uz_Globs *pG, uch *rawbuf, ulg size));
+#endif
 static int disk_error OF((Uz_Globs *pG));
 
 
@@ -201,6 +293,58 @@ open_input_file (    /* return 1 if open failed */
           (*(Uz_Globs *)pG).zipfn, strerror(errno)));
         return 1;
     }
+
+#ifdef USE_MMAP_INPUT
+    /*
+     *  if the zipfile is a plain (seekable) file, map it read-only so that
+     *  the input buffer can point straight into the page cache; pipes,
+     *  devices and anything mmap() refuses keep using read() into inbuf[].
+     *  So do zipfiles of more than MMAP_INPUT_MAX bytes (UNZIP_MAPMAX=size
+     *  in the environment, 0 for none), which are read ahead instead by
+     *  prefetch_member() and queue_readahead(), rather than have the page
+     *  tables of a mapping that large set up fault by fault; -H, -k and -r
+     *  work on the mapping only, though, and have it anyway.
+     */
+    (*(Uz_Globs *)pG).zipmap = (uch *)NULL;
+    (*(Uz_Globs *)pG).zipmaplen = 0;
+    (*(Uz_Globs *)pG).zipmap_faults = guard_faults;
+    {
+        z_stat zstatbuf;
+        void *map;
+        zoff_t max = (zoff_t)MMAP_INPUT_MAX;
+        char *p, *end;
+
+        if ((p = getenv("UNZIP_MAPMAX")) != NULL && isdigit((uch)*p)) {
+            max = (zoff_t)strtoul(p, &end, 10);
+            if (*end == 'k' || *end == 'K')
+                max <<= 10;
+            else if (*end == 'm' || *end == 'M')
+                max <<= 20;
+            else if (*end == 'g' || *end == 'G')
+                max <<= 30;
+        }
+        if (zfstat(fileno((*(Uz_Globs *)pG).zipfd), &zstatbuf) == 0 &&
+            S_ISREG(zstatbuf.st_mode) && zstatbuf.st_size > 0 &&
+            (zoff_t)(size_t)zstatbuf.st_size == (zoff_t)zstatbuf.st_size &&
+            ((zoff_t)zstatbuf.st_size <= max ||
+             uO.H_size != 0 || uO.k_size != 0 || uO.r_flag))
+        {
+            map = mmap(NULL, (size_t)zstatbuf.st_size, PROT_READ, MAP_SHARED,
+                       fileno((*(Uz_Globs *)pG).zipfd), 0);
+            if (map != MAP_FAILED) {
+                (*(Uz_Globs *)pG).zipmap = (uch *)map;
+                (*(Uz_Globs *)pG).zipmaplen = (zoff_t)zstatbuf.st_size;
+                if (!guard_zipmap(pG, TRUE)) {
+                    munmap(map, (size_t)zstatbuf.st_size);
+                    (*(Uz_Globs *)pG).zipmap = (uch *)NULL;
+                    (*(Uz_Globs *)pG).zipmaplen = 0;
+                }
+            }
+        }
+    }
+    if ((*(Uz_Globs *)pG).zipmap == (uch *)NULL)
+#endif /* USE_MMAP_INPUT */
+        grow_inbuf(pG);     /* reads go into inbuf[] */
     return 0;
 
 } /* end function open_input_file() */
@@ -208,6 +352,175 @@ open_input_file (    /* return 1 if open failed */
 
 
 
+#ifdef USE_MMAP_INPUT
+
+/***************************/
+/* Function guard_zipmap() */
+/***************************/
+
+static int 
+guard_zipmap (   /* return FALSE if the mapping cannot be guarded */
+    Uz_Globs *pG,
+    int on
+)
+{
+/*
+ *  A zipfile that another process truncates while it is mapped makes the
+ *  pages beyond its new end raise SIGBUS when they are read.  Have
+ *  zipmap_fault() take such faults in zipmap[] (on) or stop doing so
+ *  before it is unmapped (!on).  The mappings are made and dropped by the
+ *  main thread only, so the table needs no lock; zipmap_fault() may see
+ *  a slot half set up, but never for a mapping that is in use.
+ */
+    static int installed = FALSE;
+    struct sigaction sa;
+    int i;
+
+    if (!on) {
+        for (i = 0;  i <= MAX_THREADS;  ++i)
+            if (guard_maps[i].map == (*(Uz_Globs *)pG).zipmap)
+                guard_maps[i].map = (uch *)NULL;
+        return TRUE;
+    }
+    if (!installed) {
+        guard_page = (size_t)getpagesize();
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = zipmap_fault;
+        sa.sa_flags = SA_SIGINFO;
+        sigemptyset(&sa.sa_mask);
+        if (sigaction(SIGBUS, &sa, NULL) != 0)
+            return FALSE;
+        installed = TRUE;
+    }
+    for (i = 0;  i <= MAX_THREADS;  ++i)
+        if (guard_maps[i].map == (uch *)NULL) {
+            guard_maps[i].len = (size_t)(*(Uz_Globs *)pG).zipmaplen;
+            guard_maps[i].map = (*(Uz_Globs *)pG).zipmap;
+            return TRUE;
+        }
+    return FALSE;
+
+} /* end function guard_zipmap() */
+
+
+
+
+
+/***************************/
+/* Function zipmap_fault() */
+/***************************/
+
+static void 
+zipmap_fault (int sig, siginfo_t *si, void *ctx)
+{
+/*
+ *  SIGBUS handler:  put a page of zeros in place of the faulting one, so
+ *  that the read goes on and ends in a CRC or data error at worst, and
+ *  count it for zipmap_faulted() to report as a read error.  Once that
+ *  has happened, zipmap_covers() sends all reads to zipf_pread(), which
+ *  sees the shorter file as such.  A fault anywhere else is not ours:
+ *  back to the default action, which the faulting access then meets.
+ */
+    uch *p = (uch *)si->si_addr;
+    uch *map;
+    int i;
+
+    ctx = ctx;
+    for (i = 0;  i <= MAX_THREADS;  ++i) {
+        map = guard_maps[i].map;
+        if (map == (uch *)NULL || p < map || p >= map + guard_maps[i].len)
+            continue;
+        p = map + ((size_t)(p - map) & ~(guard_page - 1));
+        if (mmap((void *)p, guard_page, PROT_READ,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) ==
+            MAP_FAILED)
+            break;
+        ++guard_faults;
+        return;
+    }
+    signal(sig, SIG_DFL);
+
+} /* end function zipmap_fault() */
+
+#endif /* USE_MMAP_INPUT */
+
+
+
+
+
+/*************************/
+/* Function grow_inbuf() */
+/*************************/
+
+static void 
+grow_inbuf (Uz_Globs *pG)
+{
+/*
+ *  Make inbuf_mem[] as large as the reads can be.  That is left to here,
+ *  as with the zipfile mapped, inbuf points into the mapping instead and
+ *  a large -I size needs no memory.  If it cannot be had, the reads stay
+ *  as small as the buffer is.
+ */
+    uch *p;
+
+    if ((*(Uz_Globs *)pG).inbuf_memsiz >= (*(Uz_Globs *)pG).inbuf_max)
+        return;
+    if ((p = (uch *)realloc((*(Uz_Globs *)pG).inbuf_mem,
+                            (*(Uz_Globs *)pG).inbuf_max + 4)) == (uch *)NULL)
+        (*(Uz_Globs *)pG).inbuf_max = (*(Uz_Globs *)pG).inbuf_memsiz;
+    else {
+        (*(Uz_Globs *)pG).inbuf_mem = p;
+        (*(Uz_Globs *)pG).inbuf_memsiz = (*(Uz_Globs *)pG).inbuf_max;
+    }
+    (*(Uz_Globs *)pG).inbuf = (*(Uz_Globs *)pG).inptr = (*(Uz_Globs *)pG).inbuf_mem;
+    (*(Uz_Globs *)pG).hold = (*(Uz_Globs *)pG).inbuf + INBUFSIZ;
+    (*(Uz_Globs *)pG).incnt = 0;
+    (*(Uz_Globs *)pG).inbuf_len = 0;
+    set_inbufsiz(pG, (zusz_t)0);
+
+} /* end function grow_inbuf() */
+
+
+
+
+#if (defined(USE_MMAP_INPUT) || defined(USE_PREFETCH) || defined(USE_IO_URING))
+
+/***************************/
+/* Function close_infile() */
+/***************************/
+
+int 
+close_infile (Uz_Globs *pG)
+{
+#ifdef USE_PREFETCH
+    prefetch_cancel(pG);        /* also takes inbuf back from the ring */
+#endif
+#ifdef USE_IO_URING
+    drop_readahead(pG);
+#endif
+#ifdef USE_MMAP_INPUT
+    if ((*(Uz_Globs *)pG).zipmap != (uch *)NULL) {
+        guard_zipmap(pG, FALSE);
+        munmap((void *)(*(Uz_Globs *)pG).zipmap,
+               (size_t)(*(Uz_Globs *)pG).zipmaplen);
+        (*(Uz_Globs *)pG).zipmap = (uch *)NULL;
+        (*(Uz_Globs *)pG).zipmaplen = 0;
+        /* inbuf may still point into the mapping:  give it its buffer back */
+        (*(Uz_Globs *)pG).inbuf = (*(Uz_Globs *)pG).inptr =
+          (*(Uz_Globs *)pG).inbuf_mem;
+        (*(Uz_Globs *)pG).incnt = 0;
+        (*(Uz_Globs *)pG).inbuf_len = 0;
+    }
+#endif
+    return close((*(Uz_Globs *)pG).zipfd);
+
+} /* end function close_infile() */
+
+#endif /* USE_MMAP_INPUT || USE_PREFETCH || USE_IO_URING */
+
+
+
+
 #if (!defined(VMS) && !defined(AOS_VS) && !defined(CMS_MVS) && !defined(MACOS))
 #if (!defined(TANDEM))
 
@@ -533,7 +846,7 @@ readbuf (   /* return number of bytes read into buf */
     n = size;
     while (size) {
         if ((*(Uz_Globs *)pG).incnt <= 0) {
-            if (((*(Uz_Globs *)pG).incnt = read((*(Uz_Globs *)pG).zipfd, (char *)(*(Uz_Globs *)pG).inbuf, INBUFSIZ)) == 0)
+            if (((*(Uz_Globs *)pG).incnt = next_inbuf(pG)) == 0)
                 return (n-size);
             else if ((*(Uz_Globs *)pG).incnt < 0) {
                 /* another hack, but no real harm copying same thing twice */
@@ -542,9 +855,6 @@ readbuf (   /* return number of bytes read into buf */
                   (ulg)strlen(LoadFarString(ReadError)), 0x401);
                 return 0;  /* discarding some data; better than lock-up */
             }
-            /* buffer ALWAYS starts on a block boundary:  */
-            (*(Uz_Globs *)pG).cur_zipfile_bufstart += INBUFSIZ;
-            (*(Uz_Globs *)pG).inptr = (*(Uz_Globs *)pG).inbuf;
         }
         count = MIN(size, (unsigned)(*(Uz_Globs *)pG).incnt);
         memcpy(buf, (*(Uz_Globs *)pG).inptr, count);
@@ -578,7 +888,7 @@ readbyte (   /* refill inbuf and return a byte if available, else EOF */
         return EOF;
     }
     if ((*(Uz_Globs *)pG).incnt <= 0) {
-        if (((*(Uz_Globs *)pG).incnt = read((*(Uz_Globs *)pG).zipfd, (char *)(*(Uz_Globs *)pG).inbuf, INBUFSIZ)) == 0) {
+        if (((*(Uz_Globs *)pG).incnt = next_inbuf(pG)) == 0) {
             return EOF;
         } else if ((*(Uz_Globs *)pG).incnt < 0) {  /* "fail" (abort, retry, ...) returns this */
             /* another hack, but no real harm copying same thing twice */
@@ -593,8 +903,6 @@ readbyte (   /* refill inbuf and return a byte if available, else EOF */
             EXIT(PK_BADERR);    /* totally bailing; better than lock-up */
 #endif
         }
-        (*(Uz_Globs *)pG).cur_zipfile_bufstart += INBUFSIZ; /* always starts on block bndry */
-        (*(Uz_Globs *)pG).inptr = (*(Uz_Globs *)pG).inbuf;
         defer_leftover_input(pG);           /* decrements (*(Uz_Globs *)pG).csize */
     }
 
@@ -608,7 +916,7 @@ readbyte (   /* refill inbuf and return a byte if available, else EOF */
 
 
 
-#if defined(USE_ZLIB) || defined(USE_BZIP2)
+#if defined(USE_ZLIB) || defined(USE_BZIP2) || defined(EXT_INFLATE)
 
 /************************/
 /* Function fillinbuf() */
@@ -620,10 +928,8 @@ fillinbuf ( /* like readbyte() except returns number of bytes in inbuf */
 )
 {
     if ((*(Uz_Globs *)pG).mem_mode ||
-                  ((*(Uz_Globs *)pG).incnt = read((*(Uz_Globs *)pG).zipfd, (char *)(*(Uz_Globs *)pG).inbuf, INBUFSIZ)) <= 0)
+                  ((*(Uz_Globs *)pG).incnt = next_inbuf(pG)) <= 0)
         return 0;
-    (*(Uz_Globs *)pG).cur_zipfile_bufstart += INBUFSIZ;  /* always starts on a block boundary */
-    (*(Uz_Globs *)pG).inptr = (*(Uz_Globs *)pG).inbuf;
     defer_leftover_input(pG);           /* decrements (*(Uz_Globs *)pG).csize */
 
 
@@ -631,157 +937,1212 @@ fillinbuf ( /* like readbyte() except returns number of bytes in inbuf */
 
 } /* end function fillinbuf() */
 
-#endif /* USE_ZLIB || USE_BZIP2 */
+#endif /* USE_ZLIB || USE_BZIP2 || EXT_INFLATE */
 
 
 
 
 
-/************************/
-/* Function seek_zipf() */
-/************************/
+/*************************/
+/* Function next_inbuf() */
+/*************************/
 
-int 
-seek_zipf (Uz_Globs *pG, zoff_t abs_offset)
+static int 
+next_inbuf (    /* refill inbuf with the block following the current one */
+    Uz_Globs *pG
+)
 {
-/*
- *  Seek to the block boundary of the block which includes abs_offset,
- *  then read block into input buffer and set pointers appropriately.
- *  If block is already in the buffer, just set the pointers.  This function
- *  is used by do_seekable (process.c), extract_or_test_entrylist (extract.c)
- *  and do_string (fileio.c).  Also, a slightly modified version is embedded
- *  within extract_or_test_entrylist (extract.c).  readbyte() and readbuf()
- *  (fileio.c) are compatible.  NOTE THAT abs_offset is intended to be the
- *  "proper offset" (i.e., if there were no extra bytes prepended);
- *  cur_zipfile_bufstart contains the corrected offset.
- *
- *  Since seek_zipf() is never used during decompression, it is safe to
- *  use the slide[] buffer for the error message.
- *
- * returns PK error codes:
- *  PK_BADERR if effective offset in zipfile is negative
- *  PK_EOF if seeking past end of zipfile
- *  PK_OK when seek was successful
- */
-    zoff_t request = abs_offset + (*(Uz_Globs *)pG).extra_bytes;
-    zoff_t inbuf_offset = request % INBUFSIZ;
-    zoff_t bufstart = request - inbuf_offset;
+    int count;
+#ifdef USE_IO_URING
+    unsigned len;
+#endif
+    zoff_t bufstart = (*(Uz_Globs *)pG).cur_zipfile_bufstart +
+                      (*(Uz_Globs *)pG).inbuf_len;
 
-    if (request < 0) {
-        Info(slide, 1, ((char *)slide, LoadFarStringSmall(SeekMsg),
-             (*(Uz_Globs *)pG).zipfn, LoadFarString(ReportMsg)));
-        return(PK_BADERR);
-    } else if (bufstart != (*(Uz_Globs *)pG).cur_zipfile_bufstart) {
-        Trace((stderr,
-          "fpos_zip: abs_offset = %s, (*(Uz_Globs *)pG).extra_bytes = %s\n",
-          FmZofft(abs_offset, NULL, NULL),
-          FmZofft((*(Uz_Globs *)pG).extra_bytes, NULL, NULL)));
-        zfseeko((*(Uz_Globs *)pG).zipfd, bufstart, SEEK_SET);
-        (*(Uz_Globs *)pG).cur_zipfile_bufstart = zftello((*(Uz_Globs *)pG).zipfd);
-        Trace((stderr,
-          "       request = %s, (abs+extra) = %s, inbuf_offset = %s\n",
-          FmZofft(request, NULL, NULL),
-          FmZofft((abs_offset+(*(Uz_Globs *)pG).extra_bytes), NULL, NULL),
-          FmZofft(inbuf_offset, NULL, NULL)));
-        Trace((stderr, "       bufstart = %s, cur_zipfile_bufstart = %s\n",
-          FmZofft(bufstart, NULL, NULL),
-          FmZofft((*(Uz_Globs *)pG).cur_zipfile_bufstart, NULL, NULL)));
-        if (((*(Uz_Globs *)pG).incnt = read((*(Uz_Globs *)pG).zipfd, (char *)(*(Uz_Globs *)pG).inbuf, INBUFSIZ)) <= 0)
-            return(PK_EOF);
-        (*(Uz_Globs *)pG).incnt -= (int)inbuf_offset;
-        (*(Uz_Globs *)pG).inptr = (*(Uz_Globs *)pG).inbuf + (int)inbuf_offset;
-    } else {
-        (*(Uz_Globs *)pG).incnt += ((*(Uz_Globs *)pG).inptr-(*(Uz_Globs *)pG).inbuf) - (int)inbuf_offset;
-        (*(Uz_Globs *)pG).inptr = (*(Uz_Globs *)pG).inbuf + (int)inbuf_offset;
+#ifdef USE_MMAP_INPUT
+    if (zipmap_covers(pG, (zoff_t)0, (zoff_t)0)) {
+        if (bufstart >= (*(Uz_Globs *)pG).zipmaplen)
+            return 0;
+        count = fill_inbuf_at(pG, bufstart, (*(Uz_Globs *)pG).inbufsiz);
+#ifdef USE_PREFETCH
+        /* let the kernel page in the following block meanwhile */
+        bufstart += count;
+        if (count > 0 && bufstart < (*(Uz_Globs *)pG).prefetch_end) {
+            zoff_t pgstart = bufstart & ~(zoff_t)(getpagesize() - 1);
+
+            madvise((void *)((*(Uz_Globs *)pG).zipmap + (size_t)pgstart),
+                    (size_t)(MIN(bufstart + count,
+                                 (*(Uz_Globs *)pG).prefetch_end) - pgstart),
+                    MADV_WILLNEED);
+        }
+#endif
+        return count;
     }
-    return(PK_OK);
-} /* end function seek_zipf() */
+#endif
+#ifdef USE_PREFETCH
+    if ((count = prefetch_take(pG, bufstart, (*(Uz_Globs *)pG).inbufsiz)) > 0) {
+        (*(Uz_Globs *)pG).cur_zipfile_bufstart = bufstart;
+        (*(Uz_Globs *)pG).inbuf_len = (*(Uz_Globs *)pG).inbufsiz;
+        (*(Uz_Globs *)pG).inptr = (*(Uz_Globs *)pG).inbuf;
+        return count;
+    }
+#endif
+    (*(Uz_Globs *)pG).inbuf = (*(Uz_Globs *)pG).inbuf_mem;
+#ifdef USE_IO_URING
+    if ((count = readahead_take(pG, bufstart, &len)) > 0) {
+        (*(Uz_Globs *)pG).cur_zipfile_bufstart = bufstart;
+        (*(Uz_Globs *)pG).inbuf_len = len;
+        (*(Uz_Globs *)pG).inptr = (*(Uz_Globs *)pG).inbuf;
+        return count;
+    }
+#endif
+    if ((count = zipf_pread(pG, (*(Uz_Globs *)pG).inbuf,
+                 (*(Uz_Globs *)pG).inbufsiz, bufstart)) > 0) {
+        /* buffer ALWAYS starts on a block boundary:  */
+        (*(Uz_Globs *)pG).cur_zipfile_bufstart = bufstart;
+        (*(Uz_Globs *)pG).inbuf_len = (*(Uz_Globs *)pG).inbufsiz;
+        (*(Uz_Globs *)pG).inptr = (*(Uz_Globs *)pG).inbuf;
+    }
+    return count;
 
+} /* end function next_inbuf() */
 
 
 
 
-#ifndef VMS  /* for VMS use code in vms.c */
 
-/********************/
-/* Function flush() */   /* returns PK error codes: */
-/********************/   /* if tflag => always 0; PK_DISK if write error */
+#ifdef USE_MMAP_INPUT
 
-int flush(pG, rawbuf, size, unshrink)
-    Uz_Globs *pG;
-    uch *rawbuf;
-    ulg size;
-    int unshrink;
+/****************************/
+/* Function zipmap_covers() */
+/****************************/
+
+int 
+zipmap_covers (   /* return TRUE if zipmap[offset, offset+len) may be used */
+    Uz_Globs *pG,
+    zoff_t offset,
+    zoff_t len
+)
 {
-    uch *p;
-    uch *q;
-    uch *transbuf;
-    /* static int didCRlast = FALSE;    moved to globals.h */
+    return (*(Uz_Globs *)pG).zipmap != (uch *)NULL && guard_faults == 0 &&
+           offset >= 0 && len <= (*(Uz_Globs *)pG).zipmaplen - offset;
 
+} /* end function zipmap_covers() */
 
-/*---------------------------------------------------------------------------
-    Compute the CRC first; if testing or if disk is full, that's it.
-  ---------------------------------------------------------------------------*/
 
-    (*(Uz_Globs *)pG).crc32val = crc32((*(Uz_Globs *)pG).crc32val, rawbuf, (extent)size);
 
-#ifdef DLL
-    if (((*(Uz_Globs *)pG).statreportcb != NULL) &&
-        (*(*(Uz_Globs *)pG).statreportcb)(pG, UZ_ST_IN_PROGRESS, (*(Uz_Globs *)pG).zipfn, (*(Uz_Globs *)pG).filename, NULL))
-        return IZ_CTRLC;        /* cancel operation by user request */
-#endif
 
-    if (uO.tflag || size == 0L)  /* testing or nothing to write:  all done */
-        return PK_OK;
 
-    if ((*(Uz_Globs *)pG).disk_full)
-        return PK_DISK;         /* disk already full:  ignore rest of file */
+/*****************************/
+/* Function zipmap_faulted() */
+/*****************************/
 
-/*---------------------------------------------------------------------------
-    Write the bytes rawbuf[0..size-1] to the output device, first converting
-    end-of-lines and ASCII/EBCDIC as needed.  If SMALL_MEM or MED_MEM are NOT
-    defined, outbuf is assumed to be at least as large as rawbuf and is not
-    necessarily checked for overflow.
-  ---------------------------------------------------------------------------*/
+int 
+zipmap_faulted (   /* return TRUE if a fault was taken since the last call */
+    Uz_Globs *pG
+)
+{
+    if ((*(Uz_Globs *)pG).zipmap_faults == guard_faults)
+        return FALSE;
+    (*(Uz_Globs *)pG).zipmap_faults = guard_faults;
+    return TRUE;
 
-    if (!(*(Uz_Globs *)pG).pInfo->textmode) {   /* write raw binary data */
-        /* GRR:  note that for standard MS-DOS compilers, size argument to
-         * fwrite() can never be more than 65534, so WriteError macro will
-         * have to be rewritten if size can ever be that large.  For now,
-         * never more than 32K.  Also note that write() returns an int, which
-         * doesn't necessarily limit size to 32767 bytes if write() is used
-         * on 16-bit systems but does make it more of a pain; however, because
-         * at least MSC 5.1 has a lousy implementation of fwrite() (as does
-         * DEC Ultrix cc), write() is used anyway.
-         */
-#ifdef DLL
-        if ((*(Uz_Globs *)pG).redirect_data) {
-#ifdef NO_SLIDE_REDIR
-            if (writeToMemory(pG, rawbuf, (extent)size)) return PK_ERR;
-#else
-            writeToMemory(pG, rawbuf, (extent)size);
+} /* end function zipmap_faulted() */
+
+#endif /* USE_MMAP_INPUT */
+
+
+
+
+/*************************/
+/* Function zipf_pread() */
+/*************************/
+
+int 
+zipf_pread (   /* return number of bytes read, -1 on read error */
+    Uz_Globs *pG,
+    uch *buf,
+    unsigned size,
+    zoff_t offset
+)
+{
+/*
+ *  Read size bytes from (corrected) zipfile offset offset into buf.  This
+ *  is the one place zipfile data are fetched from the file:  it neither
+ *  uses nor moves the file position of zipfd and does not touch the input
+ *  buffer state, so a single open zipfd may be shared by several readers.
+ *  Only a short count at end of file is returned as such; interrupted and
+ *  partial pread()s are retried.
+ */
+    if (offset < 0)
+        return -1;
+#ifdef USE_MMAP_INPUT
+    if (zipmap_covers(pG, offset, (zoff_t)0)) {
+        zoff_t avail = (*(Uz_Globs *)pG).zipmaplen - offset;
+
+        if (avail <= 0)
+            return 0;
+        if (avail < (zoff_t)size)
+            size = (unsigned)avail;
+        memcpy(buf, (*(Uz_Globs *)pG).zipmap + (size_t)offset, size);
+        return (int)size;
+    }
 #endif
-        } else
+#ifdef USE_PREAD
+    return pread_full(fileno((*(Uz_Globs *)pG).zipfd), buf, size, offset);
+#else
+    if (zfseeko((*(Uz_Globs *)pG).zipfd, offset, SEEK_SET) != 0)
+        return -1;
+    return read((*(Uz_Globs *)pG).zipfd, (char *)buf, size);
 #endif
-        if (!uO.cflag && WriteError(rawbuf, size, (*(Uz_Globs *)pG).outfile))
-            return disk_error(pG);
-        else if (uO.cflag && (*(*(Uz_Globs *)pG).message)((void *)&(*(Uz_Globs *)pG), rawbuf, size, 0))
-            return PK_OK;
-    } else {   /* textmode:  aflag is true */
-        if (unshrink) {
-            /* rawbuf = outbuf */
-            transbuf = (*(Uz_Globs *)pG).outbuf2;
-        } else {
-            /* rawbuf = slide */
-            transbuf = (*(Uz_Globs *)pG).outbuf;
-        }
-        if ((*(Uz_Globs *)pG).newfile) {
-            (*(Uz_Globs *)pG).didCRlast = FALSE;         /* no previous buffers written */
-            (*(Uz_Globs *)pG).newfile = FALSE;
-        }
 
+} /* end function zipf_pread() */
 
-    /*-----------------------------------------------------------------------
+
+
+
+
+#ifdef USE_PREAD
+
+/*************************/
+/* Function pread_full() */
+/*************************/
+
+static int 
+pread_full (   /* return number of bytes read, -1 on read error */
+    int fd,
+    uch *buf,
+    unsigned size,
+    zoff_t offset
+)
+{
+    unsigned got = 0;
+    ssize_t n;
+
+    while (got < size) {
+        n = pread(fd, (char *)buf + got, (size_t)(size - got),
+                  (off_t)(offset + got));
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return (got > 0)? (int)got : -1;
+        }
+        if (n == 0)
+            break;
+        got += (unsigned)n;
+    }
+    return (int)got;
+
+} /* end function pread_full() */
+
+#endif /* USE_PREAD */
+
+
+
+
+
+/****************************/
+/* Function fill_inbuf_at() */
+/****************************/
+
+int 
+fill_inbuf_at (   /* return number of bytes now in inbuf, <= 0 on error/EOF */
+    Uz_Globs *pG,
+    zoff_t bufstart,
+    unsigned size
+)
+{
+/*
+ *  Load size bytes of the zipfile, starting at the (corrected) offset
+ *  bufstart, into the input buffer and make that the current block:
+ *  cur_zipfile_bufstart, inptr and incnt are set up as after a fresh read,
+ *  and inbuf_len records the block size (the next block starts there; a
+ *  read queued by queue_readahead() may supply a larger block than asked
+ *  for).  size must not exceed inbuf_max.  When the zipfile is memory-
+ *  mapped, no data are copied at all; inbuf is simply pointed at the
+ *  corresponding part of the mapping (the boundary-spanning bytes that
+ *  rec_find() looks for in hold[] then are the next bytes of the mapping,
+ *  too).  Otherwise, or once the mapping has taken a fault (see
+ *  zipmap_fault()), zipf_pread() into inbuf (any read-ahead in progress
+ *  is dropped).
+ */
+#ifdef USE_MMAP_INPUT
+    if (zipmap_covers(pG, (zoff_t)0, (zoff_t)0)) {
+        zoff_t avail = (*(Uz_Globs *)pG).zipmaplen - bufstart;
+
+        if (bufstart < 0 || avail < 0)
+            avail = 0, bufstart = (*(Uz_Globs *)pG).zipmaplen;
+        (*(Uz_Globs *)pG).cur_zipfile_bufstart = bufstart;
+        (*(Uz_Globs *)pG).inbuf = (*(Uz_Globs *)pG).zipmap + (size_t)bufstart;
+        (*(Uz_Globs *)pG).inptr = (*(Uz_Globs *)pG).inbuf;
+        (*(Uz_Globs *)pG).inbuf_len = (avail > 0)? size : 0;
+        return ((*(Uz_Globs *)pG).incnt =
+                (avail < (zoff_t)size)? (int)avail : (int)size);
+    }
+#endif
+#ifdef USE_PREFETCH
+    prefetch_cancel(pG);
+#endif
+#ifdef USE_MMAP_INPUT
+    if ((*(Uz_Globs *)pG).zipmap != (uch *)NULL) {
+        grow_inbuf(pG);         /* inbuf_mem[] was left small */
+        if (size > (*(Uz_Globs *)pG).inbuf_max)
+            size = (*(Uz_Globs *)pG).inbuf_max;
+    }
+#endif
+    (*(Uz_Globs *)pG).inbuf = (*(Uz_Globs *)pG).inbuf_mem;
+    (*(Uz_Globs *)pG).cur_zipfile_bufstart = bufstart;
+    (*(Uz_Globs *)pG).inptr = (*(Uz_Globs *)pG).inbuf;
+#ifdef USE_IO_URING
+    if (((*(Uz_Globs *)pG).incnt = readahead_take(pG, bufstart, &size)) > 0) {
+        (*(Uz_Globs *)pG).inbuf_len = size;
+        return (*(Uz_Globs *)pG).incnt;
+    }
+#endif
+    (*(Uz_Globs *)pG).incnt =
+      zipf_pread(pG, (*(Uz_Globs *)pG).inbuf, size, bufstart);
+    /* nothing usable in inbuf[] after a failed read */
+    (*(Uz_Globs *)pG).inbuf_len = ((*(Uz_Globs *)pG).incnt > 0)? size : 0;
+    return (*(Uz_Globs *)pG).incnt;
+
+} /* end function fill_inbuf_at() */
+
+
+
+
+
+/***************************/
+/* Function set_inbufsiz() */
+/***************************/
+
+void 
+set_inbufsiz (
+    Uz_Globs *pG,
+    zusz_t streamlen    /* bytes about to be streamed; 0 = random access */
+)
+{
+/*
+ *  Choose the size of the following zipfile reads.  Unless a fixed size
+ *  was requested with -I, stay with small INBUFSIZ blocks while hopping
+ *  around in the central directory and local headers, and switch to large
+ *  reads (up to inbuf_max) only while the data of a big member are being
+ *  streamed.  The block granularity stays INBUFSIZ either way, so block
+ *  boundaries, hold[] and defer_leftover_input() are unaffected.
+ */
+    zusz_t size;
+
+    if (uO.I_bufsiz)
+        size = uO.I_bufsiz;
+    else if (streamlen > INBUFSIZ)
+        size = (streamlen + (INBUFSIZ-1)) / INBUFSIZ * INBUFSIZ;
+    else
+        size = INBUFSIZ;
+    (*(Uz_Globs *)pG).inbufsiz = (unsigned)MIN(size, (*(Uz_Globs *)pG).inbuf_max);
+
+} /* end function set_inbufsiz() */
+
+
+
+
+#ifdef USE_PREFETCH
+
+/*
+ *  Read-ahead ring.  While a member's data are being decompressed, a
+ *  background thread pread()s the following blocks into PREFETCH_BUFS
+ *  spare buffers; next_inbuf() then merely points inbuf at the finished
+ *  buffer instead of waiting for the disk.  Each slot goes FREE -> BUSY
+ *  (being read by the thread) -> READY -> HELD (it is the current inbuf)
+ *  -> FREE.  Bumping gen makes the thread throw away a read in flight.
+ */
+#define PF_FREE   0
+#define PF_BUSY   1
+#define PF_READY  2
+#define PF_HELD   3
+
+typedef struct prefetch_ring {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;        /* for the thread:  work to do, or quit */
+    pthread_cond_t done;        /* for the reader:  a slot became READY */
+    int fd;
+    int quit;
+    unsigned gen;
+    unsigned bufsiz;            /* size of buf[]s */
+    unsigned blksiz;            /* size of each read */
+    zoff_t next;                /* next offset for the thread to read ... */
+    zoff_t end;                 /* ... as long as it is below this */
+    zoff_t expect;              /* next block next_inbuf() should ask for */
+    int held;                   /* slot now serving as inbuf, or -1 */
+    int state[PREFETCH_BUFS];
+    int count[PREFETCH_BUFS];
+    zoff_t offset[PREFETCH_BUFS];
+    uch *buf[PREFETCH_BUFS];
+} prefetch_ring;
+
+
+
+/******************************/
+/* Function prefetch_thread() */
+/******************************/
+
+static void *
+prefetch_thread (void *arg)
+{
+    prefetch_ring *pf = (prefetch_ring *)arg;
+    unsigned gen, size;
+    zoff_t offset;
+    int i, n;
+
+    pthread_mutex_lock(&pf->lock);
+    while (!pf->quit) {
+        for (i = 0;  i < PREFETCH_BUFS && pf->state[i] != PF_FREE;  ++i)
+            ;
+        if (i == PREFETCH_BUFS || pf->next >= pf->end) {
+            pthread_cond_wait(&pf->wake, &pf->lock);
+            continue;
+        }
+        pf->state[i] = PF_BUSY;
+        pf->offset[i] = offset = pf->next;
+        size = pf->blksiz;
+        gen = pf->gen;
+        pf->next += size;
+        pthread_mutex_unlock(&pf->lock);
+
+        n = pread_full(pf->fd, pf->buf[i], size, offset);
+
+        pthread_mutex_lock(&pf->lock);
+        if (gen != pf->gen)             /* cancelled meanwhile */
+            pf->state[i] = PF_FREE;
+        else {
+            pf->state[i] = PF_READY;
+            pf->count[i] = n;
+            if (n < (int)size)          /* EOF or error:  no use going on */
+                pf->next = pf->end;
+        }
+        pthread_cond_broadcast(&pf->done);
+    }
+    pthread_mutex_unlock(&pf->lock);
+    return NULL;
+
+} /* end function prefetch_thread() */
+
+
+
+
+
+/******************************/
+/* Function prefetch_member() */
+/******************************/
+
+void 
+prefetch_member (Uz_Globs *pG)
+{
+/*
+ *  Called with the local header of a member just read and inbufsiz set
+ *  for streaming its data:  start reading ahead the blocks following the
+ *  current one, up to the end of the member's compressed data.  Members
+ *  that need no more than one further read are left alone.
+ */
+    prefetch_ring *pf = (prefetch_ring *)(*(Uz_Globs *)pG).prefetch;
+    zoff_t start, end;
+    sigset_t all, old;
+    int i;
+
+    start = (*(Uz_Globs *)pG).cur_zipfile_bufstart + (*(Uz_Globs *)pG).inbuf_len;
+    end = (*(Uz_Globs *)pG).cur_zipfile_bufstart +
+          ((*(Uz_Globs *)pG).inptr - (*(Uz_Globs *)pG).inbuf) + (zoff_t)(*(Uz_Globs *)pG).csize;
+    (*(Uz_Globs *)pG).prefetch_end = end;
+    if ((*(Uz_Globs *)pG).inbuf_len == 0 || end - start <= (zoff_t)(*(Uz_Globs *)pG).inbufsiz)
+        return;
+#ifdef USE_MMAP_INPUT
+    if ((*(Uz_Globs *)pG).zipmap != (uch *)NULL)
+        return;                 /* next_inbuf() madvise()s instead */
+#endif
+    /* reads larger than READAHEAD_BLKMAX (-I) are left to themselves */
+    if ((*(Uz_Globs *)pG).inbufsiz > (pf != (prefetch_ring *)NULL ? pf->bufsiz :
+         (unsigned)MIN((*(Uz_Globs *)pG).inbuf_max, READAHEAD_BLKMAX)))
+        return;
+
+    if (pf == (prefetch_ring *)NULL) {
+        if ((pf = (prefetch_ring *)calloc(1, sizeof(prefetch_ring))) ==
+            (prefetch_ring *)NULL)
+            return;             /* no read-ahead then; not an error */
+        pf->bufsiz = (unsigned)MIN((*(Uz_Globs *)pG).inbuf_max, READAHEAD_BLKMAX);
+        for (i = 0;  i < PREFETCH_BUFS;  ++i)
+            if ((pf->buf[i] = (uch *)malloc(pf->bufsiz)) == (uch *)NULL)
+                break;
+        pf->held = -1;
+        pthread_mutex_init(&pf->lock, NULL);
+        pthread_cond_init(&pf->wake, NULL);
+        pthread_cond_init(&pf->done, NULL);
+        /* signals are for the main thread only; the new thread inherits
+         * the blocked mask */
+        sigfillset(&all);
+        pthread_sigmask(SIG_SETMASK, &all, &old);
+        if (i < PREFETCH_BUFS ||
+            pthread_create(&pf->thread, NULL, prefetch_thread, pf) != 0)
+        {
+            pthread_sigmask(SIG_SETMASK, &old, NULL);
+            pthread_cond_destroy(&pf->done);
+            pthread_cond_destroy(&pf->wake);
+            pthread_mutex_destroy(&pf->lock);
+            for (i = 0;  i < PREFETCH_BUFS;  ++i)
+                if (pf->buf[i])
+                    free(pf->buf[i]);
+            free(pf);
+            return;
+        }
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+        (*(Uz_Globs *)pG).prefetch = (void *)pf;
+    }
+
+    pthread_mutex_lock(&pf->lock);
+    ++pf->gen;
+    for (i = 0;  i < PREFETCH_BUFS;  ++i)
+        if (pf->state[i] == PF_READY)
+            pf->state[i] = PF_FREE;
+    pf->fd = fileno((*(Uz_Globs *)pG).zipfd);
+    pf->blksiz = (*(Uz_Globs *)pG).inbufsiz;
+    pf->next = pf->expect = start;
+    pf->end = end;
+    pthread_cond_signal(&pf->wake);
+    pthread_mutex_unlock(&pf->lock);
+
+} /* end function prefetch_member() */
+
+
+
+
+
+/****************************/
+/* Function prefetch_take() */
+/****************************/
+
+static int 
+prefetch_take (   /* return byte count, 0 if block is not prefetched */
+    Uz_Globs *pG,
+    zoff_t bufstart,
+    unsigned size
+)
+{
+    prefetch_ring *pf = (prefetch_ring *)(*(Uz_Globs *)pG).prefetch;
+    int i, n = 0;
+
+    if (pf == (prefetch_ring *)NULL)
+        return 0;
+    pthread_mutex_lock(&pf->lock);
+    if (bufstart == pf->expect && size == pf->blksiz && bufstart < pf->end) {
+        for (;;) {
+            for (i = 0;  i < PREFETCH_BUFS;  ++i)
+                if (pf->state[i] != PF_FREE && pf->state[i] != PF_HELD &&
+                    pf->offset[i] == bufstart)
+                    break;
+            if (i < PREFETCH_BUFS && pf->state[i] == PF_READY)
+                break;
+            if (i == PREFETCH_BUFS && pf->next != bufstart)
+                break;          /* not coming:  read it ourselves */
+            pthread_cond_wait(&pf->done, &pf->lock);
+        }
+        if (i < PREFETCH_BUFS && (n = pf->count[i]) > 0) {
+            if (pf->held >= 0)
+                pf->state[pf->held] = PF_FREE;
+            pf->state[i] = PF_HELD;
+            pf->held = i;
+            pf->expect += size;
+            (*(Uz_Globs *)pG).inbuf = pf->buf[i];
+            pthread_cond_signal(&pf->wake);
+        } else
+            n = 0;
+    }
+    pthread_mutex_unlock(&pf->lock);
+    if (n <= 0)
+        prefetch_cancel(pG);    /* back to synchronous reads into inbuf_mem */
+    return n;
+
+} /* end function prefetch_take() */
+
+
+
+
+
+/******************************/
+/* Function prefetch_cancel() */
+/******************************/
+
+static void 
+prefetch_cancel (Uz_Globs *pG)
+{
+/*
+ *  Stop reading ahead and give inbuf back its own buffer; the caller is
+ *  about to refill it (or to close the zipfile).
+ */
+    prefetch_ring *pf = (prefetch_ring *)(*(Uz_Globs *)pG).prefetch;
+    int i;
+
+    if (pf == (prefetch_ring *)NULL)
+        return;
+    pthread_mutex_lock(&pf->lock);
+    ++pf->gen;
+    pf->next = pf->end = pf->expect = 0;
+    for (i = 0;  i < PREFETCH_BUFS;  ++i)
+        if (pf->state[i] != PF_BUSY)
+            pf->state[i] = PF_FREE;
+    pf->held = -1;
+    pthread_mutex_unlock(&pf->lock);
+    (*(Uz_Globs *)pG).inbuf = (*(Uz_Globs *)pG).inbuf_mem;
+
+} /* end function prefetch_cancel() */
+
+
+
+
+
+/****************************/
+/* Function prefetch_free() */
+/****************************/
+
+void 
+prefetch_free (Uz_Globs *pG)
+{
+    prefetch_ring *pf = (prefetch_ring *)(*(Uz_Globs *)pG).prefetch;
+    int i;
+
+    if (pf == (prefetch_ring *)NULL)
+        return;
+    prefetch_cancel(pG);
+    pthread_mutex_lock(&pf->lock);
+    pf->quit = TRUE;
+    pthread_cond_signal(&pf->wake);
+    pthread_mutex_unlock(&pf->lock);
+    pthread_join(pf->thread, NULL);
+    pthread_cond_destroy(&pf->done);
+    pthread_cond_destroy(&pf->wake);
+    pthread_mutex_destroy(&pf->lock);
+    for (i = 0;  i < PREFETCH_BUFS;  ++i)
+        free(pf->buf[i]);
+    free(pf);
+    (*(Uz_Globs *)pG).prefetch = (void *)NULL;
+
+} /* end function prefetch_free() */
+
+#endif /* USE_PREFETCH */
+
+
+
+
+#ifdef USE_IO_URING
+
+/*
+ *  Member read-ahead.  extract_or_test_entrylist() knows the offsets and
+ *  sizes of the members still to come in its block and passes them to
+ *  queue_readahead() while the current one is being processed.  Adjacent
+ *  ranges are merged into reads of up to READAHEAD_BLKMAX bytes (inbuf_max
+ *  if that is less), READAHEAD_SLOTS of which may be outstanding;
+ *  submit_readahead() hands the lot to an io_uring in a single
+ *  io_uring_enter() call.  fill_inbuf_at() and
+ *  next_inbuf() then take the data from a finished read instead of
+ *  calling pread() themselves, so archives of many small members no longer
+ *  pay one blocking system call per member.  Where the kernel lacks
+ *  io_uring (or has it disabled), the ranges are only passed on to
+ *  posix_fadvise(WILLNEED), and reads stay synchronous.
+ */
+#define RA_FREE    0
+#define RA_QUEUED  1            /* sqe filled in, not yet submitted */
+#define RA_BUSY    2            /* submitted */
+#define RA_DONE    3
+#define RA_DROPPED 4            /* submitted, but the data are not wanted */
+
+typedef struct readahead_queue {
+    int ringfd;                 /* -1:  no io_uring, posix_fadvise() only */
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_sz, cq_ring_sz, sqes_sz;
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    unsigned tail;              /* next sqe to fill in */
+    unsigned pending;           /* RA_QUEUED slots (sqes before tail) */
+    unsigned busy;              /* RA_BUSY and RA_DROPPED slots */
+    unsigned seq;
+    unsigned blksiz;            /* size of the iov buffers, most per read */
+    int last;                   /* slot queued most recently, or -1 */
+    zoff_t advised;             /* posix_fadvise():  end of hinted range */
+    int state[READAHEAD_SLOTS];
+    int count[READAHEAD_SLOTS];
+    unsigned order[READAHEAD_SLOTS];
+    zoff_t start[READAHEAD_SLOTS];
+    struct iovec iov[READAHEAD_SLOTS];
+} readahead_queue;
+
+#define RA_END(q, i)  ((q)->start[i] + (zoff_t)(q)->iov[i].iov_len)
+
+
+
+/*****************************/
+/* Function readahead_init() */
+/*****************************/
+
+static void *
+readahead_init (Uz_Globs *pG)
+{
+    readahead_queue *q;
+    struct io_uring_params p;
+    int i;
+
+    if ((q = (readahead_queue *)calloc(1, sizeof(readahead_queue))) ==
+        (readahead_queue *)NULL)
+        return NULL;
+    q->last = -1;
+    q->blksiz = (unsigned)MIN((*(Uz_Globs *)pG).inbuf_max, READAHEAD_BLKMAX);
+    for (i = 0;  i < READAHEAD_SLOTS;  ++i)
+        if ((q->iov[i].iov_base = malloc(q->blksiz)) == NULL)
+            break;
+
+    memzero(&p, sizeof(p));
+    if (i < READAHEAD_SLOTS || (q->ringfd = (int)syscall(__NR_io_uring_setup,
+                                 READAHEAD_SLOTS, &p)) < 0)
+    {
+        q->ringfd = -1;
+    } else {
+        q->sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        q->cq_ring_sz = p.cq_off.cqes +
+                        p.cq_entries * sizeof(struct io_uring_cqe);
+        if (p.features & IORING_FEAT_SINGLE_MMAP)
+            q->sq_ring_sz = q->cq_ring_sz = MAX(q->sq_ring_sz, q->cq_ring_sz);
+        q->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+        q->sq_ring = mmap(NULL, q->sq_ring_sz, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, q->ringfd,
+                          IORING_OFF_SQ_RING);
+        q->cq_ring = (p.features & IORING_FEAT_SINGLE_MMAP)? q->sq_ring :
+                     mmap(NULL, q->cq_ring_sz, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, q->ringfd,
+                          IORING_OFF_CQ_RING);
+        q->sqes = (struct io_uring_sqe *)mmap(NULL, q->sqes_sz,
+                          PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          q->ringfd, IORING_OFF_SQES);
+        if (q->sq_ring == MAP_FAILED || q->cq_ring == MAP_FAILED ||
+            (void *)q->sqes == MAP_FAILED)
+        {
+            if (q->sqes != MAP_FAILED)
+                munmap((void *)q->sqes, q->sqes_sz);
+            if (q->cq_ring != MAP_FAILED && q->cq_ring != q->sq_ring)
+                munmap(q->cq_ring, q->cq_ring_sz);
+            if (q->sq_ring != MAP_FAILED)
+                munmap(q->sq_ring, q->sq_ring_sz);
+            (close)(q->ringfd);   /* (not the fclose() macro) */
+            q->ringfd = -1;
+        } else {
+            q->sq_tail = (unsigned *)((char *)q->sq_ring + p.sq_off.tail);
+            q->sq_mask = (unsigned *)((char *)q->sq_ring + p.sq_off.ring_mask);
+            q->sq_array = (unsigned *)((char *)q->sq_ring + p.sq_off.array);
+            q->cq_head = (unsigned *)((char *)q->cq_ring + p.cq_off.head);
+            q->cq_tail = (unsigned *)((char *)q->cq_ring + p.cq_off.tail);
+            q->cq_mask = (unsigned *)((char *)q->cq_ring + p.cq_off.ring_mask);
+            q->cqes = (struct io_uring_cqe *)((char *)q->cq_ring +
+                                              p.cq_off.cqes);
+            q->tail = *q->sq_tail;
+        }
+    }
+    if (q->ringfd < 0) {        /* the buffers are of no use then */
+        for (i = 0;  i < READAHEAD_SLOTS;  ++i)
+            if (q->iov[i].iov_base != NULL) {
+                free(q->iov[i].iov_base);
+                q->iov[i].iov_base = NULL;
+            }
+    }
+    (*(Uz_Globs *)pG).readahead = (void *)q;
+    return (void *)q;
+
+} /* end function readahead_init() */
+
+
+
+
+
+/*****************************/
+/* Function readahead_reap() */
+/*****************************/
+
+static void 
+readahead_reap (
+    void *ra,
+    int until       /* slot to wait for; READAHEAD_SLOTS:  all; -1:  none */
+)
+{
+    readahead_queue *q = (readahead_queue *)ra;
+    struct io_uring_cqe *cqe;
+    unsigned head;
+    int i;
+
+    for (;;) {
+        head = *q->cq_head;
+        while (head != __atomic_load_n(q->cq_tail, __ATOMIC_ACQUIRE)) {
+            cqe = &q->cqes[head & *q->cq_mask];
+            i = (int)cqe->user_data;
+            if (q->state[i] == RA_BUSY) {
+                q->state[i] = RA_DONE;
+                q->count[i] = cqe->res;
+            } else
+                q->state[i] = RA_FREE;
+            --q->busy;
+            ++head;
+        }
+        __atomic_store_n(q->cq_head, head, __ATOMIC_RELEASE);
+        if (until < 0 || (until < READAHEAD_SLOTS?
+                          q->state[until] != RA_BUSY : q->busy == 0))
+            break;
+        if (syscall(__NR_io_uring_enter, q->ringfd, 0, 1,
+                    IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR)
+            break;
+    }
+
+} /* end function readahead_reap() */
+
+
+
+
+
+/******************************/
+/* Function queue_readahead() */
+/******************************/
+
+int 
+queue_readahead (   /* return FALSE if no more reads can be queued now */
+    Uz_Globs *pG,
+    zoff_t start,   /* (corrected) offset of a member's local header ... */
+    zoff_t end      /* ... and a guess at the end of its data */
+)
+{
+    readahead_queue *q = (readahead_queue *)(*(Uz_Globs *)pG).readahead;
+    zoff_t bufstart, cur = (*(Uz_Globs *)pG).cur_zipfile_bufstart;
+    struct io_uring_sqe *sqe;
+    int i;
+
+#ifdef USE_MMAP_INPUT
+    if ((*(Uz_Globs *)pG).zipmap != (uch *)NULL)
+        return FALSE;           /* nothing to wait for */
+#endif
+    if (start < 0 || end <= start)
+        return TRUE;            /* not ours to judge; skip it */
+    if (q == (readahead_queue *)NULL &&
+        (q = (readahead_queue *)readahead_init(pG)) == (readahead_queue *)NULL)
+        return FALSE;
+    bufstart = start - start % INBUFSIZ;
+    end += INBUFSIZ - 1;
+    end -= end % INBUFSIZ;
+    if (bufstart >= cur && end <= cur + (zoff_t)(*(Uz_Globs *)pG).inbuf_len)
+        return TRUE;            /* in the current block already */
+
+    if (q->ringfd < 0) {
+        if (bufstart > cur + (zoff_t)READAHEAD_SLOTS * q->blksiz)
+            return FALSE;       /* far enough ahead for now */
+        if (end > q->advised) {
+            if (bufstart < q->advised && bufstart >= cur)
+                bufstart = q->advised;
+            posix_fadvise(fileno((*(Uz_Globs *)pG).zipfd), (off_t)bufstart,
+                          (off_t)(end - bufstart), POSIX_FADV_WILLNEED);
+            q->advised = end;
+        }
+        return TRUE;
+    }
+
+    readahead_reap(q, -1);
+    if ((i = q->last) >= 0 && q->state[i] != RA_FREE &&
+        bufstart >= q->start[i] && bufstart <= RA_END(q, i))
+    {
+        if (end <= RA_END(q, i))
+            return TRUE;        /* (members in a row, as usual) */
+        if (q->state[i] == RA_QUEUED &&
+            end - q->start[i] <= (zoff_t)q->blksiz)
+        {
+            /* not gone out yet:  make it one larger read */
+            q->iov[i].iov_len = (size_t)(end - q->start[i]);
+            return TRUE;
+        }
+        bufstart = RA_END(q, i);
+    }
+    if (end - bufstart > (zoff_t)q->blksiz)
+        end = bufstart + q->blksiz;     /* the rest streams */
+
+    for (i = 0;  i < READAHEAD_SLOTS && q->state[i] != RA_FREE;  ++i)
+        ;
+    if (i == READAHEAD_SLOTS)
+        return FALSE;
+    q->state[i] = RA_QUEUED;
+    q->start[i] = bufstart;
+    q->iov[i].iov_len = (size_t)(end - bufstart);
+    q->order[i] = ++q->seq;
+    q->last = i;
+
+    sqe = &q->sqes[q->tail & *q->sq_mask];
+    memzero(sqe, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = fileno((*(Uz_Globs *)pG).zipfd);
+    sqe->addr = (unsigned long)&q->iov[i];
+    sqe->len = 1;
+    sqe->off = (unsigned long long)bufstart;
+    sqe->user_data = (unsigned long long)i;
+    q->sq_array[q->tail & *q->sq_mask] = q->tail & *q->sq_mask;
+    ++q->tail;
+    ++q->pending;
+    return TRUE;
+
+} /* end function queue_readahead() */
+
+
+
+
+
+/*******************************/
+/* Function submit_readahead() */
+/*******************************/
+
+void 
+submit_readahead (Uz_Globs *pG)
+{
+    readahead_queue *q = (readahead_queue *)(*(Uz_Globs *)pG).readahead;
+    unsigned first;
+    int i, n;
+
+    if (q == (readahead_queue *)NULL || q->pending == 0)
+        return;
+    first = q->tail - q->pending;
+    __atomic_store_n(q->sq_tail, q->tail, __ATOMIC_RELEASE);
+    while (q->pending > 0) {
+        n = (int)syscall(__NR_io_uring_enter, q->ringfd, q->pending, 0, 0,
+                         NULL, 0);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR)
+                continue;
+            break;
+        }
+        for (;  n > 0;  --n, ++first, --q->pending, ++q->busy) {
+            i = (int)q->sqes[first & *q->sq_mask].user_data;
+            q->state[i] = RA_BUSY;
+        }
+    }
+    if (q->pending > 0) {       /* not taken:  take the sqes back again */
+        for (;  first != q->tail;  ++first)
+            q->state[(int)q->sqes[first & *q->sq_mask].user_data] = RA_FREE;
+        q->tail -= q->pending;
+        q->pending = 0;
+        __atomic_store_n(q->sq_tail, q->tail, __ATOMIC_RELEASE);
+    }
+
+} /* end function submit_readahead() */
+
+
+
+
+
+/*****************************/
+/* Function readahead_take() */
+/*****************************/
+
+static int 
+readahead_take (   /* return byte count, 0 if block is not read ahead */
+    Uz_Globs *pG,
+    zoff_t bufstart,
+    unsigned *plen          /* set to the length of the block if found */
+)
+{
+/*
+ *  If a queued read covers bufstart, wait for it and copy its data from
+ *  there on into inbuf.  That read and all queued before it are done with
+ *  afterwards.
+ */
+    readahead_queue *q = (readahead_queue *)(*(Uz_Globs *)pG).readahead;
+    unsigned delta, len;
+    int i, j, n = 0;
+
+    if (q == (readahead_queue *)NULL || q->ringfd < 0)
+        return 0;
+    readahead_reap(q, -1);
+    for (i = 0;  i < READAHEAD_SLOTS;  ++i)
+        if ((q->state[i] == RA_QUEUED || q->state[i] == RA_BUSY ||
+             q->state[i] == RA_DONE) &&
+            q->start[i] <= bufstart && bufstart < RA_END(q, i))
+            break;
+    if (i == READAHEAD_SLOTS)
+        return 0;
+    if (q->state[i] == RA_QUEUED)
+        submit_readahead(pG);
+    if (q->state[i] == RA_BUSY)
+        readahead_reap(q, i);
+    if (q->state[i] == RA_DONE) {
+        delta = (unsigned)(bufstart - q->start[i]);
+        n = q->count[i] - (int)delta;
+        len = (unsigned)q->iov[i].iov_len - delta;
+        if (q->count[i] < (int)q->iov[i].iov_len && n > 0 &&
+            q->start[i] + q->count[i] < (*(Uz_Globs *)pG).ziplen) {
+            /* short read before EOF:  keep whole blocks, next_inbuf() reads
+             * the rest (at EOF, the tail block is all there is) */
+            n -= n % INBUFSIZ;
+            len = (unsigned)n;
+        }
+        if (n > 0) {
+            memcpy((*(Uz_Globs *)pG).inbuf, (uch *)q->iov[i].iov_base + delta,
+                   (unsigned)n);
+            *plen = len;
+        }
+    }
+    for (j = 0;  j < READAHEAD_SLOTS;  ++j)
+        if (q->state[j] != RA_FREE && q->state[j] != RA_QUEUED &&
+            q->order[j] <= q->order[i])
+            q->state[j] = (q->state[j] == RA_BUSY)? RA_DROPPED : RA_FREE;
+    if (q->last >= 0 && q->state[q->last] == RA_FREE)
+        q->last = -1;
+    return (n > 0)? n : 0;
+
+} /* end function readahead_take() */
+
+
+
+
+
+/*****************************/
+/* Function drop_readahead() */
+/*****************************/
+
+void 
+drop_readahead (Uz_Globs *pG)
+{
+    readahead_queue *q = (readahead_queue *)(*(Uz_Globs *)pG).readahead;
+    int i;
+
+    if (q == (readahead_queue *)NULL)
+        return;
+    q->advised = 0;
+    q->last = -1;
+    if (q->ringfd < 0)
+        return;
+    q->tail -= q->pending;      /* never submitted */
+    q->pending = 0;
+    for (i = 0;  i < READAHEAD_SLOTS;  ++i)
+        q->state[i] = (q->state[i] == RA_BUSY || q->state[i] == RA_DROPPED)?
+                      RA_DROPPED : RA_FREE;
+
+} /* end function drop_readahead() */
+
+
+
+
+
+/*****************************/
+/* Function free_readahead() */
+/*****************************/
+
+void 
+free_readahead (Uz_Globs *pG)
+{
+    readahead_queue *q = (readahead_queue *)(*(Uz_Globs *)pG).readahead;
+    int i;
+
+    if (q == (readahead_queue *)NULL)
+        return;
+    drop_readahead(pG);
+    if (q->ringfd >= 0) {
+        readahead_reap(q, READAHEAD_SLOTS);   /* the kernel owns buffers */
+        munmap((void *)q->sqes, q->sqes_sz);
+        if (q->cq_ring != q->sq_ring)
+            munmap(q->cq_ring, q->cq_ring_sz);
+        munmap(q->sq_ring, q->sq_ring_sz);
+        (close)(q->ringfd);
+        for (i = 0;  i < READAHEAD_SLOTS;  ++i)
+            free(q->iov[i].iov_base);
+    }
+    free(q);
+    (*(Uz_Globs *)pG).readahead = (void *)NULL;
+
+} /* end function free_readahead() */
+
+#endif /* USE_IO_URING */
+
+
+
+
+
+/************************/
+/* Function seek_zipf() */
+/************************/
+
+int 
+seek_zipf (Uz_Globs *pG, zoff_t abs_offset)
+{
+/*
+ *  Seek to the block boundary of the block which includes abs_offset,
+ *  then read block into input buffer and set pointers appropriately.
+ *  If abs_offset is already in the buffer, just set the pointers.  This function
+ *  is used by do_seekable (process.c), extract_or_test_entrylist (extract.c)
+ *  and do_string (fileio.c).  Also, a slightly modified version is embedded
+ *  within extract_or_test_entrylist (extract.c).  readbyte() and readbuf()
+ *  (fileio.c) are compatible.  NOTE THAT abs_offset is intended to be the
+ *  "proper offset" (i.e., if there were no extra bytes prepended);
+ *  cur_zipfile_bufstart contains the corrected offset.
+ *
+ *  Since seek_zipf() is never used during decompression, it is safe to
+ *  use the slide[] buffer for the error message.
+ *
+ * returns PK error codes:
+ *  PK_BADERR if effective offset in zipfile is negative
+ *  PK_EOF if seeking past end of zipfile
+ *  PK_OK when seek was successful
+ */
+    zoff_t request = abs_offset + (*(Uz_Globs *)pG).extra_bytes;
+    zoff_t inbuf_offset = request % INBUFSIZ;
+    zoff_t bufstart = request - inbuf_offset;
+
+    if (request < 0) {
+        Info(slide, 1, ((char *)slide, LoadFarStringSmall(SeekMsg),
+             (*(Uz_Globs *)pG).zipfn, LoadFarString(ReportMsg)));
+        return(PK_BADERR);
+    } else if (request < (*(Uz_Globs *)pG).cur_zipfile_bufstart ||
+               request - (*(Uz_Globs *)pG).cur_zipfile_bufstart >=
+               (zoff_t)(*(Uz_Globs *)pG).inbuf_len) {
+        Trace((stderr,
+          "fpos_zip: abs_offset = %s, (*(Uz_Globs *)pG).extra_bytes = %s\n",
+          FmZofft(abs_offset, NULL, NULL),
+          FmZofft((*(Uz_Globs *)pG).extra_bytes, NULL, NULL)));
+        fill_inbuf_at(pG, bufstart, (*(Uz_Globs *)pG).inbufsiz);
+        Trace((stderr,
+          "       request = %s, (abs+extra) = %s, inbuf_offset = %s\n",
+          FmZofft(request, NULL, NULL),
+          FmZofft((abs_offset+(*(Uz_Globs *)pG).extra_bytes), NULL, NULL),
+          FmZofft(inbuf_offset, NULL, NULL)));
+        Trace((stderr, "       bufstart = %s, cur_zipfile_bufstart = %s\n",
+          FmZofft(bufstart, NULL, NULL),
+          FmZofft((*(Uz_Globs *)pG).cur_zipfile_bufstart, NULL, NULL)));
+        if ((*(Uz_Globs *)pG).incnt <= 0)
+            return(PK_EOF);
+        (*(Uz_Globs *)pG).incnt -= (int)inbuf_offset;
+        (*(Uz_Globs *)pG).inptr = (*(Uz_Globs *)pG).inbuf + (int)inbuf_offset;
+    } else {
+        /* target lies within the block that is already in inbuf[] */
+        inbuf_offset = request - (*(Uz_Globs *)pG).cur_zipfile_bufstart;
+        (*(Uz_Globs *)pG).incnt += ((*(Uz_Globs *)pG).inptr-(*(Uz_Globs *)pG).inbuf) - (int)inbuf_offset;
+        (*(Uz_Globs *)pG).inptr = (*(Uz_Globs *)pG).inbuf + (int)inbuf_offset;
+    }
+    return(PK_OK);
+} /* end function seek_zipf() */
+
+
+
+
+
+#ifndef VMS  /* for VMS use code in vms.c */
+
+/********************/
+/* Function flush() */   /* returns PK error codes: */
+/********************/   /* if tflag => always 0; PK_DISK if write error */
+
+int flush(pG, rawbuf, size, unshrink)
+    Uz_Globs *pG;
+    uch *rawbuf;
+    ulg size;
+    int unshrink;
+{
+    uch *p;
+    uch *q;
+    uch *transbuf;
+    /* static int didCRlast = FALSE;    moved to globals.h */
+
+
+/*---------------------------------------------------------------------------
+    Compute the CRC first; if testing or if disk is full, that's it.
+  ---------------------------------------------------------------------------*/
+
+#ifdef USE_MMAP_OUTPUT
+    if ((*(Uz_Globs *)pG).redirect_slide)      /* see map_outfile() */
+        return flush_outmap(pG, rawbuf, size);
+#endif
+    if ((*(Uz_Globs *)pG).crc_elsewhere)  /* a large STORED member (-w) */
+        (*(Uz_Globs *)pG).crc_passed += (zoff_t)size;
+    else
+        (*(Uz_Globs *)pG).crc32val = crc32((*(Uz_Globs *)pG).crc32val, rawbuf, (extent)size);
+
+    if (uO.r_flag) {            /* -r:  only what is in the byte range */
+        ulg at = (ulg)(*(Uz_Globs *)pG).range_at, skip;
+
+        (*(Uz_Globs *)pG).range_at += (zoff_t)size;
+        if (size == 0 || at > uO.r_last || at + size <= uO.r_first)
+            return PK_OK;
+        if (at < uO.r_first) {
+            skip = uO.r_first - at;
+            rawbuf += skip, size -= skip, at = uO.r_first;
+        }
+        if (size - 1 > uO.r_last - at)
+            size = uO.r_last - at + 1;
+    }
+
+#ifdef DLL
+    if (((*(Uz_Globs *)pG).statreportcb != NULL) &&
+        (*(*(Uz_Globs *)pG).statreportcb)(pG, UZ_ST_IN_PROGRESS, (*(Uz_Globs *)pG).zipfn, (*(Uz_Globs *)pG).filename, NULL))
+        return IZ_CTRLC;        /* cancel operation by user request */
+#endif
+
+    if (uO.tflag || size == 0L)  /* testing or nothing to write:  all done */
+        return PK_OK;
+
+    if ((*(Uz_Globs *)pG).disk_full)
+        return PK_DISK;         /* disk already full:  ignore rest of file */
+
+/*---------------------------------------------------------------------------
+    Write the bytes rawbuf[0..size-1] to the output device, first converting
+    end-of-lines and ASCII/EBCDIC as needed.  If SMALL_MEM or MED_MEM are NOT
+    defined, outbuf is assumed to be at least as large as rawbuf and is not
+    necessarily checked for overflow.
+  ---------------------------------------------------------------------------*/
+
+    if (!(*(Uz_Globs *)pG).pInfo->textmode) {   /* write raw binary data */
+        /* GRR:  note that for standard MS-DOS compilers, size argument to
+         * fwrite() can never be more than 65534, so WriteError macro will
+         * have to be rewritten if size can ever be that large.  For now,
+         * never more than 32K.  Also note that write() returns an int, which
+         * doesn't necessarily limit size to 32767 bytes if write() is used
+         * on 16-bit systems but does make it more of a pain; however, because
+         * at least MSC 5.1 has a lousy implementation of fwrite() (as does
+         * DEC Ultrix cc), write() is used anyway.
+         */
+#ifdef DLL
+        if ((*(Uz_Globs *)pG).redirect_data) {
+#ifdef NO_SLIDE_REDIR
+            if (writeToMemory(pG, rawbuf, (extent)size)) return PK_ERR;
+#else
+            writeToMemory(pG, rawbuf, (extent)size);
+#endif
+        } else
+#endif
+#ifdef USE_SPARSE
+        if ((*(Uz_Globs *)pG).sparse_blk) {
+            if (write_sparse(pG, rawbuf, size))
+                return disk_error(pG);
+        } else
+#endif
+#ifdef USE_WRITEV
+        if (!uO.cflag) {
+            if (write_outbuf(pG, rawbuf, size))
+                return disk_error(pG);
+        } else
+#endif
+        if (!uO.cflag && WriteError(rawbuf, size, (*(Uz_Globs *)pG).outfile))
+            return disk_error(pG);
+        else if (uO.cflag && (*(*(Uz_Globs *)pG).message)((void *)&(*(Uz_Globs *)pG), rawbuf, size, 0))
+            return PK_OK;
+    } else {   /* textmode:  aflag is true */
+        if (unshrink) {
+            /* rawbuf = outbuf */
+            transbuf = (*(Uz_Globs *)pG).outbuf2;
+        } else {
+            /* rawbuf = slide */
+            transbuf = (*(Uz_Globs *)pG).outbuf;
+        }
+        if ((*(Uz_Globs *)pG).newfile) {
+            (*(Uz_Globs *)pG).didCRlast = FALSE;         /* no previous buffers written */
+            (*(Uz_Globs *)pG).newfile = FALSE;
+        }
+
+
+    /*-----------------------------------------------------------------------
         Algorithm:  CR/LF => native; lone CR => native; lone LF => native.
         This routine is only for non-raw-VMS, non-raw-VM/CMS files (i.e.,
         stream-oriented files, not record-oriented).
@@ -806,55 +2167,988 @@ int flush(pG, rawbuf, size, unshrink)
 #ifndef DOS_FLX_OS2_W32
                 if (*p != CTRLZ)          /* lose all ^Z's */
 #endif
-                    *q++ = native(*p);
+                    *q++ = native(*p);
+
+#if (defined(SMALL_MEM) || defined(MED_MEM))
+# if (lenEOL == 1)   /* don't check unshrink:  both buffers small but equal */
+                if (!unshrink)
+# endif
+                    /* check for danger of buffer overflow and flush */
+                    if (q > transbuf+(extent)transbufsiz-lenEOL) {
+                        Trace((stderr,
+                          "p - rawbuf = %u   q-transbuf = %u   size = %lu\n",
+                          (unsigned)(p-rawbuf), (unsigned)(q-transbuf), size));
+                        if (!uO.cflag && WriteError(transbuf,
+                            (extent)(q-transbuf), (*(Uz_Globs *)pG).outfile))
+                            return disk_error(pG);
+                        else if (uO.cflag && (*(*(Uz_Globs *)pG).message)((void *)&(*(Uz_Globs *)pG),
+                                 transbuf, (ulg)(q-transbuf), 0))
+                            return PK_OK;
+                        q = transbuf;
+                        continue;
+                    }
+#endif /* SMALL_MEM || MED_MEM */
+            }
+        }
+
+    /*-----------------------------------------------------------------------
+        Done translating:  write whatever we've got to file (or screen).
+      -----------------------------------------------------------------------*/
+
+        Trace((stderr, "p - rawbuf = %u   q-transbuf = %u   size = %lu\n",
+          (unsigned)(p-rawbuf), (unsigned)(q-transbuf), size));
+        if (q > transbuf) {
+#ifdef DLL
+            if ((*(Uz_Globs *)pG).redirect_data) {
+                if (writeToMemory(pG, transbuf, (extent)(q-transbuf)))
+                    return PK_ERR;
+            } else
+#endif
+            if (!uO.cflag && WriteError(transbuf, (extent)(q-transbuf),
+                (*(Uz_Globs *)pG).outfile))
+                return disk_error(pG);
+            else if (uO.cflag && (*(*(Uz_Globs *)pG).message)((void *)&(*(Uz_Globs *)pG), transbuf,
+                (ulg)(q-transbuf), 0))
+                return PK_OK;
+        }
+    }
+
+    return PK_OK;
+
+} /* end function flush() [resp. partflush() for 16-bit Deflate64 support] */
+
+
+
+
+
+#ifdef USE_COPY_RANGE
+
+/**************************/
+/* Function kernel_copy() */
+/**************************/
+
+static zoff_t kernel_copy(infd, outfd, offset, len, err)
+    int infd, outfd;
+    zoff_t offset;      /* zipfile offset of the data */
+    zoff_t len;
+    int *err;           /* errno when stopped short, else 0 */
+{
+    long long cfr_pos = (long long)offset;     /* (loff_t) */
+    off_t sf_pos = (off_t)offset;
+    zoff_t done = 0;
+    ssize_t n = 0;
+
+/*---------------------------------------------------------------------------
+    Append up to len bytes of the zipfile at offset to outfd, by
+    copy_file_range(), which lets filesystems that can do so share the
+    blocks or copy them on the server, else by sendfile().  Returns the
+    number of bytes done.
+  ---------------------------------------------------------------------------*/
+
+    *err = 0;
+#ifdef __NR_copy_file_range
+    while (done < len) {
+        n = syscall(__NR_copy_file_range, infd, &cfr_pos, outfd, (void *)NULL,
+                    (size_t)MIN(len - done, (zoff_t)0x40000000L), 0U);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        done += n;
+    }
+#endif
+    if (done == 0) {    /* (ENOSYS, EXDEV, ...) */
+        while (done < len) {
+            n = sendfile(outfd, infd, &sf_pos,
+                         (size_t)MIN(len - done, (zoff_t)0x40000000L));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            done += n;
+        }
+    }
+    if (done < len && n < 0)
+        *err = errno;
+    return done;
+
+} /* end function kernel_copy() */
+
+
+
+
+
+/***************************/
+/* Function copy_zipdata() */  /* returns PK_OK, PK_DISK if write error, */
+/***************************/  /* or -1 if not done at all */
+
+int copy_zipdata(pG, offset, len, buf, bufsize)
+    Uz_Globs *pG;
+    zoff_t offset;      /* zipfile offset of the data */
+    zoff_t len;
+    uch *buf;           /* for when the kernel gives up halfway */
+    unsigned bufsize;
+{
+    int infd = fileno((*(Uz_Globs *)pG).zipfd);
+    int outfd = fileno((*(Uz_Globs *)pG).outfile);
+    zoff_t done = 0;
+    ssize_t n;
+    int got, err;
+#ifdef FICLONERANGE
+    struct file_clone_range fcr;
+    z_stat st;
+    zoff_t outpos, head, mid;
+#endif
+
+/*---------------------------------------------------------------------------
+    Append len bytes of the zipfile to outfile without them passing through
+    our buffers (see kernel_copy()).  Neither moves the file position of
+    zipfd, and the CRC is none of our business here.  Binary output only,
+    to a real file; outfile must have been fflush()ed.
+
+    Where the data lie at the same offset within a filesystem block as
+    they are to go in outfile (a member aligned by the archiver, written
+    from its start), the whole blocks in between are cloned by
+    FICLONERANGE instead, on filesystems that share extents (btrfs, XFS
+    with reflink, ...):  only the head and tail are really copied.  Any
+    failure of the clone leaves it all to kernel_copy().
+  ---------------------------------------------------------------------------*/
+
+#ifdef FICLONERANGE
+    if (fstat(outfd, &st) == 0 && st.st_blksize > 0 &&
+        (outpos = (zoff_t)lseek(outfd, (off_t)0, SEEK_CUR)) >= 0 &&
+        offset % st.st_blksize == outpos % st.st_blksize)
+    {
+        head = (st.st_blksize - offset % st.st_blksize) % st.st_blksize;
+        mid = (len > head ? (len - head) / st.st_blksize * st.st_blksize : 0);
+        if (mid > 0 && (head == 0 ||
+            (done = kernel_copy(infd, outfd, offset, head, &err)) == head))
+        {
+            fcr.src_fd = infd;
+            fcr.src_offset = (unsigned long long)(offset + head);
+            fcr.src_length = (unsigned long long)mid;
+            fcr.dest_offset = (unsigned long long)(outpos + head);
+            if (ioctl(outfd, FICLONERANGE, &fcr) == 0 &&
+                lseek(outfd, (off_t)(outpos + head + mid), SEEK_SET) >= 0)
+                done += mid;
+        }
+    }
+#endif
+    done += kernel_copy(infd, outfd, offset + done, len - done, &err);
+    if (done == 0 && err != 0 && err != ENOSPC && err != EDQUOT &&
+        err != EIO)
+        return -1;      /* not between these two:  do it the usual way */
+    if (done < len && (err == ENOSPC || err == EDQUOT || err == EIO)) {
+        errno = err;
+        return disk_error(pG);
+    }
+
+    /* the kernel stopped short:  the rest (if any) through buf */
+    while (done < len) {
+        got = zipf_pread(pG, buf, (unsigned)MIN(len - done, (zoff_t)bufsize),
+                         offset + done);
+        if (got <= 0)
+            return PK_OK;       /* short zipfile:  the CRC check tells */
+        if ((n = write(outfd, (char *)buf, (size_t)got)) != (ssize_t)got) {
+            if (n >= 0)
+                errno = ENOSPC;
+            return disk_error(pG);
+        }
+        done += got;
+    }
+    return PK_OK;
+
+} /* end function copy_zipdata() */
+
+#endif /* USE_COPY_RANGE */
+
+
+
+
+
+#ifdef USE_PREALLOC
+
+/*******************************/
+/* Function prealloc_outfile() */
+/*******************************/
+
+void prealloc_outfile(pG)
+    Uz_Globs *pG;
+{
+    char *p;
+    int outfd;
+    z_stat st;
+
+/*---------------------------------------------------------------------------
+    Right after open_outfile():  reserve the blocks for all of a large
+    member's output (its size in the headers), so that the file is not
+    grown a stdio buffer at a time, in as many extents when many files are
+    written at once.  FALLOC_FL_KEEP_SIZE leaves the size at 0, so it is
+    still a new, empty file to map_outfile() and par_inflate(), and only
+    what is written counts; trim_outfile() gives back whatever is left over
+    past its end.  Not done with text conversion, which changes the length.
+    UNZIP_PREALLOC=no in the environment turns it off.
+  ---------------------------------------------------------------------------*/
+
+    (*(Uz_Globs *)pG).prealloc_len = 0;
+    if (uO.tflag || uO.cflag || (*(Uz_Globs *)pG).mem_mode ||
+#ifdef USE_SPARSE
+        (*(Uz_Globs *)pG).sparse_blk ||
+#endif
+        (*(Uz_Globs *)pG).pInfo->textmode ||
+        (*(Uz_Globs *)pG).lrec.ucsize < PREALLOC_MIN ||
+        ((p = getenv("UNZIP_PREALLOC")) != NULL && strcmp(p, "no") == 0))
+        return;
+    outfd = fileno((*(Uz_Globs *)pG).outfile);
+    if (fstat(outfd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size != 0)
+        return;
+    if (syscall(__NR_fallocate, outfd, FALLOC_FL_KEEP_SIZE, (off_t)0,
+                (off_t)(*(Uz_Globs *)pG).lrec.ucsize) == 0)
+        (*(Uz_Globs *)pG).prealloc_len = (zoff_t)(*(Uz_Globs *)pG).lrec.ucsize;
+
+} /* end function prealloc_outfile() */
+
+
+
+
+
+/***************************/
+/* Function trim_outfile() */
+/***************************/
+
+void trim_outfile(pG)
+    Uz_Globs *pG;
+{
+    int outfd;
+    z_stat st;
+
+    /* before close_outfile():  should the data have come out short of the
+     * size reserved (an error, or a wrong size in the headers), cut the
+     * file at its end, which frees the blocks past it */
+    if ((*(Uz_Globs *)pG).prealloc_len == 0)
+        return;
+    outfd = fileno((*(Uz_Globs *)pG).outfile);
+    if (fflush((*(Uz_Globs *)pG).outfile) == 0 && fstat(outfd, &st) == 0 &&
+        st.st_size < (*(Uz_Globs *)pG).prealloc_len)
+        ftruncate(outfd, st.st_size);
+    (*(Uz_Globs *)pG).prealloc_len = 0;
+
+} /* end function trim_outfile() */
+
+#endif /* USE_PREALLOC */
+
+
+
+
+
+#ifdef USE_SPARSE
+
+/*****************************/
+/* Function sparse_outfile() */
+/*****************************/
+
+void sparse_outfile(pG)
+    Uz_Globs *pG;
+{
+    z_stat st;
+
+/*---------------------------------------------------------------------------
+    Right after open_outfile(), for -S:  if the member goes unconverted
+    into a new, empty regular file, have flush() leave out its all-zero
+    blocks (see write_sparse()).  The blocks are those of the file system
+    (st_blksize), as a hole cannot be any smaller.  Mapping or preallocating
+    the file, or having the kernel copy into it, would allocate the blocks
+    after all, so these stand aside when sparse_blk is set.
+  ---------------------------------------------------------------------------*/
+
+    (*(Uz_Globs *)pG).sparse_blk = 0;
+    (*(Uz_Globs *)pG).sparse_at = 0;
+    if (!uO.S_flag || uO.tflag || uO.cflag || (*(Uz_Globs *)pG).mem_mode ||
+        (*(Uz_Globs *)pG).pInfo->textmode)
+        return;
+#ifdef DLL
+    if ((*(Uz_Globs *)pG).redirect_data)
+        return;
+#endif
+    if (fstat(fileno((*(Uz_Globs *)pG).outfile), &st) != 0 ||
+        !S_ISREG(st.st_mode) || st.st_size != 0)
+        return;
+    if (st.st_blksize >= 512 && st.st_blksize <= 1L << 20 &&
+        (st.st_blksize & (st.st_blksize - 1)) == 0)
+        (*(Uz_Globs *)pG).sparse_blk = (unsigned)st.st_blksize;
+    else
+        (*(Uz_Globs *)pG).sparse_blk = SPARSE_BLOCK;
+
+} /* end function sparse_outfile() */
+
+
+
+
+
+/*************************/
+/* Function zero_block() */  /* returns 1 if the n bytes at p are all 0 */
+/*************************/
+
+static int zero_block(p, n)
+    const uch *p;
+    unsigned n;
+{
+    /* 64 bytes at a time, ORed together so that one test covers them:
+     * in four SSE2 registers where there are such, else in 64-bit words
+     * (memcpy() because p need not be aligned) */
+#ifdef __SSE2__
+    __m128i v;
+
+    for (; n >= 64; p += 64, n -= 64) {
+        v = _mm_or_si128(
+              _mm_or_si128(_mm_loadu_si128((const __m128i *)p),
+                           _mm_loadu_si128((const __m128i *)(p + 16))),
+              _mm_or_si128(_mm_loadu_si128((const __m128i *)(p + 32)),
+                           _mm_loadu_si128((const __m128i *)(p + 48))));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) !=
+            0xffff)
+            return 0;
+    }
+#else
+    z_uint8 w[8];
+
+    for (; n >= 64; p += 64, n -= 64) {
+        memcpy(w, p, 64);
+        if ((w[0] | w[1] | w[2] | w[3] | w[4] | w[5] | w[6] | w[7]) != 0)
+            return 0;
+    }
+#endif
+    while (n--)
+        if (*p++ != 0)
+            return 0;
+    return 1;
 
-#if (defined(SMALL_MEM) || defined(MED_MEM))
-# if (lenEOL == 1)   /* don't check unshrink:  both buffers small but equal */
-                if (!unshrink)
-# endif
-                    /* check for danger of buffer overflow and flush */
-                    if (q > transbuf+(extent)transbufsiz-lenEOL) {
-                        Trace((stderr,
-                          "p - rawbuf = %u   q-transbuf = %u   size = %lu\n",
-                          (unsigned)(p-rawbuf), (unsigned)(q-transbuf), size));
-                        if (!uO.cflag && WriteError(transbuf,
-                            (extent)(q-transbuf), (*(Uz_Globs *)pG).outfile))
-                            return disk_error(pG);
-                        else if (uO.cflag && (*(*(Uz_Globs *)pG).message)((void *)&(*(Uz_Globs *)pG),
-                                 transbuf, (ulg)(q-transbuf), 0))
-                            return PK_OK;
-                        q = transbuf;
-                        continue;
-                    }
-#endif /* SMALL_MEM || MED_MEM */
-            }
+} /* end function zero_block() */
+
+
+
+
+
+/***************************/
+/* Function write_sparse() */  /* returns 1 if a write or seek failed */
+/***************************/
+
+static int write_sparse(pG, buf, size)
+    Uz_Globs *pG;
+    uch *buf;
+    ulg size;
+{
+    unsigned blk = (*(Uz_Globs *)pG).sparse_blk;
+    ulg i, k = 0, start;
+    int hole = FALSE, zero;
+    int outfd = fileno((*(Uz_Globs *)pG).outfile);
+
+/*---------------------------------------------------------------------------
+    flush()'s binary output with -S:  split the window at the file's block
+    boundaries, and seek over the whole blocks that are all zeros rather
+    than writing them, which leaves holes in the file.  Runs of blocks of
+    either kind take one lseek() or write() each.  A partial block at either
+    end of the window is always written.  Should the file end in a hole,
+    finish_sparse() gives it its size.
+  ---------------------------------------------------------------------------*/
+
+    for (start = i = 0; ; i += k) {
+        if (i < size) {
+            k = blk - (unsigned)(((*(Uz_Globs *)pG).sparse_at + i) % blk);
+            if (k > size - i)
+                k = size - i;
+            zero = (k == blk && zero_block(buf + i, (unsigned)k));
+            if (zero == hole)
+                continue;
         }
+        if (i > start) {        /* out with the run before block i */
+            if (hole) {
+                if (lseek(outfd, (off_t)(i - start), SEEK_CUR) == (off_t)-1)
+                    return 1;
+            } else if (WriteError(buf + start, i - start,
+                                  (*(Uz_Globs *)pG).outfile))
+                return 1;
+        }
+        if (i >= size)
+            break;
+        start = i;
+        hole = zero;
+    }
+    (*(Uz_Globs *)pG).sparse_at += (zoff_t)size;
+    return 0;
 
-    /*-----------------------------------------------------------------------
-        Done translating:  write whatever we've got to file (or screen).
-      -----------------------------------------------------------------------*/
+} /* end function write_sparse() */
 
-        Trace((stderr, "p - rawbuf = %u   q-transbuf = %u   size = %lu\n",
-          (unsigned)(p-rawbuf), (unsigned)(q-transbuf), size));
-        if (q > transbuf) {
-#ifdef DLL
-            if ((*(Uz_Globs *)pG).redirect_data) {
-                if (writeToMemory(pG, transbuf, (extent)(q-transbuf)))
-                    return PK_ERR;
-            } else
+
+
+
+
+/****************************/
+/* Function finish_sparse() */  /* returns PK_OK, or PK_DISK if the size */
+/****************************/  /* could not be set */
+
+int finish_sparse(pG)
+    Uz_Globs *pG;
+{
+    int r = PK_OK;
+
+    /* before close_outfile():  the size of the file is only as far as its
+     * last write(), short of the data if they end in a hole */
+    if ((*(Uz_Globs *)pG).sparse_blk == 0)
+        return PK_OK;
+    if (ftruncate(fileno((*(Uz_Globs *)pG).outfile),
+                  (off_t)(*(Uz_Globs *)pG).sparse_at) != 0)
+        r = PK_DISK;
+    (*(Uz_Globs *)pG).sparse_blk = 0;
+    return r;
+
+} /* end function finish_sparse() */
+
+#endif /* USE_SPARSE */
+
+
+
+
+
+
+#ifdef USE_WRITEV
+
+/*************************/
+/* Function writev_all() */  /* returns 1 if a write failed */
+/*************************/
+
+static int writev_all(fd, iov, cnt)
+    int fd;
+    struct iovec *iov;
+    int cnt;
+{
+    ssize_t n;
+
+    /* all of it, going on after a partial write (a signal, or a large
+     * write split by the kernel) from where it stopped */
+    while (cnt > 0) {
+        if ((n = writev(fd, iov, cnt)) <= 0) {
+            if (n < 0 && errno == EINTR)
+                continue;
+            return 1;
+        }
+        for (;  cnt > 0 && (size_t)n >= iov->iov_len;  ++iov, --cnt)
+            n -= (ssize_t)iov->iov_len;
+        if (cnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+    return 0;
+
+} /* end function writev_all() */
+
+
+
+
+
+#ifdef USE_ASYNC_WRITE
+
+/*
+ *  Writer ring.  Once a member has filled wbuf, a background thread does
+ *  the writing, so that a slow disk does not hold up the decompression:
+ *  write_outbuf() fills buffer number fill (that is wbuf) and queue_outbuf()
+ *  hands it over when it is full, going on in the next one of WRITE_BUFS.
+ *  The count buffers before fill are queued, the oldest being written; the
+ *  thread writes them in that order, to the file each was filled for.  A
+ *  failed write sets err, and the rest of what is queued is dropped; flush()
+ *  hears of it at its next hand-over, drain_outfile() in any case, which
+ *  waits for the queue to be empty at the end of each member.
+ */
+typedef struct write_ring {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;        /* for the thread:  a buffer queued, or quit */
+    pthread_cond_t done;        /* for the decoder:  a buffer written */
+    int quit;
+    int err;                    /* a write failed (the current member's) */
+    int fill;                   /* buffer being filled (wbuf) */
+    int count;                  /* buffers queued before it */
+    int fd[WRITE_BUFS];
+    unsigned len[WRITE_BUFS];
+    uch *buf[WRITE_BUFS];
+} write_ring;
+
+
+
+/****************************/
+/* Function writer_thread() */
+/****************************/
+
+static void *writer_thread(arg)
+    void *arg;
+{
+    write_ring *wr = (write_ring *)arg;
+    struct iovec iov;
+    int i, fd, bad;
+
+    pthread_mutex_lock(&wr->lock);
+    for (;;) {
+        if (wr->count == 0) {
+            if (wr->quit)
+                break;
+            pthread_cond_wait(&wr->wake, &wr->lock);
+            continue;
+        }
+        i = (wr->fill + WRITE_BUFS - wr->count) % WRITE_BUFS;
+        bad = wr->err;          /* (then only dropped) */
+        fd = wr->fd[i];
+        iov.iov_base = (void *)wr->buf[i];
+        iov.iov_len = (size_t)wr->len[i];
+        pthread_mutex_unlock(&wr->lock);
+
+        if (!bad)
+            bad = writev_all(fd, &iov, 1);
+
+        pthread_mutex_lock(&wr->lock);
+        if (bad)
+            wr->err = TRUE;
+        --wr->count;
+        pthread_cond_broadcast(&wr->done);
+    }
+    pthread_mutex_unlock(&wr->lock);
+    return NULL;
+
+} /* end function writer_thread() */
+
+
+
+
+
+/***************************/
+/* Function start_writer() */
+/***************************/
+
+static void start_writer(pG)
+    Uz_Globs *pG;
+{
+    write_ring *wr;
+    sigset_t all, old;
+    int i;
+
+    /* with wbuf about to be written for the first time:  the other buffers
+     * and the thread, wbuf becoming the first buffer; if any of it fails,
+     * write_sync is set, and the writing is done in this thread after all */
+    (*(Uz_Globs *)pG).write_sync = TRUE;
+    if ((wr = (write_ring *)calloc(1, sizeof(write_ring))) ==
+        (write_ring *)NULL)
+        return;
+    wr->buf[0] = (*(Uz_Globs *)pG).wbuf;
+    for (i = 1;  i < WRITE_BUFS;  ++i)
+        if ((wr->buf[i] = (uch *)malloc((*(Uz_Globs *)pG).wbuf_size)) == (uch *)NULL)
+            break;
+    pthread_mutex_init(&wr->lock, NULL);
+    pthread_cond_init(&wr->wake, NULL);
+    pthread_cond_init(&wr->done, NULL);
+    /* signals are for the main thread only; the new thread inherits
+     * the blocked mask */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    if (i < WRITE_BUFS ||
+        pthread_create(&wr->thread, NULL, writer_thread, wr) != 0)
+    {
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+        pthread_cond_destroy(&wr->done);
+        pthread_cond_destroy(&wr->wake);
+        pthread_mutex_destroy(&wr->lock);
+        for (i = 1;  i < WRITE_BUFS;  ++i)
+            if (wr->buf[i])
+                free(wr->buf[i]);
+        free(wr);
+        return;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    (*(Uz_Globs *)pG).wring = (void *)wr;
+    (*(Uz_Globs *)pG).write_sync = FALSE;
+
+} /* end function start_writer() */
+
+
+
+
+
+/***************************/
+/* Function queue_outbuf() */  /* returns 1 if a write failed */
+/***************************/
+
+static int queue_outbuf(pG)
+    Uz_Globs *pG;
+{
+    write_ring *wr = (write_ring *)(*(Uz_Globs *)pG).wring;
+    int err;
+
+    /* wbuf (unless empty) to the writer thread, which also says whether
+     * the writes so far went well; then on in the next buffer, as soon as
+     * it has been written */
+    pthread_mutex_lock(&wr->lock);
+    while (wr->count == WRITE_BUFS - 1)
+        pthread_cond_wait(&wr->done, &wr->lock);
+    if (!(err = wr->err) && (*(Uz_Globs *)pG).wbuf_len > 0) {
+        wr->fd[wr->fill] = fileno((*(Uz_Globs *)pG).outfile);
+        wr->len[wr->fill] = (*(Uz_Globs *)pG).wbuf_len;
+        wr->fill = (wr->fill + 1) % WRITE_BUFS;
+        ++wr->count;
+        pthread_cond_signal(&wr->wake);
+    }
+    pthread_mutex_unlock(&wr->lock);
+    (*(Uz_Globs *)pG).wbuf = wr->buf[wr->fill];
+    (*(Uz_Globs *)pG).wbuf_len = 0;
+    return err;
+
+} /* end function queue_outbuf() */
+
+#endif /* USE_ASYNC_WRITE */
+
+
+
+
+
+/***************************/
+/* Function write_outbuf() */  /* returns 1 if a write failed */
+/***************************/
+
+static int write_outbuf(pG, buf, size)
+    Uz_Globs *pG;
+    uch *buf;
+    ulg size;
+{
+    struct iovec iov[2];
+    char *p, *end;
+    ulg n;
+    int cnt = 0;
+
+/*---------------------------------------------------------------------------
+    flush()'s binary output to a file:  gather it in wbuf, so that the file
+    gets one large write() per WRITE_BUFSIZE bytes (UNZIP_WRITEBUF=size in
+    the environment, 1m to 8m, or 0 for none), not one per window.  Pieces
+    of a quarter of that or more, or that do not fit, are not copied but
+    go out at once, in one writev() with what wbuf holds before them.
+    drain_outfile() writes the rest before the file is closed.  With a
+    writer thread (USE_ASYNC_WRITE), everything is copied, and full buffers
+    go to the thread (see queue_outbuf()).
+  ---------------------------------------------------------------------------*/
+
+    if ((*(Uz_Globs *)pG).wbuf_size == 0) {     /* the first time here */
+        n = WRITE_BUFSIZE;
+        if ((p = getenv("UNZIP_WRITEBUF")) != NULL && isdigit((uch)*p)) {
+            n = strtoul(p, &end, 10);
+            if (*end == 'k' || *end == 'K')
+                n = (n > (WRITE_BUFMAX >> 10))? WRITE_BUFMAX : n << 10;
+            else if (*end == 'm' || *end == 'M')
+                n = (n > (WRITE_BUFMAX >> 20))? WRITE_BUFMAX : n << 20;
+            if (n != 0)
+                n = (n < WRITE_BUFMIN)? WRITE_BUFMIN : MIN(n, WRITE_BUFMAX);
+        }
+        if (n != 0)
+            (*(Uz_Globs *)pG).wbuf = (uch *)malloc((extent)n);
+        /* (1:  no buffer, everything goes out at once) */
+        (*(Uz_Globs *)pG).wbuf_size =
+          ((*(Uz_Globs *)pG).wbuf != (uch *)NULL)? (unsigned)n : 1;
+        (*(Uz_Globs *)pG).wbuf_len = 0;
+    }
+#ifdef USE_ASYNC_WRITE
+    if ((*(Uz_Globs *)pG).wring == NULL && !(*(Uz_Globs *)pG).write_sync &&
+        (*(Uz_Globs *)pG).wbuf != (uch *)NULL &&
+        size >= (*(Uz_Globs *)pG).wbuf_size - (*(Uz_Globs *)pG).wbuf_len)
+        start_writer(pG);
+    if ((*(Uz_Globs *)pG).wring != NULL) {
+        while (size > 0) {
+            n = MIN(size, (ulg)((*(Uz_Globs *)pG).wbuf_size -
+                                (*(Uz_Globs *)pG).wbuf_len));
+            memcpy((*(Uz_Globs *)pG).wbuf + (*(Uz_Globs *)pG).wbuf_len, buf,
+                   (extent)n);
+            (*(Uz_Globs *)pG).wbuf_len += (unsigned)n;
+            buf += n, size -= n;
+            if ((*(Uz_Globs *)pG).wbuf_len == (*(Uz_Globs *)pG).wbuf_size &&
+                queue_outbuf(pG))
+                return 1;
+        }
+        return 0;
+    }
 #endif
-            if (!uO.cflag && WriteError(transbuf, (extent)(q-transbuf),
-                (*(Uz_Globs *)pG).outfile))
-                return disk_error(pG);
-            else if (uO.cflag && (*(*(Uz_Globs *)pG).message)((void *)&(*(Uz_Globs *)pG), transbuf,
-                (ulg)(q-transbuf), 0))
-                return PK_OK;
+    if (size < ((*(Uz_Globs *)pG).wbuf_size >> 2) &&
+        size <= (*(Uz_Globs *)pG).wbuf_size - (*(Uz_Globs *)pG).wbuf_len)
+    {
+        memcpy((*(Uz_Globs *)pG).wbuf + (*(Uz_Globs *)pG).wbuf_len, buf,
+               (extent)size);
+        (*(Uz_Globs *)pG).wbuf_len += (unsigned)size;
+        if ((*(Uz_Globs *)pG).wbuf_len < (*(Uz_Globs *)pG).wbuf_size)
+            return 0;
+        size = 0;               /* (full:  out with it) */
+    }
+    if ((*(Uz_Globs *)pG).wbuf_len > 0) {
+        iov[cnt].iov_base = (void *)(*(Uz_Globs *)pG).wbuf;
+        iov[cnt++].iov_len = (size_t)(*(Uz_Globs *)pG).wbuf_len;
+        (*(Uz_Globs *)pG).wbuf_len = 0;
+    }
+    if (size > 0) {
+        iov[cnt].iov_base = (void *)buf;
+        iov[cnt++].iov_len = (size_t)size;
+    }
+    return writev_all(fileno((*(Uz_Globs *)pG).outfile), iov, cnt);
+
+} /* end function write_outbuf() */
+
+
+
+
+
+/****************************/
+/* Function drain_outfile() */  /* returns PK_OK, or PK_DISK if a write */
+/****************************/  /* failed */
+
+int drain_outfile(pG)
+    Uz_Globs *pG;
+{
+    struct iovec iov;
+
+    /* before anything else looks at the file (close_outfile(), the kernel
+     * copy of copy_zipdata(), ...):  what write_outbuf() has kept back;
+     * nothing more once the disk was full */
+#ifdef USE_ASYNC_WRITE
+    write_ring *wr = (write_ring *)(*(Uz_Globs *)pG).wring;
+    int err;
+
+    if (wr != (write_ring *)NULL) {     /* also waits for the writer */
+        if ((*(Uz_Globs *)pG).disk_full)
+            (*(Uz_Globs *)pG).wbuf_len = 0;
+        err = queue_outbuf(pG);
+        pthread_mutex_lock(&wr->lock);
+        while (wr->count > 0)
+            pthread_cond_wait(&wr->done, &wr->lock);
+        err |= wr->err;
+        wr->err = FALSE;
+        pthread_mutex_unlock(&wr->lock);
+        return (err && !(*(Uz_Globs *)pG).disk_full)? disk_error(pG) : PK_OK;
+    }
+#endif
+    if ((*(Uz_Globs *)pG).wbuf_len == 0)
+        return PK_OK;
+    iov.iov_base = (void *)(*(Uz_Globs *)pG).wbuf;
+    iov.iov_len = (size_t)(*(Uz_Globs *)pG).wbuf_len;
+    (*(Uz_Globs *)pG).wbuf_len = 0;
+    if (!(*(Uz_Globs *)pG).disk_full &&
+        writev_all(fileno((*(Uz_Globs *)pG).outfile), &iov, 1))
+        return disk_error(pG);
+    return PK_OK;
+
+} /* end function drain_outfile() */
+
+
+
+
+#ifdef USE_ASYNC_WRITE
+
+/**************************/
+/* Function free_writer() */
+/**************************/
+
+void free_writer(pG)
+    Uz_Globs *pG;
+{
+    write_ring *wr = (write_ring *)(*(Uz_Globs *)pG).wring;
+    int i;
+
+    /* the thread goes once its queue is empty (drain_outfile() has seen to
+     * that), and wbuf with the other buffers */
+    if (wr == (write_ring *)NULL)
+        return;
+    pthread_mutex_lock(&wr->lock);
+    wr->quit = TRUE;
+    pthread_cond_signal(&wr->wake);
+    pthread_mutex_unlock(&wr->lock);
+    pthread_join(wr->thread, NULL);
+    pthread_cond_destroy(&wr->done);
+    pthread_cond_destroy(&wr->wake);
+    pthread_mutex_destroy(&wr->lock);
+    for (i = 0;  i < WRITE_BUFS;  ++i)
+        free(wr->buf[i]);
+    free(wr);
+    (*(Uz_Globs *)pG).wring = (void *)NULL;
+    (*(Uz_Globs *)pG).wbuf = (uch *)NULL;
+    (*(Uz_Globs *)pG).wbuf_size = (*(Uz_Globs *)pG).wbuf_len = 0;
+
+} /* end function free_writer() */
+
+#endif /* USE_ASYNC_WRITE */
+
+#endif /* USE_WRITEV */
+
+
+
+
+
+#ifdef USE_MMAP_OUTPUT
+
+/**************************/
+/* Function map_outfile() */  /* returns 1 if the outfile is now mapped, */
+/**************************/  /* else 0 */
+
+int map_outfile(pG)
+    Uz_Globs *pG;
+{
+    int outfd;
+    size_t len;
+    void *map;
+    z_stat st;
+
+/*---------------------------------------------------------------------------
+    Before inflating a large member into a new file, give the file its
+    full size, map it, and have inflate() use the mapping itself as its
+    window:  the output then is not copied out of slide[] into a stdio
+    buffer and on to the file.  The blocks are reserved up front, as a
+    full disk would otherwise show up as SIGBUS while writing to the
+    mapping; where they cannot be (no fallocate() support, short of
+    space, ...) it is all done the usual way.  Nothing is reserved for
+    a size the compressed data cannot inflate to (deflate does not get
+    beyond about 1032:1), nor by an emulation that writes the zeros
+    (see RESERVE_OUTFILE in unxcfg.h).  The SLIDE_SLACK bytes
+    past the end for copy_match() go again in unmap_outfile(), as does
+    whatever inflate() did not get to flush().  The CRC is computed by
+    flush() as usual, in pieces as they come.  Text conversion changes
+    the length, and Deflate64 needs the window to wrap round, so neither
+    is done this way.  Nor in a -w worker (msgsink set):  a file that
+    another process or thread truncates under the mapping is a SIGBUS.
+  ---------------------------------------------------------------------------*/
+
+    (*(Uz_Globs *)pG).redirect_slide = 0;
+    if (uO.tflag || uO.cflag || (*(Uz_Globs *)pG).mem_mode ||
+        (*(Uz_Globs *)pG).msgsink != NULL ||
+        (*(Uz_Globs *)pG).pInfo->textmode || (*(Uz_Globs *)pG).disk_full ||
+        (*(Uz_Globs *)pG).lrec.compression_method != DEFLATED ||
+        (*(Uz_Globs *)pG).lrec.ucsize < MMAP_OUTPUT_MIN ||
+        (*(Uz_Globs *)pG).lrec.ucsize > (zusz_t)(UINT_MAX / 2) ||
+        (*(Uz_Globs *)pG).lrec.ucsize / 1032 > (zusz_t)(*(Uz_Globs *)pG).lrec.csize)
+        return 0;
+#ifdef USE_SPARSE
+    if ((*(Uz_Globs *)pG).sparse_blk)   /* (every page would be written) */
+        return 0;
+#endif
+    outfd = fileno((*(Uz_Globs *)pG).outfile);
+    len = (size_t)(*(Uz_Globs *)pG).lrec.ucsize + SLIDE_SLACK;
+    if (fflush((*(Uz_Globs *)pG).outfile) != 0 || fstat(outfd, &st) != 0 ||
+        !S_ISREG(st.st_mode) || st.st_size != 0 ||
+        RESERVE_OUTFILE(outfd, len) != 0)
+        return 0;
+    if ((map = mmap((void *)NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    outfd, (off_t)0)) == MAP_FAILED)
+    {
+        ftruncate(outfd, (off_t)0);
+        return 0;
+    }
+
+    (*(Uz_Globs *)pG).redirect_size = (ulg)(*(Uz_Globs *)pG).lrec.ucsize;
+    (*(Uz_Globs *)pG).redirect_buffer = (*(Uz_Globs *)pG).redirect_pointer =
+      (*(Uz_Globs *)pG).redirect_sldptr = (uch *)map;
+    (*(Uz_Globs *)pG)._wsize = (unsigned)(*(Uz_Globs *)pG).redirect_size;
+    (*(Uz_Globs *)pG).redirect_slide = 1;
+    return 1;
+
+} /* end function map_outfile() */
+
+
+
+
+
+/***************************/
+/* Function flush_outmap() */   /* returns PK error codes */
+/***************************/
+
+static int flush_outmap(pG, rawbuf, size)
+    Uz_Globs *pG;
+    uch *rawbuf;
+    ulg size;
+{
+    uch *end = (*(Uz_Globs *)pG).redirect_buffer +
+               (*(Uz_Globs *)pG).redirect_size;
+    uch *p = (*(Uz_Globs *)pG).redirect_pointer;
+    int inplace = (rawbuf == (*(Uz_Globs *)pG).redirect_buffer);
+    ulg n;
+    int r;
+
+/*---------------------------------------------------------------------------
+    flush() for a mapped outfile.  Output inflated into the mapping (from
+    rawbuf, which then is the start of it, up to rawbuf+size) is in place
+    already, and only that part of it not flushed yet is checksummed;
+    anything else (from a library, say) is copied in first.  Should the
+    member run on past its size in the headers, the rest is written the
+    usual way; when it is inflate() running on, the end of the mapping
+    goes into slide[], which serves as the window from then on.
+  ---------------------------------------------------------------------------*/
+
+    if (inplace) {
+        if (rawbuf + size > p) {
+            n = (ulg)((rawbuf + size) - p);
+            (*(Uz_Globs *)pG).crc32val = crc32((*(Uz_Globs *)pG).crc32val, p, (extent)n);
+            p += n;
         }
+        size = 0;
+    } else {
+        n = MIN(size, (ulg)(end - p));
+        memcpy(p, rawbuf, (extent)n);
+        (*(Uz_Globs *)pG).crc32val = crc32((*(Uz_Globs *)pG).crc32val, p, (extent)n);
+        p += n;
+        rawbuf += n;
+        size -= n;
     }
+    (*(Uz_Globs *)pG).redirect_pointer = p;
 
+    if (p == end) {     /* nothing more fits */
+        if (inplace) {
+            n = MIN((*(Uz_Globs *)pG).redirect_size, WSIZE);
+            memcpy(slide + (WSIZE - n), end - n, (extent)n);
+        }
+        if ((r = unmap_outfile(pG)) != PK_OK)
+            return r;
+        if (size > 0)
+            return flush(pG, rawbuf, size, 0);
+    }
     return PK_OK;
 
-} /* end function flush() [resp. partflush() for 16-bit Deflate64 support] */
+} /* end function flush_outmap() */
+
+
+
+
+
+/****************************/
+/* Function unmap_outfile() */   /* returns PK_OK, or PK_DISK if the file */
+/****************************/   /* cannot be put right */
+
+int unmap_outfile(pG)
+    Uz_Globs *pG;
+{
+    zoff_t done;
+
+/*---------------------------------------------------------------------------
+    Done with the mapping of map_outfile() (if any):  cut the file down to
+    the output flushed so far, and go on from there in slide[] and stdio.
+  ---------------------------------------------------------------------------*/
+
+    if (!(*(Uz_Globs *)pG).redirect_slide)
+        return PK_OK;
+    done = (zoff_t)((*(Uz_Globs *)pG).redirect_pointer -
+                    (*(Uz_Globs *)pG).redirect_buffer);
+    munmap((void *)(*(Uz_Globs *)pG).redirect_buffer,
+           (size_t)(*(Uz_Globs *)pG).redirect_size + SLIDE_SLACK);
+    (*(Uz_Globs *)pG).redirect_slide = 0;
+    (*(Uz_Globs *)pG).redirect_buffer = (*(Uz_Globs *)pG).redirect_pointer =
+      (uch *)NULL;
+    (*(Uz_Globs *)pG).redirect_sldptr = slide;
+    (*(Uz_Globs *)pG)._wsize = WSIZE;
+    if (ftruncate(fileno((*(Uz_Globs *)pG).outfile), (off_t)done) != 0 ||
+        zfseeko((*(Uz_Globs *)pG).outfile, done, SEEK_SET) != 0)
+        return disk_error(pG);
+    return PK_OK;
+
+} /* end function unmap_outfile() */
+
+#endif /* USE_MMAP_OUTPUT */
 
 
 
@@ -1243,6 +3537,9 @@ time_t dos_to_unix_time(dosdatetime)
     int leap;
     unsigned days;
     struct tm *tm;
+#ifdef USE_PARALLEL
+    struct tm tmbuf;            /* for LOCALTIME() */
+#endif
 #if (!defined(MACOS) && !defined(RISCOS) && !defined(QDOS) && !defined(TANDEM))
 #ifdef WIN32
     TIME_ZONE_INFORMATION tzinfo;
@@ -1322,7 +3619,7 @@ time_t dos_to_unix_time(dosdatetime)
         m_time = U_TIME_T_MAX;  /* saturate in case of (unsigned) overflow */
     if (m_time < (time_t)0L)    /* a converted DOS time cannot be negative */
         m_time = S_TIME_T_MAX;  /*  -> saturate at max signed time_t value */
-    if ((tm = localtime(&m_time)) != (struct tm *)NULL)
+    if ((tm = LOCALTIME(&m_time, &tmbuf)) != (struct tm *)NULL)
         m_time -= tm->tm_gmtoff;                /* sec. EAST of GMT: subtr. */
 #else /* !(BSD4_4 */
     ftime(&tbp);                                /* get `timezone' */
@@ -1349,7 +3646,7 @@ time_t dos_to_unix_time(dosdatetime)
     if (m_time < (time_t)0L)    /* a converted DOS time cannot be negative */
         m_time = S_TIME_T_MAX;  /*  -> saturate at max signed time_t value */
     TIMET_TO_NATIVE(m_time)     /* NOP unless MSC 7.0 or Macintosh */
-    if (((tm = localtime((time_t *)&m_time)) != NULL) && tm->tm_isdst)
+    if (((tm = LOCALTIME((time_t *)&m_time, &tmbuf)) != NULL) && tm->tm_isdst)
 #ifdef WIN32
         m_time += 60L * tzinfo.DaylightBias;    /* adjust with DST bias */
     else
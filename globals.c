@@ -167,7 +167,6 @@ globalsCtor (void)
     (*(Uz_Globs *)pG).wildzipfn = "";
     (*(Uz_Globs *)pG).pfnames = (char **)fnames;
     (*(Uz_Globs *)pG).pxnames = (char **)&fnames[1];
-    (*(Uz_Globs *)pG).pInfo = (*(Uz_Globs *)pG).info;
     (*(Uz_Globs *)pG).sol = TRUE;          /* at start of line */
 
     (*(Uz_Globs *)pG).message = UzpMessagePrnt;
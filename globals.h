@@ -195,21 +195,49 @@ typedef struct Globals {
      cbList(processExternally);    /* call-back list */
 # endif
 #endif /* DLL */
+#ifdef USE_MMAP_OUTPUT  /* (never with DLL:  same fields, other use) */
+     int redirect_slide;  /* inflating straight into the mapped outfile */
+     unsigned _wsize;     /* window size:  WSIZE, or all of the mapping */
+     ulg redirect_size;            /* size of the member, as mapped */
+     uch *redirect_buffer;         /* the mapping of the outfile */
+     uch *redirect_pointer;        /* past the end of the data flushed */
+     uch *redirect_sldptr;         /* the mapping, or slide */
+#endif
 
     char **pfnames;
     char **pxnames;
     char sig[4];
     char answerbuf[10];
-    min_info info[DIR_BLKSIZ];
+    min_info *info;                 /* per-member table, grown on demand */
+    unsigned info_max;              /* entries allocated in info[] */
     min_info *pInfo;
     union work area;                /* see unzpriv.h for definition of work */
 
     const ulg *crc_32_tab;
     ulg       crc32val;             /* CRC shift reg. (was static in funzip) */
+    int       crc_elsewhere;        /* crc32val is found by threads (extract.c) */
+    zoff_t    crc_passed;           /* ...and flush() only counts the bytes */
+    zoff_t    prealloc_len;         /* outfile blocks reserved (fileio.c) */
+    unsigned  sparse_blk;           /* -S:  outfile hole granularity, or 0 */
+    zoff_t    sparse_at;            /* -S:  bytes of outfile data so far */
+#ifdef USE_WRITEV
+    uch       *wbuf;                /* outfile data not written yet */
+    unsigned  wbuf_size, wbuf_len;  /*  (see write_outbuf() in fileio.c) */
+#ifdef USE_ASYNC_WRITE
+    void      *wring;               /* writer thread state (fileio.c) */
+    int       write_sync;           /* no writer thread (-w workers, failed) */
+#endif
+#endif
+    zoff_t    range_at;             /* -r:  where flush()'s data are in member */
+    int       range_part;           /* -r:  only part of it inflated, no CRC */
+    void      *zindex;              /* -k/-r:  the zipfile's index (parinfl.c) */
 
     uch       *inbuf;               /* input buffer (any size is OK) */
     uch       *inptr;               /* pointer into input buffer */
     int       incnt;
+    unsigned  inbufsiz;             /* size of the next zipfile read */
+    unsigned  inbuf_max;            /* (max.) size of a zipfile read */
+    unsigned  inbuf_len;            /* valid bytes in inbuf[] (current block) */
 
     ulg       bitbuf;
     int       bits_left;            /* unreduce and unshrink only */
@@ -218,6 +246,14 @@ typedef struct Globals {
     char      *wildzipfn;
     char      *zipfn;    /* GRR:  WINDLL:  must nuke any malloc'd zipfn... */
     FILE      *zipfd;               /* zipfile file descriptor */
+    uch       *zipmap;              /* read-only mapping of zipfd, or NULL */
+    zoff_t    zipmaplen;            /* USE_MMAP_INPUT:  size of zipmap[] */
+    int       zipmap_faults;        /* zipmap_fault()s seen (zipmap_faulted()) */
+    uch       *inbuf_mem;           /* malloc'd inbuf; inbuf may be in zipmap */
+    unsigned  inbuf_memsiz;         /* size of inbuf_mem[] (+4 for hold[]) */
+    void      *prefetch;            /* read-ahead thread state (fileio.c) */
+    zoff_t    prefetch_end;         /* end of member data being prefetched */
+    void      *readahead;           /* queued member reads (fileio.c) */
     zoff_t    ziplen;
     zoff_t    cur_zipfile_bufstart; /* extract_or_test, readbuf, ReadByte */
     zoff_t    extra_bytes;          /* used in unzip.c, misc.c */
@@ -305,6 +341,7 @@ typedef struct Globals {
     int fzofft_index;
 
     MsgFn *message;
+    void *msgsink;            /* extract.c:  where a worker's messages go */
     InputFn *input;
     PauseFn *mpause;
     PasswdFn *decr_passwd;
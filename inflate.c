@@ -283,7 +283,18 @@
 /* some buffer counters must be capable of holding 64k for Deflate64 */
 #  define UINT_D64 unsigned
 
+/* the window may be redirected:  into the DLL caller's buffer, or into a
+ * mapping of the outfile (see map_outfile() in fileio.c) */
 #if (defined(DLL) && !defined(NO_SLIDE_REDIR))
+#  define SLIDE_REDIR
+#endif
+#if (defined(USE_MMAP_OUTPUT) && !defined(USE_ZLIB))
+#  define SLIDE_REDIR
+#  undef redirSlide
+#  define redirSlide (*(Uz_Globs *)pG).redirect_sldptr
+#endif
+
+#ifdef SLIDE_REDIR
 #  define wsize (*(Uz_Globs *)pG)._wsize    /* wsize is a variable */
 #else
 #  define wsize WSIZE       /* wsize is a constant */
@@ -360,8 +371,11 @@ static int zlib_outCB OF((void FAR *pG, unsigned char FAR *outbuf,
 static unsigned 
 zlib_inCB (void FAR *pG, unsigned char FAR *FAR *pInbuf)
 {
+    unsigned count = (unsigned)fillinbuf(pG);
+
+    /* (refilling may move inbuf when the zipfile is memory-mapped) */
     *pInbuf = (*(Uz_Globs *)pG).inbuf;
-    return fillinbuf(pG);
+    return count;
 }
 
 static int 
@@ -397,7 +411,7 @@ UZinflate (Uz_Globs *pG, int is_defl64)
     int err=Z_OK;
 #if USE_ZLIB_INFLATCB
 
-#if (defined(DLL) && !defined(NO_SLIDE_REDIR))
+#ifdef SLIDE_REDIR
     if ((*(Uz_Globs *)pG).redirect_slide)
         wsize = (*(Uz_Globs *)pG).redirect_size, redirSlide = (*(Uz_Globs *)pG).redirect_buffer;
     else
@@ -543,7 +557,7 @@ UZinflate (Uz_Globs *pG, int is_defl64)
 #else /* !USE_ZLIB_INFLATCB */
     int repeated_buf_err;
 
-#if (defined(DLL) && !defined(NO_SLIDE_REDIR))
+#ifdef SLIDE_REDIR
     if ((*(Uz_Globs *)pG).redirect_slide)
         wsize = (*(Uz_Globs *)pG).redirect_size, redirSlide = (*(Uz_Globs *)pG).redirect_buffer;
     else
@@ -682,7 +696,7 @@ UZinflate (Uz_Globs *pG, int is_defl64)
       (*(Uz_Globs *)pG).dstrm.total_out));
 
     (*(Uz_Globs *)pG).inptr = (uch *)(*(Uz_Globs *)pG).dstrm.next_in;
-    (*(Uz_Globs *)pG).incnt = ((*(Uz_Globs *)pG).inbuf + INBUFSIZ) - (*(Uz_Globs *)pG).inptr;  /* reset for other routines */
+    (*(Uz_Globs *)pG).incnt = ((*(Uz_Globs *)pG).inbuf + (*(Uz_Globs *)pG).inbuf_len) - (*(Uz_Globs *)pG).inptr;  /* reset for other routines */
 
 uzinflate_cleanup_exit:
     err = inflateReset(&(*(Uz_Globs *)pG).dstrm);
@@ -698,6 +712,33 @@ uzinflate_cleanup_exit:
 #else /* !USE_ZLIB */
 
 
+/* The fast decoding loop below takes 64 bits at a time into the bit buffer,
+   which must be that wide (it is an ulg, so LP64 only for now).  It reads
+   the input buffer directly, which fUnZip does not use. */
+#if (!defined(NO_INFLATE_FAST) && !defined(INFLATE_FAST) && !defined(FUNZIP))
+#  if (defined(ULONG_MAX) && (ULONG_MAX > 0xffffffffUL))
+#    define INFLATE_FAST
+#  endif
+#endif
+
+#ifdef INFLATE_FAST
+/* Flat lookup table entry for inflate_fast():  a code of up to FAST_LBITS
+   (literal/length) resp. FAST_DBITS (distance) bits, found in one step
+   instead of going through the levels of the huft tables.  e is as in
+   struct huft; the few longer codes are marked FAST_SLOW. */
+struct fastcode {
+    uch e;              /* number of extra bits or operation */
+    uch b;              /* number of bits in this code, all levels */
+    ush v;              /* literal, length base, or distance base */
+};
+#  define FAST_LBITS  10
+#  define FAST_DBITS  8
+#  define FAST_SLOW   64
+#  define FAST_MININ  16    /* input bytes needed for one code and its match */
+#  define FAST_MINOUT 258   /* window room needed for same (but Deflate64) */
+#endif
+
+
 /* Function prototypes */
 #ifndef OF
 #  ifdef __STDC__
@@ -708,6 +749,14 @@ uzinflate_cleanup_exit:
 #endif /* !OF */
 int inflate_codes OF((Uz_Globs *pG, struct huft *tl, struct huft *td,
                       unsigned bl, unsigned bd));
+#ifdef INFLATE_FAST
+static void fast_table OF((struct huft *t, unsigned m, struct fastcode *f,
+                           unsigned fbits));
+static int inflate_fast OF((Uz_Globs *pG, struct huft *tl, struct huft *td,
+                            unsigned bl, unsigned bd, struct fastcode *lf,
+                            struct fastcode *df, ulg *pb, unsigned *pk,
+                            UINT_D64 *pw));
+#endif
 static int inflate_stored OF((Uz_Globs *pG));
 static int inflate_fixed OF((Uz_Globs *pG));
 static int inflate_dynamic OF((Uz_Globs *pG));
@@ -889,6 +938,235 @@ static const unsigned lbits = 9;
 static const unsigned dbits = 6;
 
 
+#ifdef INFLATE_FAST
+
+/* Load the next eight input bytes into the bit buffer above the k bits
+   already there, but count (and step over) only as many whole bytes as
+   fit, leaving 56..63 bits; the others are loaded again next time.  The
+   byte-wise load is one move on little-endian machines with any decent
+   compiler. */
+#define FASTBITS {b|=(((ulg)in[0])|((ulg)in[1]<<8)|((ulg)in[2]<<16)|\
+    ((ulg)in[3]<<24)|((ulg)in[4]<<32)|((ulg)in[5]<<40)|((ulg)in[6]<<48)|\
+    ((ulg)in[7]<<56))<<k;in+=(63-k)>>3;k|=56;}
+
+
+static void
+fast_table (
+    struct huft *t,     /* first level of a huft table */
+    unsigned m,         /* bits it decodes, at most fbits */
+    struct fastcode *f, /* table to build, 1 << fbits entries */
+    unsigned fbits
+)
+/* Flatten the codes of up to fbits bits found through t into f, for all
+   combinations of the bits following them; longer codes are left to the
+   huft tables. */
+{
+  unsigned i;           /* fbits code bits, first bit lowest */
+  unsigned e;           /* huft table entry flag */
+  unsigned u;           /* bits used up by the tables above */
+  struct huft *p;       /* entry for i in the current level */
+
+  for (i = 0; i < (1U << fbits); i++)
+  {
+    p = t + (i & mask_bits[m]);
+    u = 0;
+    while ((e = p->e) > 32 && !IS_INVALID_CODE(e))
+    {
+      u += p->b;
+      if (u + (e & 31) > fbits)
+        break;
+      p = p->v.t + ((i >> u) & mask_bits[e & 31]);
+    }
+    if (e > 32 && !IS_INVALID_CODE(e))
+    {
+      f[i].e = FAST_SLOW;
+      f[i].b = 0;
+      f[i].v = 0;
+    }
+    else
+    {
+      f[i].e = (uch)e;
+      f[i].b = (uch)(u + p->b);
+      f[i].v = IS_INVALID_CODE(e) ? 0 : p->v.n;
+    }
+  }
+}
+
+
+
+static int
+inflate_fast (
+    Uz_Globs *pG,
+    struct huft *tl,
+    struct huft *td,    /* literal/length and distance decoder tables */
+    unsigned bl,
+    unsigned bd,        /* number of bits decoded by tl[] and td[] */
+    struct fastcode *lf,
+    struct fastcode *df,        /* flat tables made of tl[] and td[] */
+    ulg *pb,
+    unsigned *pk,       /* bit buffer and its bit count */
+    UINT_D64 *pw        /* window position */
+)
+/* Decode codes for inflate_codes() as long as there is enough input in the
+   buffer and room in the window for any code and its match, so that none
+   of that needs checking on the way:  bits are taken straight from inptr,
+   eight bytes at a time, and nearly all codes are looked up in one step
+   in lf[] and df[].  Return zero when input or room are short, -1 at the
+   end of the block, else an error code as inflate_codes() does. */
+{
+  unsigned e;           /* table entry flag/number of extra bits */
+  unsigned v;           /* literal, length base or distance base */
+  unsigned dist;        /* distance back of the match */
+  unsigned d;           /* index for copy */
+  UINT_D64 n;           /* length for copy (deflate64: might be 64k+2) */
+  UINT_D64 w;           /* current window position (deflate64: up to 64k) */
+  struct fastcode *f;   /* flat table entry */
+  struct huft *t;       /* huft table entry, for long codes */
+  ulg b;                /* bit buffer */
+  unsigned k;           /* number of bits in bit buffer */
+  uch *in;              /* next input byte */
+  uch *in_end;          /* no more codes beyond here */
+  uch *out, *from;      /* match copy pointers */
+  UINT_D64 w_end;       /* no more codes beyond here either */
+  int slack;            /* true if copy_match() may overrun */
+  int retval = 0;
+
+  if ((*(Uz_Globs *)pG).incnt < FAST_MININ || *pw > wsize - FAST_MINOUT)
+    return 0;
+  b = *pb;
+  k = *pk;
+  w = *pw;
+  in = (*(Uz_Globs *)pG).inptr;
+  in_end = in + ((*(Uz_Globs *)pG).incnt - FAST_MININ);
+  w_end = wsize - FAST_MINOUT;
+#ifdef USE_MMAP_OUTPUT
+  /* back to inflate_codes() now and then, to checksum the output in cache */
+  if ((*(Uz_Globs *)pG).redirect_slide && w_end - w > WSIZE)
+    w_end = w + WSIZE;
+#endif
+  slack = ((*(Uz_Globs *)pG).cplens != cplens64);
+
+  while (in <= in_end && w <= w_end)
+  {
+    /* decode a literal/length code:  at most 15 bits */
+    FASTBITS
+    f = lf + ((unsigned)b & ((1 << FAST_LBITS) - 1));
+    if ((e = f->e) != FAST_SLOW) {
+      DUMPBITS(f->b)
+      v = f->v;
+    } else {
+      t = tl + ((unsigned)b & mask_bits[bl]);
+      while (1) {
+        DUMPBITS(t->b)
+        if ((e = t->e) <= 32 || IS_INVALID_CODE(e))
+          break;
+        t = t->v.t + ((unsigned)b & mask_bits[e & 31]);
+      }
+      v = t->v.n;
+    }
+
+    if (e == 32)                /* then it's a literal */
+    {
+      redirSlide[w++] = (uch)v;
+      continue;
+    }
+    if (e == 31)                /* it's the EOB signal */
+    {
+      retval = -1;
+      break;
+    }
+    if (IS_INVALID_CODE(e))
+      return 1;
+
+    /* get length of block to copy:  at most 16 more bits */
+    n = v + ((unsigned)b & mask_bits[e]);
+    DUMPBITS(e)
+
+    /* decode distance of block to copy:  at most 15 + 14 bits */
+    if (k < 29)
+      FASTBITS
+    f = df + ((unsigned)b & ((1 << FAST_DBITS) - 1));
+    if ((e = f->e) != FAST_SLOW) {
+      DUMPBITS(f->b)
+      v = f->v;
+    } else {
+      t = td + ((unsigned)b & mask_bits[bd]);
+      while (1) {
+        DUMPBITS(t->b)
+        if ((e = t->e) <= 32 || IS_INVALID_CODE(e))
+          break;
+        t = t->v.t + ((unsigned)b & mask_bits[e & 31]);
+      }
+      v = t->v.n;
+    }
+    if (e >= 32)                /* (td[] has no literals, no EOB) */
+      return 1;
+    dist = v + ((unsigned)b & mask_bits[e]);
+    DUMPBITS(e)
+
+    /* do the copy:  usually all of it within the window as it is */
+    if ((UINT_D64)dist <= w && n <= wsize - w)
+    {
+      out = redirSlide + (unsigned)w;
+      from = out - dist;
+      w += n;
+      if (slack)
+        copy_match(out, from, (unsigned)n);
+      else if ((UINT_D64)dist >= n)
+        memcpy(out, from, (extent)n);
+      else
+        do {
+          *out++ = *from++;
+        } while (--n);
+    }
+    else                        /* from the far end, or Deflate64 length */
+    {
+#ifdef SLIDE_REDIR
+      if ((*(Uz_Globs *)pG).redirect_slide)
+        return 1;               /* (no far end:  invalid compressed data) */
+#endif
+      d = (unsigned)w - dist;
+      do {
+        e = (unsigned)(wsize -
+                       ((d &= (unsigned)(wsize-1)) > (unsigned)w ?
+                        (UINT_D64)d : w));
+        if ((UINT_D64)e > n) e = (unsigned)n;
+        n -= e;
+        if ((unsigned)w - d >= e)
+        {
+          memcpy(redirSlide + (unsigned)w, redirSlide + d, e);
+          w += e;
+          d += e;
+        }
+        else
+          do {
+            redirSlide[w++] = redirSlide[d++];
+          } while (--e);
+        if (w == wsize)
+        {
+          if ((retval = FLUSH(w)) != 0)
+            return retval;
+          w = 0;
+        }
+      } while (n);
+    }
+  }
+
+  /* hand back the whole bytes not used up, for reading on byte-wise */
+  in -= k >> 3;
+  k &= 7;
+  b &= mask_bits[k];
+  (*(Uz_Globs *)pG).incnt -= (int)(in - (*(Uz_Globs *)pG).inptr);
+  (*(Uz_Globs *)pG).inptr = in;
+  *pb = b;
+  *pk = k;
+  *pw = w;
+  return retval;
+}
+
+#endif /* INFLATE_FAST */
+
+
 int 
 inflate_codes (
     Uz_Globs *pG,
@@ -906,15 +1184,30 @@ inflate_codes (
   UINT_D64 w;           /* current window position (deflate64: up to 64k) */
   struct huft *t;       /* pointer to table entry */
   unsigned ml, md;      /* masks for bl and bd bits */
-  register ulg b;       /* bit buffer */
+  ulg b;                /* bit buffer */
   unsigned k;  /* number of bits in bit buffer */
   int retval = 0;       /* error code returned: initialized to "no error" */
+  int slack;            /* true if copy_match() may overrun */
+#ifdef INFLATE_FAST
+  struct fastcode lf[1 << FAST_LBITS];  /* flat tables for inflate_fast() */
+  struct fastcode df[1 << FAST_DBITS];
+  int fast;             /* 1 if built, 0 if not yet, -1 if no use */
+#endif
 
 
   /* make local copies of globals */
   b = (*(Uz_Globs *)pG).bb;                       /* initialize bit buffer */
   k = (*(Uz_Globs *)pG).bk;
   w = (*(Uz_Globs *)pG).wp;                       /* initialize window position */
+  /* Deflate64 distances reach back all the way round the window */
+  slack = (redirSlack && (*(Uz_Globs *)pG).cplens != cplens64);
+#ifdef INFLATE_FAST
+  fast = (bl > FAST_LBITS || bd > FAST_DBITS) ? -1 : 0;
+#  if (defined(DLL) && !defined(NO_SLIDE_REDIR))
+  if ((*(Uz_Globs *)pG).redirect_slide)
+    fast = -1;
+#  endif
+#endif
 
 
   /* inflate the coded data */
@@ -922,6 +1215,41 @@ inflate_codes (
   md = mask_bits[bd];
   while (1)                     /* do until end of block */
   {
+#ifdef USE_MMAP_OUTPUT
+    /* flush() just checksums the output in the mapping:  do that while
+       the last of it is still in cache, rather than all at the end */
+    if ((*(Uz_Globs *)pG).redirect_slide &&
+        w - (UINT_D64)((*(Uz_Globs *)pG).redirect_pointer - redirSlide) >=
+        WSIZE)
+    {
+      if ((retval = FLUSH(w)) != 0) goto cleanup_and_exit;
+    }
+#endif
+#ifdef INFLATE_FAST
+    /* the bulk of the codes, when the input buffer and window allow */
+    if (fast >= 0 && (*(Uz_Globs *)pG).incnt >= FAST_MININ &&
+        w <= wsize - FAST_MINOUT)
+    {
+      if (fast == 0)
+      {
+        fast_table(tl, bl, lf, FAST_LBITS);
+        if (td != (struct huft *)NULL)
+          fast_table(td, bd, df, FAST_DBITS);
+        else                    /* only literals:  no lengths either */
+          for (e = 0; e < (1 << FAST_DBITS); e++)
+            df[e].e = INVALID_CODE;
+        fast = 1;
+      }
+      if ((retval = inflate_fast(pG, tl, td, bl, bd, lf, df, &b, &k, &w))
+          != 0)
+      {
+        if (retval > 0)
+          goto cleanup_and_exit;
+        retval = 0;
+        goto cleanup_decode;
+      }
+    }
+#endif
     NEEDBITS(bl)
     t = tl + ((unsigned)b & ml);
     while (1) {
@@ -964,7 +1292,7 @@ inflate_codes (
 
         /* do the copy */
         do {
-#if (defined(DLL) && !defined(NO_SLIDE_REDIR))
+#ifdef SLIDE_REDIR
           if ((*(Uz_Globs *)pG).redirect_slide) {
             /* &= w/ wsize unnecessary & wrong if redirect */
             if ((UINT_D64)d >= wsize)
@@ -988,11 +1316,23 @@ inflate_codes (
           }
           else                  /* do it slowly to avoid memcpy() overlap */
 #endif /* !NOMEMCPY */
+          if (slack)            /* (but not byte by byte) */
+          {
+            copy_match(redirSlide + (unsigned)w, redirSlide + d, e);
+            w += e;
+            d += e;
+          }
+          else
             do {
               redirSlide[w++] = redirSlide[d++];
             } while (--e);
           if (w == wsize)
           {
+#ifdef USE_MMAP_OUTPUT
+            /* (the same as before, unless flush() moves the end of a full
+               mapping into slide[] to go on in:  then it is right there) */
+            d -= (unsigned)w;
+#endif
             if ((retval = FLUSH(w)) != 0) goto cleanup_and_exit;
             w = 0;
           }
@@ -1392,7 +1732,7 @@ int inflate(pG, is_defl64)
   unsigned h = 0;       /* maximum struct huft's malloc'ed */
 #endif
 
-#if (defined(DLL) && !defined(NO_SLIDE_REDIR))
+#ifdef SLIDE_REDIR
   if ((*(Uz_Globs *)pG).redirect_slide)
     wsize = (*(Uz_Globs *)pG).redirect_size, redirSlide = (*(Uz_Globs *)pG).redirect_buffer;
   else
@@ -1474,6 +1814,7 @@ int inflate_free(pG)
 /*
  * GRR:  moved huft_build() and huft_free() down here; used by explode()
  *       and fUnZip regardless of whether USE_ZLIB defined or not
+ *       (as is copy_match(), by explode())
  */
 
 
@@ -1709,3 +2050,57 @@ huft_free (
   }
   return 0;
 }
+
+
+
+void
+copy_match (
+    uch *out,           /* where the match goes */
+    const uch *from,    /* where it is, before out */
+    unsigned n          /* its length, at least one */
+)
+/* Copy n bytes from from to out, where they may overlap:  with a distance
+   out - from less than n, the last that many bytes before out repeat.
+   The bytes go in pieces of up to 32, so that as many as SLIDE_SLACK - 1
+   bytes beyond out + n may be overwritten, which the caller must allow
+   for:  slide[] has SLIDE_SLACK bytes extra at the end, and in it there
+   is no harm done as long as no later distance reaches as far back as
+   the window size less SLIDE_SLACK (not so for Deflate64). */
+{
+  uch *end = out + n;
+  unsigned dist = (unsigned)(out - from);
+  unsigned step;        /* multiple of dist up to 8 */
+  uch pat[8];           /* 8 bytes of a pattern of dist < 8 bytes */
+
+  if (dist >= 32)
+    do {
+      memcpy(out, from, 32);
+      out += 32;
+      from += 32;
+    } while (out < end);
+  else if (dist >= 16)
+    do {
+      memcpy(out, from, 16);
+      out += 16;
+      from += 16;
+    } while (out < end);
+  else if (dist >= 8)
+    do {
+      memcpy(out, from, 8);
+      out += 8;
+      from += 8;
+    } while (out < end);
+  else if (dist == 1)           /* a run of one byte */
+    memset(out, *from, n);
+  else if (dist > 1)            /* repeat the short pattern, 8 at a time */
+  {
+    for (step = 0; step < 8; step++)
+      pat[step] = from[step % dist];
+    step = 8 - 8 % dist;
+    do {
+      memcpy(out, pat, 8);
+      out += step;
+    } while (out < end);
+  }
+  /* (a distance of zero leaves out as it was) */
+}
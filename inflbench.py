@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+
+# Times "unzip -tq" on a fixed corpus, for each unzip given and, where it
+# was built with an inflate library (EXT_INFLATE), with the built-in
+# inflate as well (UNZIP_INFLATE=builtin).  Build one unzip per meson
+# "inflate" option to compare all of them:
+#
+#   inflbench.py build-builtin/unzip build-zlib/unzip build-libdeflate/unzip
+
+import os, sys, random, subprocess, tempfile, time, zipfile
+
+ROUNDS = 5
+
+def make_corpus(zip_file):
+    rnd = random.Random(1990)      # same corpus every time
+    words = [bytes(rnd.choice(b'abcdefghijklmnopqrstuvwxyz_')
+                   for _ in range(rnd.randint(2, 12))) for _ in range(5000)]
+    def text(n):
+        out = []
+        size = 0
+        while size < n:
+            line = b' '.join(rnd.choice(words)
+                             for _ in range(rnd.randint(1, 14))) + b'\n'
+            out.append(line)
+            size += len(line)
+        return b''.join(out)[:n]
+    with zipfile.ZipFile(zip_file, 'w', zipfile.ZIP_DEFLATED) as zf:
+        zf.writestr('big.txt', text(32 << 20))
+        zf.writestr('random.bin', rnd.randbytes(1 << 20))
+        zf.writestr('runs.bin', b''.join(bytes([rnd.getrandbits(8)]) *
+                                         rnd.randint(1, 300)
+                                         for _ in range(40000)))
+        for i in range(2000):
+            zf.writestr('small/%04d.txt' % i, text(rnd.randint(100, 20000)))
+
+def run_time(unzip_exe, zip_file, env):
+    best = None
+    for _ in range(ROUNDS):
+        start = time.perf_counter()
+        subprocess.check_call([unzip_exe, '-tq', zip_file], env=env,
+                              stdout=subprocess.DEVNULL)
+        t = time.perf_counter() - start
+        best = t if best is None else min(best, t)
+    return best
+
+def bench(unzip_exes):
+    with tempfile.TemporaryDirectory() as tmpdir:
+        zip_file = os.path.join(tmpdir, 'corpus.zip')
+        make_corpus(zip_file)
+        print('corpus: %d bytes' % os.path.getsize(zip_file))
+        env = dict(os.environ)
+        env.pop('UNZIP_INFLATE', None)
+        builtin_env = dict(env, UNZIP_INFLATE='builtin')
+        for unzip_exe in unzip_exes:
+            info = subprocess.run([unzip_exe, '-v'], env=env,
+                                  stdout=subprocess.PIPE).stdout.decode()
+            backend = 'builtin'
+            for line in info.splitlines():
+                if 'EXT_INFLATE (inflating by ' in line:
+                    backend = line.split('inflating by ')[1].split(';')[0]
+            print('%-40s %-10s %8.3f s' % (unzip_exe, backend,
+                                          run_time(unzip_exe, zip_file, env)))
+            if backend != 'builtin':
+                print('%-40s %-10s %8.3f s' % (unzip_exe, 'builtin',
+                      run_time(unzip_exe, zip_file, builtin_env)))
+
+if __name__ == '__main__':
+    bench([exe if os.path.isabs(exe) else os.path.join(os.getcwd(), exe)
+           for exe in sys.argv[1:]])
@@ -0,0 +1,432 @@
+#!/usr/bin/env python3
+
+# Checks the output of unzip with one of its newer options (or settings of
+# the environment) against that of a plain extract, for archives made here.
+
+import os, sys, subprocess, zipfile, tempfile, random, shutil, time, struct
+import resource, signal, warnings
+
+INBUFSIZ = 8192
+
+def make_text(seed, size):
+    r = random.Random(seed)
+    words = [bytes(r.choice(b'abcdefghijklmnop') for _ in range(r.randint(1, 9)))
+             for _ in range(500)]
+    out = []
+    n = 0
+    while n < size:
+        w = r.choice(words) + (b'\n' if r.random() < 0.1 else b' ')
+        out.append(w)
+        n += len(w)
+    return b''.join(out)[:size]
+
+def make_zips(tmpdir):
+    r = random.Random(1)
+    members = {
+        'defl.txt': (make_text(2, 16 << 20), zipfile.ZIP_DEFLATED),
+        'stored.bin': (r.randbytes(5 << 20), zipfile.ZIP_STORED),
+        'small.txt': (b'hello world\n', zipfile.ZIP_STORED),
+        'one': (b'x', zipfile.ZIP_STORED),
+        'tiny.txt': (make_text(3, 700), zipfile.ZIP_DEFLATED),
+        'zeros.bin': (bytes(3 << 20) + b'end' + bytes(1 << 20),
+                      zipfile.ZIP_STORED),
+    }
+    for i in range(300):
+        members['many/m%03d' % i] = (make_text(100 + i, r.randint(0, 3000)),
+                                     zipfile.ZIP_DEFLATED)
+    zip_file = os.path.join(tmpdir, 'test.zip')
+    with zipfile.ZipFile(zip_file, 'w') as zf:
+        for name, (data, method) in members.items():
+            zf.writestr(name, data, compress_type=method)
+    return zip_file, dict((k, v[0]) for k, v in members.items())
+
+def make_tail_zip(tmpdir):
+    # the last members and the central directory all in the zipfile's
+    # last (short) block, where a read ahead of them comes up short
+    r = random.Random(4)
+    members = {'big': r.randbytes(100000)}
+    for i in range(3):
+        members['tail%d' % i] = b'tail %d\n' % i
+    zip_file = os.path.join(tmpdir, 'tail.zip')
+    with zipfile.ZipFile(zip_file, 'w') as zf:
+        for name, data in members.items():
+            zf.writestr(name, data, compress_type=zipfile.ZIP_STORED
+                        if name == 'big' else zipfile.ZIP_DEFLATED)
+    return zip_file, members
+
+def make_rev_zip(tmpdir, members):
+    # the central directory in the reverse order of the data
+    zip_file = os.path.join(tmpdir, 'rev.zip')
+    with zipfile.ZipFile(zip_file, 'w', zipfile.ZIP_DEFLATED) as zf:
+        for name, data in members.items():
+            zf.writestr(name, data)
+        zf.filelist.reverse()
+    return zip_file
+
+def make_aligned_zip(tmpdir):
+    # STORED members whose data start on a 4K boundary, as zipalign and
+    # the like pad them (the padding in an extra field of id 0xd935)
+    r = random.Random(5)
+    members = {'a1.bin': r.randbytes((1 << 20) + 777),
+               'a2.bin': r.randbytes((2 << 20) + 5)}
+    zip_file = os.path.join(tmpdir, 'aligned.zip')
+    with zipfile.ZipFile(zip_file, 'w') as zf:
+        for name, data in members.items():
+            zi = zipfile.ZipInfo(name, (2020, 1, 1, 0, 0, 0))
+            zi.compress_type = zipfile.ZIP_STORED
+            start = zf.fp.tell() + 30 + len(name) + 4
+            zi.extra = struct.pack('<HH', 0xd935, -start % 4096) + \
+                       bytes(-start % 4096)
+            zf.writestr(zi, data)
+    with zipfile.ZipFile(zip_file) as zf:
+        for zi in zf.infolist():
+            if (zi.header_offset + len(zi.FileHeader())) % 4096:
+                print('%s is not aligned in %s.' % (zi.filename, zip_file))
+                sys.exit(1)
+    return zip_file, members
+
+def run(unzip_exe, args, cwd, env=None, stdout=None):
+    e = dict(os.environ)
+    e.update(env or {})
+    p = subprocess.run([unzip_exe] + args, cwd=cwd, env=e,
+                       stdout=stdout or subprocess.DEVNULL,
+                       stderr=subprocess.PIPE)
+    if p.returncode != 0:
+        print('unzip %s failed (%d):' % (' '.join(args), p.returncode))
+        print(p.stderr.decode(errors='replace'))
+        sys.exit(1)
+    return p.stdout
+
+def check_tree(unzip_exe, zip_file, members, tmpdir, args, env=None,
+               old=None):
+    outdir = tempfile.mkdtemp(dir=tmpdir)
+    if old is not None:         # files there already, to be overwritten
+        for name in members:
+            os.makedirs(os.path.dirname(os.path.join(outdir, name)),
+                        exist_ok=True)
+            with open(os.path.join(outdir, name), 'wb') as f:
+                f.write(old(members[name]))
+    run(unzip_exe, ['-qq', '-o'] + args + [zip_file], outdir, env)
+    for name, data in members.items():
+        with open(os.path.join(outdir, name), 'rb') as f:
+            if f.read() != data:
+                print('%s differs with %s.' % (name, ' '.join(args)))
+                sys.exit(1)
+    shutil.rmtree(outdir)
+    run(unzip_exe, ['-tqq'] + args + [zip_file], tmpdir, env)
+
+def check_ranges(unzip_exe, zip_file, members, tmpdir, args=[]):
+    b = INBUFSIZ
+    for name in ('defl.txt', 'stored.bin', 'zeros.bin'):
+        size = len(members[name])
+        for first, last in ((0, 0), (0, 9), (b - 10, b + 10),
+                            (3 * b - 1, 3 * b), (1 << 20, 3 << 20),
+                            ((2 << 20) + 12345, (2 << 20) + 12345),
+                            (size - 100, size - 1), (size - 5, None)):
+            rng = '%d-%s' % (first, '' if last is None else last)
+            data = run(unzip_exe, ['-p', '-r', rng] + args + [zip_file, name],
+                       tmpdir, stdout=subprocess.PIPE)
+            want = members[name][first:None if last is None else last + 1]
+            if data != want:
+                print('%s -r %s differs.' % (name, rng))
+                sys.exit(1)
+    for name, first, last in (('one', 0, 0), ('small.txt', 0, 5),
+                              ('small.txt', 6, 11), ('tiny.txt', 100, 199),
+                              ('many/m150', 10, 20)):
+        rng = '%d-%d' % (first, last)
+        data = run(unzip_exe, ['-p', '-r', rng] + args + [zip_file, name],
+                   tmpdir, stdout=subprocess.PIPE)
+        if data != members[name][first:last + 1]:
+            print('%s -r %s differs.' % (name, rng))
+            sys.exit(1)
+
+def case_inbuf(unzip_exe, zip_file, members, tmpdir):
+    for size in ('8k', '24k', '1m', '64m'):
+        check_tree(unzip_exe, zip_file, members, tmpdir, ['-I', size])
+
+def case_threads(unzip_exe, zip_file, members, tmpdir):
+    plain = run(unzip_exe, ['-t', zip_file], tmpdir, stdout=subprocess.PIPE)
+    for n in ('1', '2', '8'):
+        check_tree(unzip_exe, zip_file, members, tmpdir, ['-w', n])
+        out = run(unzip_exe, ['-t', '-w', n, zip_file], tmpdir,
+                  stdout=subprocess.PIPE)
+        if out != plain:
+            print('-t -w %s does not report as -t does.' % n)
+            sys.exit(1)
+
+def case_parinflate(unzip_exe, zip_file, members, tmpdir):
+    for args in (['-H', '64k'], ['-H', '64k', '-w', '3'],
+                 ['-H', '64k', '-I', '64m']):
+        check_tree(unzip_exe, zip_file, members, tmpdir, args)
+    # a damaged member is reported as without -H
+    with zipfile.ZipFile(zip_file) as zf:
+        info = zf.getinfo('defl.txt')
+    bad_zip = os.path.join(tmpdir, 'bad.zip')
+    data = bytearray(open(zip_file, 'rb').read())
+    data[info.header_offset + info.compress_size // 2] ^= 0x55
+    open(bad_zip, 'wb').write(data)
+    reports = []
+    for args in ([], ['-H', '64k']):
+        p = subprocess.run([unzip_exe, '-t'] + args + [bad_zip, 'defl.txt'],
+                           cwd=tmpdir, stdout=subprocess.PIPE,
+                           stderr=subprocess.STDOUT)
+        reports.append((p.returncode, p.stdout))
+    if reports[0] != reports[1] or reports[0][0] == 0:
+        print('-H reports a damaged member differently.')
+        sys.exit(1)
+
+def case_inflate(unzip_exe, zip_file, members, tmpdir):
+    for env in ({}, {'UNZIP_INFLATE': 'builtin'}):
+        check_tree(unzip_exe, zip_file, members, tmpdir, [], env)
+        check_tree(unzip_exe, zip_file, members, tmpdir, ['-w', '3'], env)
+
+def case_prealloc(unzip_exe, zip_file, members, tmpdir):
+    for env in ({}, {'UNZIP_PREALLOC': 'no'}):
+        check_tree(unzip_exe, zip_file, members, tmpdir, [], env)
+        check_tree(unzip_exe, zip_file, members, tmpdir, ['-w', '3'], env)
+        check_tree(unzip_exe, zip_file, members, tmpdir, [], env,
+                   old=lambda data: b'old' * (len(data) // 2 + 1000))
+
+def case_sparse(unzip_exe, zip_file, members, tmpdir):
+    for args in (['-S'], ['-S', '-w', '3'], ['-S', '-I', '64m']):
+        check_tree(unzip_exe, zip_file, members, tmpdir, args)
+    check_tree(unzip_exe, zip_file, members, tmpdir, ['-S'],
+               old=lambda data: b'\xff' * len(data))
+    # where the file system has holes, the zeros must have become some
+    probe = os.path.join(tmpdir, 'probe')
+    with open(probe, 'wb') as f:
+        f.truncate(1 << 20)
+    if os.stat(probe).st_blocks * 512 >= 1 << 20:
+        return
+    outdir = tempfile.mkdtemp(dir=tmpdir)
+    run(unzip_exe, ['-qq', '-S', zip_file, 'zeros.bin'], outdir)
+    st = os.stat(os.path.join(outdir, 'zeros.bin'))
+    if st.st_size != len(members['zeros.bin']) or \
+       st.st_blocks * 512 >= 1 << 20:
+        print('-S left no holes in zeros.bin.')
+        sys.exit(1)
+
+def case_writebuf(unzip_exe, zip_file, members, tmpdir):
+    # (where flush() does the writing:  to the writer thread by itself,
+    # gathered by writev() with -w, whose workers write for themselves)
+    for size in (None, '0', '1m', '8m'):
+        env = {} if size is None else {'UNZIP_WRITEBUF': size}
+        for args in ([], ['-w', '3'], ['-S']):
+            check_tree(unzip_exe, zip_file, members, tmpdir, args, env)
+
+def small_files():
+    # files written beyond 1 MB fail with EFBIG (SIGXFSZ ignored), as on
+    # a full disk
+    signal.signal(signal.SIGXFSZ, signal.SIG_IGN)
+    resource.setrlimit(resource.RLIMIT_FSIZE, (1 << 20, 1 << 20))
+
+def case_diskfull(unzip_exe, zip_file, members, tmpdir):
+    r = random.Random(6)
+    full_members = {'first.txt': make_text(7, 200000),
+                    'big.txt': make_text(8, 6 << 20),
+                    'big.bin': r.randbytes(3 << 20),
+                    'last.txt': make_text(9, 1000)}
+    for big in ('big.txt', 'big.bin'):
+        full_zip = os.path.join(tmpdir, 'full.zip')
+        with zipfile.ZipFile(full_zip, 'w') as zf:
+            for name in ('first.txt', big, 'last.txt'):
+                zf.writestr(name, full_members[name], compress_type=
+                            zipfile.ZIP_STORED if name == 'big.bin'
+                            else zipfile.ZIP_DEFLATED)
+        for size in (None, '0', '8m'):
+            env = dict(os.environ)
+            if size is not None:
+                env['UNZIP_WRITEBUF'] = size
+            for args in ([], ['-w', '3']):
+                outdir = tempfile.mkdtemp(dir=tmpdir)
+                p = subprocess.run([unzip_exe, '-o'] + args + [full_zip],
+                                   cwd=outdir, env=env,
+                                   stdin=subprocess.DEVNULL,
+                                   stdout=subprocess.DEVNULL,
+                                   stderr=subprocess.PIPE,
+                                   preexec_fn=small_files)
+                err = p.stderr.decode(errors='replace')
+                failed = [l.split(':')[0] for l in err.splitlines()
+                          if 'write error' in l]
+                if p.returncode != 50 or failed != [big]:
+                    print('%s with %s, UNZIP_WRITEBUF=%s gave exit code '
+                          '%d:' % (big, ' '.join(args), size, p.returncode))
+                    print(err)
+                    sys.exit(1)
+                with open(os.path.join(outdir, 'first.txt'), 'rb') as f:
+                    if f.read() != full_members['first.txt']:
+                        print('first.txt differs after the disk was full.')
+                        sys.exit(1)
+                shutil.rmtree(outdir)
+
+def case_range(unzip_exe, zip_file, members, tmpdir):
+    check_ranges(unzip_exe, zip_file, members, tmpdir)
+    check_ranges(unzip_exe, zip_file, members, tmpdir, ['-I', '64m'])
+
+def case_index(unzip_exe, zip_file, members, tmpdir):
+    for inbuf in ([], ['-I', '64m']):
+        index = zip_file + '.zix'
+        if os.path.exists(index):
+            os.remove(index)
+        run(unzip_exe, ['-tqq', '-k', '64k'] + inbuf + [zip_file], tmpdir)
+        if not os.path.exists(index):
+            print('No index written with -k %s.' % ' '.join(inbuf))
+            sys.exit(1)
+        check_ranges(unzip_exe, zip_file, members, tmpdir, inbuf)
+        check_tree(unzip_exe, zip_file, members, tmpdir, ['-k', '64k'] + inbuf)
+        check_tree(unzip_exe, zip_file, members, tmpdir, ['-k', '1'] + inbuf)
+
+def case_readahead(unzip_exe, zip_file, members, tmpdir):
+    tail_zip, tail_members = make_tail_zip(tmpdir)
+    for args in ([], ['-w', '4']):
+        check_tree(unzip_exe, zip_file, members, tmpdir, args)
+        # (whether the reads ahead come in short depends on their timing)
+        for i in range(20):
+            check_tree(unzip_exe, tail_zip, tail_members, tmpdir, args)
+
+def case_order(unzip_exe, zip_file, members, tmpdir):
+    names = sorted(n for n in members if n.startswith('many/'))[:50]
+    rev_zip = make_rev_zip(tmpdir, dict((n, members[n]) for n in names))
+    want = b''.join(members[n] for n in reversed(names))
+    for args in ([], ['-G']):
+        data = run(unzip_exe, ['-p'] + args + [rev_zip], tmpdir,
+                   stdout=subprocess.PIPE)
+        if data != want:
+            print('%s is not in central-directory order.' %
+                  ' '.join(['-p'] + args))
+            sys.exit(1)
+        check_tree(unzip_exe, rev_zip, dict((n, members[n]) for n in names),
+                   tmpdir, args)
+    # done in zipfile order (by default, or -G) or not (--G), with a damaged
+    # member among them:  the same messages in the same order, and the same
+    # result
+    with zipfile.ZipFile(rev_zip) as zf:
+        info = zf.getinfo(names[20])
+    with open(rev_zip, 'r+b') as f:
+        f.seek(info.header_offset + len(info.FileHeader()) + 10)
+        b = f.read(1)
+        f.seek(-1, 1)
+        f.write(bytes([b[0] ^ 0x55]))
+    for mode in (['-t'], ['-o'], ['-n'], ['-t', '-w', '2'], ['-o', '-w', '2']):
+        outs = []
+        for args in (mode, mode + ['-G'], mode + ['--G']):
+            outdir = tempfile.mkdtemp(dir=tmpdir)
+            if '-n' in mode:    # (half of them there already)
+                for name in names[1::2]:
+                    os.makedirs(os.path.join(outdir, os.path.dirname(name)),
+                                exist_ok=True)
+                    open(os.path.join(outdir, name), 'wb').close()
+            p = subprocess.run([unzip_exe] + args + [rev_zip], cwd=outdir,
+                               stdout=subprocess.PIPE,
+                               stderr=subprocess.STDOUT)
+            outs.append((p.returncode, p.stdout))
+            shutil.rmtree(outdir)
+        if outs[1] != outs[0] or outs[2] != outs[0]:
+            print('%s differs with -G or --G:' % ' '.join(mode))
+            for rc, out in outs:
+                print(out.decode(errors='replace'))
+            sys.exit(1)
+        if outs[0][0] != 2 or b'error:' not in outs[0][1]:
+            print('%s gave exit code %d.' % (' '.join(mode), outs[0][0]))
+            sys.exit(1)
+
+def case_samename(unzip_exe, zip_file, members, tmpdir):
+    # several members for the same file, among others:  with -w, they
+    # must still be extracted one after the other, the last one winning
+    same_zip = os.path.join(tmpdir, 'same.zip')
+    want = {}
+    with warnings.catch_warnings():
+        warnings.simplefilter('ignore')     # (duplicate names)
+        with zipfile.ZipFile(same_zip, 'w', zipfile.ZIP_DEFLATED) as zf:
+            for i in range(6):
+                data = make_text(20 + i, 3 << 20)
+                zf.writestr('same.bin', data)
+                want['same.bin'] = data
+                zf.writestr('other%d.txt' % i, data[:1000])
+                want['other%d.txt' % i] = data[:1000]
+            for d in ('a', 'b', 'c'):
+                data = make_text(30 + ord(d), 1 << 20)
+                zf.writestr(d + '/junked.bin', data)
+                want['junked.bin'] = data
+    for i in range(5):
+        check_tree(unzip_exe, same_zip, dict((n, want[n]) for n in want
+                                             if n != 'junked.bin'),
+                   tmpdir, ['-w', '4'])
+        check_tree(unzip_exe, same_zip, want, tmpdir, ['-w', '4', '-j'])
+
+def case_truncate(unzip_exe, zip_file, members, tmpdir):
+    # cut the zipfile short in the middle of stored.bin while unzip is
+    # held up writing it to the pipe:  a read error, not a SIGBUS
+    trunc_zip = os.path.join(tmpdir, 'trunc.zip')
+    shutil.copyfile(zip_file, trunc_zip)
+    with zipfile.ZipFile(zip_file) as z:
+        info = z.getinfo('stored.bin')
+    cut = info.header_offset + len(info.FileHeader()) + (2 << 20)
+    p = subprocess.Popen([unzip_exe, '-p', trunc_zip, 'stored.bin'],
+                         cwd=tmpdir, stdout=subprocess.PIPE,
+                         stderr=subprocess.PIPE)
+    p.stdout.read(1)
+    time.sleep(0.2)
+    os.truncate(trunc_zip, cut)
+    p.stdout.read()
+    err = p.stderr.read().decode(errors='replace')
+    rc = p.wait()
+    if rc != 2 or 'read error' not in err:
+        print('truncated zipfile gave exit code %d:' % rc)
+        print(err)
+        sys.exit(1)
+
+def case_reflink(unzip_exe, zip_file, members, tmpdir):
+    # aligned STORED members are cloned where the filesystem can share
+    # extents (and copied otherwise):  the output is right either way,
+    # and shares extents with the zipfile if reflink works here at all
+    aligned_zip, aligned_members = make_aligned_zip(tmpdir)
+    probe = os.path.join(tmpdir, 'probe')
+    can_reflink = subprocess.run(['cp', '--reflink=always', aligned_zip,
+                                  probe], stderr=subprocess.DEVNULL
+                                 ).returncode == 0
+    if not can_reflink:
+        print('(no reflink here:  not checking for shared extents)')
+    for args in ([], ['-w', '2']):
+        check_tree(unzip_exe, aligned_zip, aligned_members, tmpdir, args)
+        outdir = tempfile.mkdtemp(dir=tmpdir)
+        run(unzip_exe, ['-qq', '-o'] + args + [aligned_zip], outdir)
+        for name in aligned_members:
+            if not can_reflink:
+                break
+            frag = subprocess.run(['filefrag', '-v',
+                                   os.path.join(outdir, name)],
+                                  stdout=subprocess.PIPE).stdout.decode()
+            if 'shared' not in frag:
+                print('%s shares no extents with %s.' % (name, args))
+                print(frag)
+                sys.exit(1)
+        shutil.rmtree(outdir)
+
+cases = {
+    'inbuf': case_inbuf,
+    'range': case_range,
+    'index': case_index,
+    'threads': case_threads,
+    'parinflate': case_parinflate,
+    'inflate': case_inflate,
+    'prealloc': case_prealloc,
+    'sparse': case_sparse,
+    'writebuf': case_writebuf,
+    'readahead': case_readahead,
+    'order': case_order,
+    'samename': case_samename,
+    'truncate': case_truncate,
+    'reflink': case_reflink,
+    'diskfull': case_diskfull,
+}
+
+if __name__ == '__main__':
+    unzip_exe = sys.argv[1]
+    case = sys.argv[2]
+    if not os.path.isabs(unzip_exe):
+        unzip_exe = os.path.join(os.getcwd(), unzip_exe)
+    with tempfile.TemporaryDirectory() as tmpdir:
+        zip_file, members = make_zips(tmpdir)
+        cases[case](unzip_exe, zip_file, members, tmpdir)
+    print('All ok.')
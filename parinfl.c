@@ -0,0 +1,1617 @@
+/*
+  Copyright (c) 1990-2009 Info-ZIP.  All rights reserved.
+
+  See the accompanying file LICENSE, version 2009-Jan-02 or later
+  (the contents of which are also included in unzip.h) for terms of use.
+  If, for some reason, all these files are missing, the Info-ZIP license
+  also may be found at:  ftp://ftp.info-zip.org/pub/infozip/license.html
+*/
+/*---------------------------------------------------------------------------
+
+  parinfl.c
+
+  Inflating one large deflated member on several threads (-H), the way
+  pugz and rapidgzip do it.  The compressed data are cut into parts of
+  PAR_INFLATE_CHUNK bytes.  For each part, a thread looks for the first
+  place in it where a dynamic block seems to start, and inflates from there
+  up to the first block boundary in the next part, without the 32K of
+  output that come before:  whatever refers back to those comes out as a
+  placeholder, a value of 256 + k standing for byte k of that window.  The
+  main thread takes the parts in order.  A part that starts where the one
+  before it stopped has its placeholders filled in from the output so far
+  and goes to flush(), which does the CRC as always; for one that does not
+  (a wrong guess, no guess at all, too much output), the main thread
+  inflates from where the last one stopped itself, knowing the window, up
+  to the part's guess or on to the next part.  Should the data turn out
+  to be bad, or to need anything these routines do not do, the output is
+  rewound and inflate() goes over the whole member again, so that what it
+  reports is reported as always.
+
+  The same inflate, started at a block boundary with the 32K before it
+  known, makes the checkpoint index of -k and the byte ranges of -r:  see
+  below.
+
+  Contains:  pi_build()
+             pi_bits()
+             pi_decode()
+             pi_header()
+             pi_grow()
+             pi_copy()
+             pi_run()
+             pi_candidate()
+             pi_part()
+             pi_worker()
+             pi_emit()
+             pi_stream()
+             pi_fixed()
+             pi_input()
+             pi_redo()
+             pi_restart()
+             par_inflate()
+             px_get()
+             px_put()
+             px_drop()
+             px_load()
+             px_find()
+             px_window()
+             px_write()
+             index_end()
+             index_inflate()
+             range_member()
+
+  ---------------------------------------------------------------------------*/
+
+
+#define __PARINFL_C     /* identifies this source module */
+#define UNZIP_INTERNAL
+#include "unzip.h"
+
+#ifdef USE_PAR_INFLATE
+
+#ifndef PAR_INFLATE_CHUNK
+#  define PAR_INFLATE_CHUNK  0x200000L  /* compressed bytes per part */
+#endif
+#define PI_EXPAND    16         /* a part's output:  at most that many times */
+                                /*  its input (else the main thread does it) */
+#define PI_WINDOW    32768      /* deflate's window */
+#define PI_OUTBUF    0x40000L   /* output the main thread does at a time */
+#define PI_FASTBITS  10         /* codes up to so long are looked up at once */
+#define PI_FASTMASK  ((1 << PI_FASTBITS) - 1)
+#define PI_BITS      57         /* bits pi_bits() gets at once */
+
+/* what pi_run() stopped at */
+#define PI_BOUNDARY  0          /* a block header at or past the stop bit */
+#define PI_FINAL     1          /* the end of the last block */
+#define PI_FULL      2          /* no room for more output */
+#define PI_BAD       3          /* invalid data */
+
+typedef struct pihuff {
+    ush fast[1 << PI_FASTBITS]; /* (symbol << 4) | length; 0: longer code */
+    ush count[16];              /* number of codes of each length */
+    ush symbol[288];            /* symbols in code order */
+} pihuff;
+
+typedef struct pistream {
+    const uch *in;              /* all of the member's compressed data */
+    zoff_t inlen;
+    zoff_t pos;                 /* bit position in them */
+    int blocktype;              /* of the block under way, -1 between blocks */
+    int last;                   /* that block is the last one */
+    unsigned stored;            /* bytes left of a stored block */
+    const pihuff *lcode, *dcode;
+    const pihuff *fixed;        /* the fixed codes:  [0] lengths, [1] dists */
+    pihuff lit, dist;           /* a dynamic block's codes */
+    ush *out;                   /* output:  bytes, or 256 + k for window[k] */
+    size_t outlen, outsize;
+    size_t stopout;             /* stop at a block header once outlen is this */
+    size_t maxsize;             /* out may grow up to that */
+    const uch *window;          /* the PI_WINDOW bytes before out[0], or NULL */
+    unsigned wlen;              /* (only the last wlen of them are there) */
+} pistream;
+
+typedef struct pipart {
+    zoff_t begin, end;          /* bits to look for a block start in */
+    zoff_t start, stop;         /* what the part's output is inflated from */
+    int final;                  /* the last block is among it */
+    int state;
+    ush *out;
+    size_t outlen;
+} pipart;
+
+#define PP_PENDING  0           /* not taken yet */
+#define PP_TAKEN    1           /* a thread is on it */
+#define PP_DONE     2           /* out holds what is between start and stop */
+#define PP_FAILED   3           /* left to the main thread */
+
+typedef struct pipool {
+    pthread_mutex_t lock;
+    pthread_cond_t change;      /* a part is done, or more may be taken */
+    const uch *in;
+    zoff_t inlen;
+    pihuff fixed[2];
+    pipart *part;
+    unsigned nparts;
+    unsigned next;              /* the next part to take */
+    unsigned limit;             /* parts from here on have to wait */
+    int stop;
+    uch *win;                   /* main thread:  the last 32K of output */
+    unsigned wlen;
+    uch *bytes;                 /* main thread:  output on its way out */
+} pipool;
+
+/* the same as in inflate.c, less the Deflate64 parts */
+static const ush pi_lbase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uch pi_lext[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const ush pi_dbase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577};
+static const uch pi_dext[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+static const uch pi_order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+
+
+/*************************/
+/*  Function pi_build()  */
+/*************************/
+
+static int pi_build(h, len, n, complete)   /* return 1 if not a usable code */
+    pihuff *h;
+    const uch *len;             /* code lengths of the n symbols */
+    unsigned n;
+    int complete;               /* no single code of one bit on its own */
+{
+    ush offs[16];
+    unsigned sym, l, i, k, r, code, max = 0;
+    long left = 1;
+
+    /* as zlib has it:  no code may be over-subscribed, and none may be
+     * incomplete other than one made of a single one-bit code (or none) */
+    memzero(h->count, sizeof(h->count));
+    for (sym = 0;  sym < n;  ++sym)
+        ++h->count[len[sym]];
+    for (l = 1;  l < 16;  ++l) {
+        left = (left << 1) - h->count[l];
+        if (left < 0)
+            return 1;
+        if (h->count[l] != 0)
+            max = l;
+    }
+    if (left > 0 && (complete || max > 1))
+        return 1;
+
+    offs[1] = 0;
+    for (l = 1;  l < 15;  ++l)
+        offs[l + 1] = offs[l] + h->count[l];
+    for (sym = 0;  sym < n;  ++sym)
+        if (len[sym] != 0)
+            h->symbol[offs[len[sym]]++] = (ush)sym;
+
+    /* the short codes, bit-reversed as they come in, with all the bits
+     * that may follow them */
+    memzero(h->fast, sizeof(h->fast));
+    code = k = 0;
+    for (l = 1;  l <= PI_FASTBITS;  ++l, code <<= 1)
+        for (i = 0;  i < h->count[l];  ++i, ++code, ++k) {
+            for (r = 0, sym = 0;  sym < l;  ++sym)
+                r |= ((code >> sym) & 1) << (l - 1 - sym);
+            for (;  r < (1 << PI_FASTBITS);  r += 1 << l)
+                h->fast[r] = (ush)((h->symbol[k] << 4) | l);
+        }
+    return 0;
+
+} /* end function pi_build() */
+
+
+
+/************************/
+/*  Function pi_bits()  */
+/************************/
+
+static z_uint8 pi_bits(s)   /* return the PI_BITS bits from s->pos on */
+    const pistream *s;
+{
+    zoff_t at = s->pos >> 3;
+    const uch *p = s->in + (size_t)at;
+    z_uint8 v = 0;
+    int i;
+
+    if (at + 8 <= s->inlen)
+        v = (z_uint8)p[0] | ((z_uint8)p[1] << 8) | ((z_uint8)p[2] << 16) |
+            ((z_uint8)p[3] << 24) | ((z_uint8)p[4] << 32) |
+            ((z_uint8)p[5] << 40) | ((z_uint8)p[6] << 48) |
+            ((z_uint8)p[7] << 56);
+    else                        /* zeros past the end */
+        for (i = 0;  i < 8 && at + i < s->inlen;  ++i)
+            v |= (z_uint8)p[i] << (8 * i);
+    return v >> (int)(s->pos & 7);
+
+} /* end function pi_bits() */
+
+
+
+/**************************/
+/*  Function pi_decode()  */
+/**************************/
+
+static int pi_decode(s, h, pv)  /* return symbol, or -1 if no such code */
+    pistream *s;
+    const pihuff *h;
+    z_uint8 *pv;                /* pi_bits() at s->pos, 15 at least; */
+{                               /*  both go on past the code */
+    z_uint8 bits = *pv;
+    unsigned e = h->fast[(unsigned)bits & PI_FASTMASK];
+    int len, count, code = 0, first = 0, index = 0;
+
+    if (e != 0) {
+        s->pos += e & 15;
+        *pv >>= e & 15;
+        return (int)(e >> 4);
+    }
+    /* a longer code:  canonical decoding, one bit at a time (as in puff) */
+    for (len = 1;  len < 16;  ++len) {
+        code |= (int)(bits & 1);
+        bits >>= 1;
+        count = h->count[len];
+        if (code - count < first) {
+            s->pos += len;
+            *pv >>= len;
+            return h->symbol[index + (code - first)];
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -1;
+
+} /* end function pi_decode() */
+
+
+
+/**************************/
+/*  Function pi_header()  */
+/**************************/
+
+static int pi_header(s)     /* return 1 if no valid block header at s->pos */
+    pistream *s;
+{
+    uch len[286 + 30], cl[19], fill;
+    unsigned hlit, hdist, hclen, i, n, rep;
+    const uch *p;
+    z_uint8 v;
+    int sym;
+
+    v = pi_bits(s);
+    s->last = (int)(v & 1);
+    s->blocktype = (int)((v >> 1) & 3);
+    s->pos += 3;
+    switch (s->blocktype) {
+        case 0:                 /* stored */
+            s->pos = (s->pos + 7) & ~(zoff_t)7;
+            if ((s->pos >> 3) + 4 > s->inlen)
+                return 1;
+            p = s->in + (size_t)(s->pos >> 3);
+            s->stored = (unsigned)p[0] | ((unsigned)p[1] << 8);
+            if (((unsigned)p[2] | ((unsigned)p[3] << 8)) !=
+                (~s->stored & 0xffff))
+                return 1;
+            s->pos += 32;
+            return 0;
+        case 1:                 /* fixed codes */
+            s->lcode = &s->fixed[0];
+            s->dcode = &s->fixed[1];
+            return 0;
+        case 2:                 /* dynamic codes */
+            break;
+        default:
+            return 1;
+    }
+
+    hlit = (unsigned)((v >> 3) & 31) + 257;
+    hdist = (unsigned)((v >> 8) & 31) + 1;
+    hclen = (unsigned)((v >> 13) & 15) + 4;
+    s->pos += 14;
+    if (hlit > 286 || hdist > 30)
+        return 1;
+    memzero(cl, sizeof(cl));
+    for (i = 0;  i < hclen;  ++i, s->pos += 3)
+        cl[pi_order[i]] = (uch)(pi_bits(s) & 7);
+    if (pi_build(&s->lit, cl, 19, TRUE))
+        return 1;
+    for (n = 0;  n < hlit + hdist;  ) {
+        v = pi_bits(s);
+        if ((sym = pi_decode(s, &s->lit, &v)) < 0)
+            return 1;
+        if (sym < 16) {
+            len[n++] = (uch)sym;
+            continue;
+        }
+        if (sym == 16) {        /* repeat the last length 3..6 times */
+            if (n == 0)
+                return 1;
+            fill = len[n - 1];
+            rep = 3 + (unsigned)(v & 3);
+            s->pos += 2;
+        } else {                /* zeros, 3..10 or 11..138 times */
+            fill = 0;
+            rep = (sym == 17)? 3 + (unsigned)(v & 7) : 11 + (unsigned)(v & 127);
+            s->pos += (sym == 17)? 3 : 7;
+        }
+        if (n + rep > hlit + hdist)
+            return 1;
+        while (rep--)
+            len[n++] = fill;
+    }
+    if (len[256] == 0 || s->pos > (s->inlen << 3))
+        return 1;               /* no end of block, or ran past the data */
+    if (pi_build(&s->lit, len, hlit, FALSE) ||
+        pi_build(&s->dist, len + hlit, hdist, FALSE))
+        return 1;
+    s->lcode = &s->lit;
+    s->dcode = &s->dist;
+    return 0;
+
+} /* end function pi_header() */
+
+
+
+/************************/
+/*  Function pi_grow()  */
+/************************/
+
+static int pi_grow(s)       /* return 1 if out cannot get any larger */
+    pistream *s;
+{
+    size_t size = s->outsize * 2;
+    ush *out;
+
+    if (s->outsize >= s->maxsize)
+        return 1;
+    if (size > s->maxsize)
+        size = s->maxsize;
+    if ((out = (ush *)realloc(s->out, size * sizeof(ush))) == (ush *)NULL)
+        return 1;
+    s->out = out;
+    s->outsize = size;
+    return 0;
+
+} /* end function pi_grow() */
+
+
+
+/************************/
+/*  Function pi_copy()  */
+/************************/
+
+static int pi_copy(s, len, dist)   /* return 1 if dist is too far back */
+    pistream *s;
+    unsigned len, dist;
+{
+    ush *to = s->out + s->outlen;
+    const ush *from;
+    zoff_t back;
+    unsigned k, w;
+
+    if (dist <= s->outlen) {
+        if (dist >= len)
+            memcpy(to, to - dist, len * sizeof(ush));
+        else
+            for (from = to - dist, k = 0;  k < len;  ++k)
+                to[k] = from[k];
+        s->outlen += len;
+        return 0;
+    }
+    /* (partly) from before the output:  the window, or placeholders */
+    for (k = 0;  k < len;  ++k) {
+        back = (zoff_t)(s->outlen + k) - (zoff_t)dist;
+        if (back >= 0)
+            to[k] = s->out[(size_t)back];
+        else {
+            w = (unsigned)(PI_WINDOW + back);
+            if (s->window == (uch *)NULL)
+                to[k] = (ush)(256 + w);
+            else if (w < PI_WINDOW - s->wlen)
+                return 1;
+            else
+                to[k] = s->window[w];
+        }
+    }
+    s->outlen += len;
+    return 0;
+
+} /* end function pi_copy() */
+
+
+
+/***********************/
+/*  Function pi_run()  */
+/***********************/
+
+static int pi_run(s, stopbit)   /* return PI_BOUNDARY, _FINAL, _FULL or _BAD */
+    pistream *s;
+    zoff_t stopbit;             /* stop at the first block header from here */
+{
+    zoff_t endbit = s->inlen << 3, fetched;
+    const uch *p;
+    unsigned len, dist, n, i, e;
+    z_uint8 v;
+    int sym;
+
+/*---------------------------------------------------------------------------
+    Inflate from s->pos on.  This stops between symbols when out is full,
+    and goes on from there when called again.
+  ---------------------------------------------------------------------------*/
+
+    for (;;) {
+        if (s->blocktype < 0) {
+            if (s->last)
+                return PI_FINAL;
+            if (s->pos >= stopbit || s->outlen >= s->stopout)
+                return PI_BOUNDARY;
+            if (pi_header(s) != 0)
+                return PI_BAD;
+        }
+
+        if (s->blocktype == 0) {
+            if (s->stored == 0) {
+                s->blocktype = -1;
+                continue;
+            }
+            if (s->outlen == s->outsize && pi_grow(s))
+                return PI_FULL;
+            n = (unsigned)MIN((size_t)s->stored, s->outsize - s->outlen);
+            if ((s->pos >> 3) + n > s->inlen)
+                return PI_BAD;
+            p = s->in + (size_t)(s->pos >> 3);
+            for (i = 0;  i < n;  ++i)
+                s->out[s->outlen++] = p[i];
+            s->pos += (zoff_t)n << 3;
+            s->stored -= n;
+            continue;
+        }
+
+        /* a block with Huffman codes:  the bits are fetched again only
+         * when there might not be enough left for the next code, or for
+         * the rest of a match (15 + 5 + 15 + 13 at the most) */
+        v = pi_bits(s);
+        fetched = s->pos;
+        for (;;) {
+            if (s->outsize - s->outlen < 258 && pi_grow(s))
+                return PI_FULL;
+            if (s->pos > endbit)
+                return PI_BAD;  /* ran past the data */
+            if (s->pos - fetched > PI_BITS - 15) {
+                v = pi_bits(s);
+                fetched = s->pos;
+            }
+            if ((e = s->lcode->fast[(unsigned)v & PI_FASTMASK]) != 0) {
+                s->pos += e & 15;
+                v >>= e & 15;
+                sym = (int)(e >> 4);
+            } else if ((sym = pi_decode(s, s->lcode, &v)) < 0)
+                return PI_BAD;
+            if (sym < 256) {
+                s->out[s->outlen++] = (ush)sym;
+                continue;
+            }
+            if (sym == 256)     /* end of block */
+                break;
+            if ((sym -= 257) >= 29)
+                return PI_BAD;
+            if (s->pos - fetched > PI_BITS - (5 + 15 + 13)) {
+                v = pi_bits(s);
+                fetched = s->pos;
+            }
+            len = pi_lbase[sym] + ((unsigned)v & ((1 << pi_lext[sym]) - 1));
+            s->pos += pi_lext[sym];
+            v >>= pi_lext[sym];
+            if ((e = s->dcode->fast[(unsigned)v & PI_FASTMASK]) != 0) {
+                s->pos += e & 15;
+                v >>= e & 15;
+                sym = (int)(e >> 4);
+            } else if ((sym = pi_decode(s, s->dcode, &v)) < 0)
+                return PI_BAD;
+            if (sym >= 30)
+                return PI_BAD;
+            dist = pi_dbase[sym] + ((unsigned)v & ((1 << pi_dext[sym]) - 1));
+            s->pos += pi_dext[sym];
+            v >>= pi_dext[sym];
+            if (pi_copy(s, len, dist))
+                return PI_BAD;
+        }
+        if (s->pos > endbit)
+            return PI_BAD;
+        s->blocktype = -1;
+    }
+
+} /* end function pi_run() */
+
+
+
+/*****************************/
+/*  Function pi_candidate()  */
+/*****************************/
+
+static int pi_candidate(s, p)   /* return 1 if a block seems to start at p */
+    pistream *s;
+    zoff_t p;
+{
+    zoff_t next;
+    z_uint8 v;
+
+/*---------------------------------------------------------------------------
+    Only dynamic blocks are looked for:  fixed and stored ones have too
+    little to them to tell them from noise.  A guess has to have a valid
+    header (all codes complete, an end-of-block code) and inflate up to its
+    end, and the block after it needs a valid header too.  The output of
+    that first block is kept in s->out, and s->pos is left at the next one.
+  ---------------------------------------------------------------------------*/
+
+    s->pos = p;
+    v = pi_bits(s);
+    if ((v & 7) != 4 || ((v >> 3) & 31) > 29 || ((v >> 8) & 31) > 29)
+        return 0;               /* not a dynamic block that is not the last */
+    s->blocktype = -1;
+    s->last = 0;
+    s->outlen = 0;
+    if (pi_run(s, p + 1) != PI_BOUNDARY)
+        return 0;
+    next = s->pos;
+    if (pi_header(s) != 0)
+        return 0;
+    s->pos = next;
+    s->blocktype = -1;
+    s->last = 0;
+    return 1;
+
+} /* end function pi_candidate() */
+
+
+
+/************************/
+/*  Function pi_part()  */
+/************************/
+
+static int pi_part(pool, pp)    /* return PP_DONE or PP_FAILED */
+    pipool *pool;
+    pipart *pp;
+{
+    pistream s;
+    zoff_t p;
+    int r;
+
+    s.in = pool->in;
+    s.inlen = pool->inlen;
+    s.fixed = pool->fixed;
+    s.window = (uch *)NULL;     /* the output before it is not known */
+    s.wlen = 0;
+    s.maxsize = MAX((size_t)((pp->end - pp->begin) >> 3) * PI_EXPAND,
+                    PI_OUTBUF);
+    s.outsize = s.maxsize / 4;
+    s.outlen = 0;
+    s.stopout = ~(size_t)0;
+    if ((s.out = (ush *)malloc(s.outsize * sizeof(ush))) == (ush *)NULL)
+        return PP_FAILED;
+
+    if (pp->begin == 0) {       /* the first part starts at the start */
+        s.pos = 0;
+        s.blocktype = -1;
+        s.last = 0;
+        p = 0;
+    } else {
+        /* (the search may take a while:  give up on it once all is over) */
+        for (p = pp->begin;  p < pp->end;  ++p)
+            if (__atomic_load_n(&pool->stop, __ATOMIC_RELAXED) ||
+                pi_candidate(&s, p))
+                break;
+        if (p >= pp->end || __atomic_load_n(&pool->stop, __ATOMIC_RELAXED)) {
+            free(s.out);
+            return PP_FAILED;
+        }
+    }
+    if ((r = pi_run(&s, pp->end)) != PI_BOUNDARY && r != PI_FINAL) {
+        free(s.out);
+        return PP_FAILED;
+    }
+    pp->start = p;
+    pp->stop = s.pos;
+    pp->final = (r == PI_FINAL);
+    pp->out = s.out;
+    pp->outlen = s.outlen;
+    return PP_DONE;
+
+} /* end function pi_part() */
+
+
+
+/**************************/
+/*  Function pi_worker()  */
+/**************************/
+
+static void *pi_worker(arg)
+    void *arg;
+{
+    pipool *pool = (pipool *)arg;
+    unsigned k;
+    int state;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->stop && pool->next < pool->nparts &&
+               pool->next >= pool->limit)
+            pthread_cond_wait(&pool->change, &pool->lock);
+        if (pool->stop || pool->next >= pool->nparts)
+            break;
+        k = pool->next++;
+        pool->part[k].state = PP_TAKEN;
+        pthread_mutex_unlock(&pool->lock);
+        state = pi_part(pool, &pool->part[k]);
+        pthread_mutex_lock(&pool->lock);
+        pool->part[k].state = state;
+        pthread_cond_broadcast(&pool->change);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+
+} /* end function pi_worker() */
+
+
+
+/************************/
+/*  Function pi_emit()  */
+/************************/
+
+static int pi_emit(pG, pool, out, n)   /* return PK error codes, or -1 */
+    Uz_Globs *pG;                       /* if out refers to before the */
+    pipool *pool;                       /* start of the data */
+    const ush *out;
+    size_t n;
+{
+    uch *b = pool->bytes;
+    unsigned v, lo = PI_WINDOW - pool->wlen;
+    size_t i, j, k, m, q, piece;
+    int r;
+
+    /* (text conversion has no room for more than WSIZE at once) */
+    piece = (*(Uz_Globs *)pG).pInfo->textmode ? WSIZE : PI_OUTBUF;
+    for (i = 0;  i < n;  i += k) {
+        k = MIN(n - i, piece);
+        for (j = 0;  j < k;  j += m) {
+            /* mostly there are no placeholders:  look for them a few at
+             * a time, and just narrow the values where there are none */
+            m = MIN(k - j, 64);
+            for (v = 0, q = 0;  q < m;  ++q)
+                v |= out[i + j + q];
+            if (v < 256) {
+                for (q = 0;  q < m;  ++q)
+                    b[j + q] = (uch)out[i + j + q];
+                continue;
+            }
+            for (q = 0;  q < m;  ++q) {
+                if ((v = out[i + j + q]) >= 256) {
+                    if ((v -= 256) < lo)
+                        return -1;
+                    v = pool->win[v];
+                }
+                b[j + q] = (uch)v;
+            }
+        }
+        if ((r = flush(pG, b, (ulg)k, 0)) != PK_OK)
+            return r;
+    }
+
+    /* the window for what comes next */
+    m = MIN(n, PI_WINDOW);
+    for (j = 0;  j < m;  ++j) {
+        v = out[n - m + j];
+        b[j] = (uch)((v >= 256)? pool->win[v - 256] : v);
+    }
+    memmove(pool->win, pool->win + m, PI_WINDOW - m);
+    memcpy(pool->win + (PI_WINDOW - m), b, m);
+    pool->wlen = (n >= PI_WINDOW - pool->wlen)? PI_WINDOW :
+                 pool->wlen + (unsigned)n;
+    return PK_OK;
+
+} /* end function pi_emit() */
+
+
+
+/**************************/
+/*  Function pi_stream()  */
+/**************************/
+
+static int pi_stream(pG, pool, s, stopbit, pfinal)   /* return PK error */
+    Uz_Globs *pG;                       /* codes, or -1 if the data are bad */
+    pipool *pool;
+    pistream *s;                /* s->pos:  a block boundary */
+    zoff_t stopbit;
+    int *pfinal;
+{
+    int r, e;
+
+    /* what the main thread inflates itself, with the window known */
+    s->blocktype = -1;
+    s->last = 0;
+    for (;;) {
+        s->outlen = 0;
+        s->wlen = pool->wlen;
+        if ((r = pi_run(s, stopbit)) == PI_BAD)
+            return -1;
+        if ((e = pi_emit(pG, pool, s->out, s->outlen)) != PK_OK)
+            return e;
+        if (r != PI_FULL) {
+            *pfinal = (r == PI_FINAL);
+            return PK_OK;
+        }
+    }
+
+} /* end function pi_stream() */
+
+
+
+/*************************/
+/*  Function pi_fixed()  */
+/*************************/
+
+static void pi_fixed(fixed)
+    pihuff *fixed;              /* [0] lengths, [1] distances */
+{
+    uch fixlen[288];
+    unsigned k;
+
+    for (k = 0;  k < 288;  ++k)
+        fixlen[k] = (uch)((k < 144)? 8 : (k < 256)? 9 : (k < 280)? 7 : 8);
+    pi_build(&fixed[0], fixlen, 288, TRUE);
+    memset(fixlen, 5, 32);      /* (30 and 31 are invalid, but have codes) */
+    pi_build(&fixed[1], fixlen, 32, TRUE);
+
+} /* end function pi_fixed() */
+
+
+
+/*************************/
+/*  Function pi_input()  */
+/*************************/
+
+static const uch *pi_input(pG, plen)   /* return the member's compressed */
+    Uz_Globs *pG;                       /* data in the zipfile mapping, or */
+    zoff_t *plen;                       /* NULL if they are not there as */
+{                                       /* they are */
+    zoff_t next;
+
+    /* the input buffer is set up as inflate() would find it:  incnt bytes
+     * at inptr, then csize more from the next unread zipfile byte on; with
+     * csize 0, the member ends in the buffer (defer_leftover_input() has
+     * cut incnt short), and the next zipfile byte is not the member's */
+    if ((*(Uz_Globs *)pG).pInfo->encrypted || (*(Uz_Globs *)pG).incnt < 0)
+        return (uch *)NULL;
+    *plen = (*(Uz_Globs *)pG).csize + (*(Uz_Globs *)pG).incnt;
+    if ((*(Uz_Globs *)pG).csize == 0)
+        return (*(Uz_Globs *)pG).inptr;
+    next = (*(Uz_Globs *)pG).cur_zipfile_bufstart + (*(Uz_Globs *)pG).inbuf_len;
+    if (!zipmap_covers(pG, next, (*(Uz_Globs *)pG).csize))
+        return (uch *)NULL;
+    return (*(Uz_Globs *)pG).zipmap + (size_t)(next - (*(Uz_Globs *)pG).incnt);
+
+} /* end function pi_input() */
+
+
+
+/************************/
+/*  Function pi_redo()  */
+/************************/
+
+static int pi_redo(pG)      /* return 1 if the output can be done over */
+    Uz_Globs *pG;
+{
+    z_stat st;
+
+    /* testing, or a new regular file */
+    if (uO.cflag || (*(Uz_Globs *)pG).mem_mode)
+        return 0;
+    return uO.tflag ||
+           (fflush((*(Uz_Globs *)pG).outfile) == 0 &&
+            fstat(fileno((*(Uz_Globs *)pG).outfile), &st) == 0 &&
+            S_ISREG(st.st_mode) && st.st_size == 0);
+
+} /* end function pi_redo() */
+
+
+
+/***************************/
+/*  Function pi_restart()  */
+/***************************/
+
+static int pi_restart(pG)   /* return -1 for inflate() to start over, */
+    Uz_Globs *pG;           /* or PK_DISK */
+{
+#ifdef USE_WRITEV
+    (*(Uz_Globs *)pG).wbuf_len = 0;       /* (not written yet:  dropped) */
+    if (!uO.tflag && drain_outfile(pG) != PK_OK)     /* (the writer's) */
+        return PK_DISK;
+#endif
+    if (!uO.tflag &&
+        (fflush((*(Uz_Globs *)pG).outfile) != 0 ||
+         ftruncate(fileno((*(Uz_Globs *)pG).outfile), (off_t)0) != 0 ||
+         zfseeko((*(Uz_Globs *)pG).outfile, (zoff_t)0, SEEK_SET) != 0))
+        return PK_DISK;
+    (*(Uz_Globs *)pG).crc32val = CRCVAL_INITIAL;
+    (*(Uz_Globs *)pG).newfile = TRUE;     /* (for flush()'s text mode) */
+#ifdef USE_SPARSE
+    (*(Uz_Globs *)pG).sparse_at = 0;      /* (and its -S block boundaries) */
+#endif
+    return -1;
+
+} /* end function pi_restart() */
+
+
+
+/****************************/
+/*  Function par_inflate()  */
+/****************************/
+
+int par_inflate(pG, is_defl64)  /* returns as inflate() does, or -1 to */
+    Uz_Globs *pG;               /* leave it to that */
+    int is_defl64;
+{
+    pipool pool;
+    pipart *pp;
+    pistream s;
+    pthread_t *tid;
+    sigset_t all, old;
+    const uch *in;
+    zoff_t len, pos = 0;
+    unsigned k, nthreads, nstarted, ahead;
+    long n = uO.w_threads;
+    int final = FALSE, r = PK_OK;
+
+/*---------------------------------------------------------------------------
+    Called instead of inflate() for a member, with the input buffer set up
+    as inflate() would find it.  Takes only members of at least -H bytes of
+    compressed data that are in the zipfile mapping as they are (not
+    encrypted), and only when the output can be done over again:  -t, or a
+    new regular file.  Not done for the members extract_parallel() hands
+    out, as those threads are busy already.  -w gives the number of threads
+    (one per CPU by default); the main thread takes a hand in as well.
+  ---------------------------------------------------------------------------*/
+
+    if (uO.H_size == 0 || is_defl64 || (*(Uz_Globs *)pG).msgsink != NULL ||
+        (in = pi_input(pG, &len)) == (uch *)NULL ||
+        len < (zoff_t)uO.H_size || len < 2 * PAR_INFLATE_CHUNK || !pi_redo(pG))
+        return -1;
+
+    if (n <= 0 && (n = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+        n = 1;
+    if (n > MAX_THREADS)
+        n = MAX_THREADS;
+    memzero(&pool, sizeof(pool));
+    pool.in = in;
+    pool.inlen = len;
+    pool.nparts = (unsigned)((len + PAR_INFLATE_CHUNK - 1) / PAR_INFLATE_CHUNK);
+    nthreads = ((zoff_t)n > (zoff_t)pool.nparts)? pool.nparts : (unsigned)n;
+    ahead = 2 * nthreads;
+    pool.limit = ahead;
+    s.maxsize = s.outsize = PI_OUTBUF;
+    s.stopout = ~(size_t)0;
+    pool.part = (pipart *)calloc(pool.nparts, sizeof(pipart));
+    tid = (pthread_t *)malloc(nthreads * sizeof(pthread_t));
+    pool.win = (uch *)malloc(PI_WINDOW);
+    pool.bytes = (uch *)malloc(PI_OUTBUF);
+    s.out = (ush *)malloc(PI_OUTBUF * sizeof(ush));
+    if (pool.part == (pipart *)NULL || tid == (pthread_t *)NULL ||
+        pool.win == (uch *)NULL || pool.bytes == (uch *)NULL ||
+        s.out == (ush *)NULL)
+    {
+        if (pool.part != (pipart *)NULL)
+            free((void *)pool.part);
+        if (tid != (pthread_t *)NULL)
+            free((void *)tid);
+        if (pool.win != (uch *)NULL)
+            free((void *)pool.win);
+        if (pool.bytes != (uch *)NULL)
+            free((void *)pool.bytes);
+        if (s.out != (ush *)NULL)
+            free((void *)s.out);
+        return -1;
+    }
+    for (k = 0;  k < pool.nparts;  ++k) {
+        pool.part[k].begin = ((zoff_t)k * PAR_INFLATE_CHUNK) << 3;
+        pool.part[k].end = (k == pool.nparts - 1)? len << 3 :
+                           ((zoff_t)(k + 1) * PAR_INFLATE_CHUNK) << 3;
+    }
+    pi_fixed(pool.fixed);
+    s.in = pool.in;
+    s.inlen = pool.inlen;
+    s.fixed = pool.fixed;
+    s.window = pool.win;
+
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.change, NULL);
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    for (nstarted = 0;  nstarted < nthreads;  ++nstarted)
+        if (pthread_create(&tid[nstarted], NULL, pi_worker, &pool) != 0)
+            break;
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+/*---------------------------------------------------------------------------
+    The parts in order:  the part's own output if it starts where the data
+    so far stop (inflating up to its start first, if it starts later),
+    else inflate on from there up to the end of the part.
+  ---------------------------------------------------------------------------*/
+
+    for (k = 0;  k < pool.nparts && !final && r == PK_OK;  ++k) {
+        pp = &pool.part[k];
+        pthread_mutex_lock(&pool.lock);
+        pool.limit = k + ahead;
+        pthread_cond_broadcast(&pool.change);
+        if (pp->state == PP_PENDING) {  /* no thread got to it:  do it here */
+            pool.next = k + 1;
+            pp->state = PP_FAILED;
+        }
+        while (pp->state == PP_TAKEN)
+            pthread_cond_wait(&pool.change, &pool.lock);
+        pthread_mutex_unlock(&pool.lock);
+
+        if (pp->state == PP_DONE && pp->start >= pos) {
+            if (pp->start > pos) {
+                s.pos = pos;
+                r = pi_stream(pG, &pool, &s, pp->start, &final);
+                pos = s.pos;
+            }
+            if (r == PK_OK && !final && pos == pp->start) {
+                r = pi_emit(pG, &pool, pp->out, pp->outlen);
+                pos = pp->stop;
+                final = pp->final;
+            }
+        }
+        if (r == PK_OK && !final && pos < pp->end) {
+            s.pos = pos;
+            r = pi_stream(pG, &pool, &s, pp->end, &final);
+            pos = s.pos;
+        }
+        if (pp->state == PP_DONE)
+            free((void *)pp->out);
+        pp->state = PP_FAILED;  /* (nothing to free any more) */
+    }
+    if (r == PK_OK && !final)
+        r = -1;                 /* no end to the data */
+
+    pthread_mutex_lock(&pool.lock);
+    __atomic_store_n(&pool.stop, TRUE, __ATOMIC_RELAXED);
+    pthread_cond_broadcast(&pool.change);
+    pthread_mutex_unlock(&pool.lock);
+    while (nstarted > 0)
+        pthread_join(tid[--nstarted], NULL);
+    for (k = 0;  k < pool.nparts;  ++k)
+        if (pool.part[k].state == PP_DONE)
+            free((void *)pool.part[k].out);
+    pthread_cond_destroy(&pool.change);
+    pthread_mutex_destroy(&pool.lock);
+    free((void *)pool.part);
+    free((void *)tid);
+    free((void *)pool.win);
+    free((void *)pool.bytes);
+    free((void *)s.out);
+
+    if (r < 0)      /* not to be done this way after all:  start over */
+        return pi_restart(pG);
+    if (r == PK_OK) {           /* all of the data used up */
+        (*(Uz_Globs *)pG).csize = 0;
+        (*(Uz_Globs *)pG).inptr += (*(Uz_Globs *)pG).incnt;
+        (*(Uz_Globs *)pG).incnt = 0;
+    }
+    return r;
+
+} /* end function par_inflate() */
+
+
+
+#ifdef USE_INFLATE_INDEX
+
+/*---------------------------------------------------------------------------
+    The checkpoint index (-k, -r), as zlib's zran example has it:  at the
+    first block boundary after every -k bytes of a deflated member's
+    output, where the compressed data are there (in bits) and the 32K of
+    output that come before.  Inflating from such a point on needs nothing
+    else.  The index of foo.zip is kept in foo.zip.zix, all numbers in it
+    little-endian:
+
+        "UZIX", version (2 bytes), 0 (2), size of the zipfile (8)
+        per member:  offset of its local header, compressed size,
+                     uncompressed size (8 bytes each), CRC, checkpoints (4)
+          per checkpoint:  output offset, bit offset (8 each), bytes of
+                           window, 0 (4 each)
+          the windows of the checkpoints, one after the other
+
+    Only the table is read in; a window is read when it is needed.
+  ---------------------------------------------------------------------------*/
+
+#define INDEX_SUFFIX  ".zix"
+#define PX_HEADER     16
+#define PX_MEMBER     32
+#define PX_CHECK      24
+
+typedef struct pxcheck {
+    zoff_t out;                 /* output before the checkpoint */
+    zoff_t bit;                 /* where its block starts */
+    unsigned wlen;              /* bytes of window (the last of that output): */
+    uch *window;                /*  here, */
+    zoff_t at;                  /*  or at that offset in the index file */
+} pxcheck;
+
+typedef struct pxmember {
+    struct pxmember *next;
+    zoff_t offset;              /* of its local header */
+    zusz_t csize, ucsize;
+    ulg crc;
+    unsigned count, max;        /* checkpoints, and room for them */
+    pxcheck *check;             /* in the order of out */
+} pxmember;
+
+typedef struct pxindex {
+    char *name;                 /* the zipfile's name + INDEX_SUFFIX */
+    FILE *file;                 /* the index read in, or NULL */
+    pxmember *member;
+    int changed;                /* to be written out */
+} pxindex;
+
+static const char IndexIgnored[] =
+  "warning:  %s is not an index of this zipfile; ignored\n";
+static const char IndexDamaged[] =
+  "warning:  %s is damaged; only part of it used\n";
+static const char IndexNotWritten[] =
+  "warning:  cannot write index %s\n";
+
+
+
+/***********************/
+/*  Function px_get()  */
+/***********************/
+
+static zusz_t px_get(p, n)  /* return the n-byte number at p */
+    const uch *p;
+    int n;
+{
+    zusz_t v = 0;
+
+    while (n-- > 0)
+        v = (v << 8) | p[n];
+    return v;
+
+} /* end function px_get() */
+
+
+
+/***********************/
+/*  Function px_put()  */
+/***********************/
+
+static void px_put(p, v, n)
+    uch *p;
+    zusz_t v;
+    int n;
+{
+    while (n-- > 0) {
+        *p++ = (uch)v;
+        v >>= 8;
+    }
+
+} /* end function px_put() */
+
+
+
+/************************/
+/*  Function px_drop()  */
+/************************/
+
+static void px_drop(m)
+    pxmember *m;
+{
+    unsigned k;
+
+    for (k = 0;  k < m->count;  ++k)
+        if (m->check[k].window != (uch *)NULL)
+            free((void *)m->check[k].window);
+    if (m->check != (pxcheck *)NULL)
+        free((void *)m->check);
+    free((void *)m);
+
+} /* end function px_drop() */
+
+
+
+/************************/
+/*  Function px_load()  */
+/************************/
+
+static pxindex *px_load(pG)     /* return the zipfile's index (without */
+    Uz_Globs *pG;               /* members if there is none), or NULL */
+{
+    pxindex *px = (pxindex *)(*(Uz_Globs *)pG).zindex;
+    pxmember *m, **last;
+    uch h[PX_MEMBER];
+    zoff_t at;
+    unsigned k;
+    FILE *f;
+
+    if (px != (pxindex *)NULL)  /* (read in once per zipfile) */
+        return px;
+    if ((px = (pxindex *)calloc(1, sizeof(pxindex))) == (pxindex *)NULL)
+        return (pxindex *)NULL;
+    if ((px->name = (char *)malloc(strlen((*(Uz_Globs *)pG).zipfn) +
+                                   sizeof(INDEX_SUFFIX))) == (char *)NULL) {
+        free((void *)px);
+        return (pxindex *)NULL;
+    }
+    strcpy(px->name, (*(Uz_Globs *)pG).zipfn);
+    strcat(px->name, INDEX_SUFFIX);
+    (*(Uz_Globs *)pG).zindex = (void *)px;
+
+    if ((f = fopen(px->name, FOPR)) == (FILE *)NULL)
+        return px;              /* none yet */
+    if (fread(h, 1, PX_HEADER, f) != PX_HEADER || memcmp(h, "UZIX", 4) != 0 ||
+        px_get(h + 4, 2) != 1 ||
+        (zoff_t)px_get(h + 8, 8) != (*(Uz_Globs *)pG).ziplen) {
+        /* (another zipfile's, or this one's from before it was changed) */
+        Info(slide, 0x401, ((char *)slide, LoadFarString(IndexIgnored),
+          FnFilter1(px->name)));
+        fclose(f);
+        return px;
+    }
+
+    at = PX_HEADER;
+    for (last = &px->member;  fread(h, 1, PX_MEMBER, f) == PX_MEMBER;
+         last = &m->next) {
+        if ((m = (pxmember *)calloc(1, sizeof(pxmember))) == (pxmember *)NULL)
+            break;
+        m->offset = (zoff_t)px_get(h, 8);
+        m->csize = px_get(h + 8, 8);
+        m->ucsize = px_get(h + 16, 8);
+        m->crc = (ulg)px_get(h + 24, 4);
+        m->max = (unsigned)px_get(h + 28, 4);
+        if (m->max == 0 || m->max > m->ucsize ||
+            (m->check = (pxcheck *)malloc(m->max * sizeof(pxcheck))) ==
+            (pxcheck *)NULL) {
+            free((void *)m);
+            break;
+        }
+        at += PX_MEMBER + (zoff_t)m->max * PX_CHECK;
+        for (k = 0;  k < m->max;  ++k, ++m->count) {
+            if (fread(h, 1, PX_CHECK, f) != PX_CHECK)
+                break;
+            m->check[k].out = (zoff_t)px_get(h, 8);
+            m->check[k].bit = (zoff_t)px_get(h + 8, 8);
+            m->check[k].wlen = (unsigned)px_get(h + 16, 4);
+            m->check[k].window = (uch *)NULL;
+            m->check[k].at = at;
+            at += m->check[k].wlen;
+            /* (nothing out of order, nor past the end of the member) */
+            if (m->check[k].out <= (k? m->check[k-1].out : 0) ||
+                (zusz_t)m->check[k].out > m->ucsize ||
+                m->check[k].bit <= (k? m->check[k-1].bit : 0) ||
+                (zusz_t)m->check[k].bit > (m->csize << 3) ||
+                m->check[k].wlen > PI_WINDOW ||
+                (zoff_t)m->check[k].wlen > m->check[k].out)
+                break;
+        }
+        if (m->count < m->max || zfseeko(f, at, SEEK_SET) != 0) {
+            px_drop(m);
+            break;
+        }
+        *last = m;
+    }
+    if (zfseeko(f, (zoff_t)0, SEEK_END) != 0 || zftello(f) != at)
+        Info(slide, 0x401, ((char *)slide, LoadFarString(IndexDamaged),
+          FnFilter1(px->name)));
+    px->file = f;               /* (for the windows) */
+    return px;
+
+} /* end function px_load() */
+
+
+
+/************************/
+/*  Function px_find()  */
+/************************/
+
+static pxmember *px_find(px, pG)    /* return the member's checkpoints, */
+    pxindex *px;                    /* or NULL if the index has none */
+    Uz_Globs *pG;
+{
+    pxmember *m;
+
+    for (m = px->member;  m != (pxmember *)NULL;  m = m->next)
+        if (m->offset == (*(Uz_Globs *)pG).pInfo->offset &&
+            m->csize == (*(Uz_Globs *)pG).pInfo->compr_size &&
+            m->ucsize == (*(Uz_Globs *)pG).pInfo->uncompr_size &&
+            m->crc == (*(Uz_Globs *)pG).pInfo->crc)
+            return m;
+    return (pxmember *)NULL;
+
+} /* end function px_find() */
+
+
+
+/**************************/
+/*  Function px_window()  */
+/**************************/
+
+static int px_window(px, c, win)    /* return 1 if it cannot be read */
+    pxindex *px;
+    const pxcheck *c;
+    uch *win;                       /* PI_WINDOW bytes:  c's at the end */
+{
+    win += PI_WINDOW - c->wlen;
+    if (c->window != (uch *)NULL) {
+        memcpy(win, c->window, c->wlen);
+        return 0;
+    }
+    return px->file == (FILE *)NULL ||
+           zfseeko(px->file, c->at, SEEK_SET) != 0 ||
+           fread(win, 1, c->wlen, px->file) != c->wlen;
+
+} /* end function px_window() */
+
+
+
+/*************************/
+/*  Function px_write()  */
+/*************************/
+
+static int px_write(px, pG)     /* return 1 if it could not be written */
+    pxindex *px;
+    Uz_Globs *pG;
+{
+    pxmember *m;
+    uch h[PX_MEMBER], *win;
+    char *tmp;
+    unsigned k;
+    FILE *f;
+    int bad = FALSE;
+
+    /* to a new file first:  the windows of the old one may be needed */
+    if ((tmp = (char *)malloc(strlen(px->name) + 2)) == (char *)NULL)
+        return 1;
+    strcpy(tmp, px->name);
+    strcat(tmp, "~");
+    if ((win = (uch *)malloc(PI_WINDOW)) == (uch *)NULL ||
+        (f = fopen(tmp, FOPW)) == (FILE *)NULL) {
+        if (win != (uch *)NULL)
+            free((void *)win);
+        free((void *)tmp);
+        return 1;
+    }
+    memcpy(h, "UZIX", 4);
+    px_put(h + 4, (zusz_t)1, 2);
+    px_put(h + 6, (zusz_t)0, 2);
+    px_put(h + 8, (zusz_t)(*(Uz_Globs *)pG).ziplen, 8);
+    bad = (fwrite(h, 1, PX_HEADER, f) != PX_HEADER);
+    for (m = px->member;  m != (pxmember *)NULL && !bad;  m = m->next) {
+        px_put(h, (zusz_t)m->offset, 8);
+        px_put(h + 8, m->csize, 8);
+        px_put(h + 16, m->ucsize, 8);
+        px_put(h + 24, (zusz_t)m->crc, 4);
+        px_put(h + 28, (zusz_t)m->count, 4);
+        bad = (fwrite(h, 1, PX_MEMBER, f) != PX_MEMBER);
+        for (k = 0;  k < m->count && !bad;  ++k) {
+            px_put(h, (zusz_t)m->check[k].out, 8);
+            px_put(h + 8, (zusz_t)m->check[k].bit, 8);
+            px_put(h + 16, (zusz_t)m->check[k].wlen, 4);
+            px_put(h + 20, (zusz_t)0, 4);
+            bad = (fwrite(h, 1, PX_CHECK, f) != PX_CHECK);
+        }
+        for (k = 0;  k < m->count && !bad;  ++k)
+            bad = (px_window(px, &m->check[k], win) ||
+                   fwrite(win + (PI_WINDOW - m->check[k].wlen), 1,
+                          m->check[k].wlen, f) != m->check[k].wlen);
+    }
+    if (fclose(f) != 0)
+        bad = TRUE;
+    if (bad || rename(tmp, px->name) != 0) {
+        unlink(tmp);
+        bad = TRUE;
+    }
+    free((void *)win);
+    free((void *)tmp);
+    return bad;
+
+} /* end function px_write() */
+
+
+
+/**************************/
+/*  Function index_end()  */
+/**************************/
+
+int index_end(pG)           /* return PK_OK, or PK_WARN if the index */
+    Uz_Globs *pG;           /* could not be written */
+{
+    pxindex *px = (pxindex *)(*(Uz_Globs *)pG).zindex;
+    pxmember *m;
+    int error = PK_OK;
+
+    /* at the end of a zipfile:  write out what -k found, and let go of it */
+    if (px == (pxindex *)NULL)
+        return PK_OK;
+    if (px->changed && px_write(px, pG)) {
+        Info(slide, 0x401, ((char *)slide, LoadFarString(IndexNotWritten),
+          FnFilter1(px->name)));
+        error = PK_WARN;
+    }
+    while ((m = px->member) != (pxmember *)NULL) {
+        px->member = m->next;
+        px_drop(m);
+    }
+    if (px->file != (FILE *)NULL)
+        fclose(px->file);
+    free((void *)px->name);
+    free((void *)px);
+    (*(Uz_Globs *)pG).zindex = NULL;
+    return error;
+
+} /* end function index_end() */
+
+
+
+/******************************/
+/*  Function index_inflate()  */
+/******************************/
+
+int index_inflate(pG, is_defl64)    /* returns as inflate() does, or -1 */
+    Uz_Globs *pG;                   /* to leave it to that */
+    int is_defl64;
+{
+    pipool pool;
+    pistream s;
+    pxmember *m, **pm;
+    pxcheck *c;
+    pxindex *px;
+    const uch *in;
+    zoff_t len, done = 0, next = (zoff_t)uO.k_size;
+    int r, e = PK_OK, nomem = FALSE;
+
+/*---------------------------------------------------------------------------
+    Called instead of inflate() for a member, as par_inflate() is.  With -k,
+    the members of more than that many bytes are inflated here, so that
+    there are checkpoints to be had; the output is done as always.  The
+    member goes into the index only if its CRC turns out to be right.
+  ---------------------------------------------------------------------------*/
+
+    if (uO.k_size == 0 || is_defl64 || (*(Uz_Globs *)pG).msgsink != NULL ||
+        (zusz_t)(*(Uz_Globs *)pG).lrec.ucsize <= (zusz_t)uO.k_size ||
+        (in = pi_input(pG, &len)) == (uch *)NULL || !pi_redo(pG))
+        return -1;
+
+    memzero(&pool, sizeof(pool));
+    pool.win = (uch *)malloc(PI_WINDOW);
+    pool.bytes = (uch *)malloc(PI_OUTBUF);
+    s.out = (ush *)malloc(PI_OUTBUF * sizeof(ush));
+    m = (pxmember *)calloc(1, sizeof(pxmember));
+    if (pool.win == (uch *)NULL || pool.bytes == (uch *)NULL ||
+        s.out == (ush *)NULL || m == (pxmember *)NULL)
+    {
+        if (pool.win != (uch *)NULL)
+            free((void *)pool.win);
+        if (pool.bytes != (uch *)NULL)
+            free((void *)pool.bytes);
+        if (s.out != (ush *)NULL)
+            free((void *)s.out);
+        if (m != (pxmember *)NULL)
+            free((void *)m);
+        return -1;
+    }
+    pi_fixed(pool.fixed);
+    s.in = in;
+    s.inlen = len;
+    s.fixed = pool.fixed;
+    s.window = pool.win;
+    s.maxsize = s.outsize = PI_OUTBUF;
+    s.pos = 0;
+    s.blocktype = -1;
+    s.last = 0;
+
+    /* a piece of output at a time, up to the next block boundary at that
+     * if the next checkpoint is due within it */
+    for (;;) {
+        s.outlen = 0;
+        s.wlen = pool.wlen;
+        s.stopout = (next - done < PI_OUTBUF)? (size_t)(next - done) :
+                    ~(size_t)0;
+        if ((r = pi_run(&s, (len << 3) + 1)) == PI_BAD) {
+            e = -1;
+            break;
+        }
+        if ((e = pi_emit(pG, &pool, s.out, s.outlen)) != PK_OK)
+            break;
+        done += (zoff_t)s.outlen;
+        if (r == PI_FINAL)
+            break;
+        if (r != PI_BOUNDARY || nomem)
+            continue;
+        if (m->count == m->max) {
+            m->max = m->max? 2 * m->max : 64;
+            if ((c = (pxcheck *)realloc(m->check, m->max * sizeof(pxcheck)))
+                == (pxcheck *)NULL) {
+                nomem = TRUE;
+                continue;
+            }
+            m->check = c;
+        }
+        c = &m->check[m->count];
+        c->out = done;
+        c->bit = s.pos;
+        c->wlen = pool.wlen;
+        c->at = 0;
+        if ((c->window = (uch *)malloc(c->wlen)) == (uch *)NULL) {
+            nomem = TRUE;
+            continue;
+        }
+        memcpy(c->window, pool.win + (PI_WINDOW - c->wlen), c->wlen);
+        ++m->count;
+        next = done + (zoff_t)uO.k_size;
+    }
+    free((void *)pool.win);
+    free((void *)pool.bytes);
+    free((void *)s.out);
+
+    if (e < 0) {                /* not to be done this way after all */
+        px_drop(m);
+        return pi_restart(pG);
+    }
+    if (e == PK_OK) {           /* all of the data used up */
+        (*(Uz_Globs *)pG).csize = 0;
+        (*(Uz_Globs *)pG).inptr += (*(Uz_Globs *)pG).incnt;
+        (*(Uz_Globs *)pG).incnt = 0;
+        if (!nomem && m->count > 0 &&
+            (*(Uz_Globs *)pG).crc32val == (*(Uz_Globs *)pG).lrec.crc32 &&
+            (px = px_load(pG)) != (pxindex *)NULL)
+        {
+            m->offset = (*(Uz_Globs *)pG).pInfo->offset;
+            m->csize = (*(Uz_Globs *)pG).pInfo->compr_size;
+            m->ucsize = (*(Uz_Globs *)pG).pInfo->uncompr_size;
+            m->crc = (*(Uz_Globs *)pG).pInfo->crc;
+            /* in place of what the index had for it */
+            for (pm = &px->member;  *pm != (pxmember *)NULL;
+                 pm = &(*pm)->next)
+                if ((*pm)->offset == m->offset) {
+                    m->next = (*pm)->next;
+                    px_drop(*pm);
+                    break;
+                }
+            *pm = m;
+            px->changed = TRUE;
+            return PK_OK;
+        }
+    }
+    px_drop(m);
+    return e;
+
+} /* end function index_inflate() */
+
+
+
+/*****************************/
+/*  Function range_member()  */
+/*****************************/
+
+int range_member(pG)        /* returns as inflate() does, or -1 to leave */
+    Uz_Globs *pG;           /* the member to the usual way */
+{
+    pipool pool;
+    pistream s;
+    pxindex *px;
+    pxmember *m;
+    const uch *in;
+    zoff_t len, n, k;
+    unsigned i;
+    int r, e = PK_OK;
+
+/*---------------------------------------------------------------------------
+    With -r, for a STORED or deflated member:  only the data in the range
+    go to flush(), and no more of the member is inflated than it takes to
+    get to its end, starting from the last checkpoint before it that the
+    index has (or from the start).  flush() does the rest, as for any
+    member, and there is no CRC to check.
+  ---------------------------------------------------------------------------*/
+
+    if (!uO.r_flag || ((*(Uz_Globs *)pG).lrec.compression_method != STORED &&
+                       (*(Uz_Globs *)pG).lrec.compression_method != DEFLATED) ||
+        (in = pi_input(pG, &len)) == (uch *)NULL)
+        return -1;
+
+    if ((*(Uz_Globs *)pG).lrec.compression_method == STORED) {
+        if (uO.r_first < (ulg)len) {
+            n = (uO.r_last < (ulg)len)? (zoff_t)(uO.r_last - uO.r_first) + 1 :
+                len - (zoff_t)uO.r_first;
+            (*(Uz_Globs *)pG).range_at = (zoff_t)uO.r_first;
+            /* (text conversion has no room for more than WSIZE at once) */
+            k = (*(Uz_Globs *)pG).pInfo->textmode ? WSIZE : PI_OUTBUF;
+            for (in += uO.r_first;  n > 0 && e == PK_OK;  in += k, n -= k) {
+                if (k > n)
+                    k = n;
+                e = flush(pG, (uch *)in, (ulg)k, 0);
+            }
+        }
+    } else {
+        memzero(&pool, sizeof(pool));
+        pool.win = (uch *)malloc(PI_WINDOW);
+        pool.bytes = (uch *)malloc(PI_OUTBUF);
+        s.out = (ush *)malloc(PI_OUTBUF * sizeof(ush));
+        if (pool.win == (uch *)NULL || pool.bytes == (uch *)NULL ||
+            s.out == (ush *)NULL)
+        {
+            if (pool.win != (uch *)NULL)
+                free((void *)pool.win);
+            if (pool.bytes != (uch *)NULL)
+                free((void *)pool.bytes);
+            if (s.out != (ush *)NULL)
+                free((void *)s.out);
+            return -1;
+        }
+        pi_fixed(pool.fixed);
+        s.in = in;
+        s.inlen = len;
+        s.fixed = pool.fixed;
+        s.window = pool.win;
+        s.maxsize = s.outsize = PI_OUTBUF;
+        s.stopout = ~(size_t)0;
+        s.pos = 0;
+        s.blocktype = -1;
+        s.last = 0;
+        (*(Uz_Globs *)pG).range_at = 0;
+        if ((px = px_load(pG)) != (pxindex *)NULL &&
+            (m = px_find(px, pG)) != (pxmember *)NULL) {
+            for (i = m->count;  i > 0;  --i)
+                if ((ulg)m->check[i-1].out <= uO.r_first)
+                    break;
+            if (i > 0 && !px_window(px, &m->check[i-1], pool.win)) {
+                s.pos = m->check[i-1].bit;
+                pool.wlen = m->check[i-1].wlen;
+                (*(Uz_Globs *)pG).range_at = m->check[i-1].out;
+            }
+        }
+        do {
+            s.outlen = 0;
+            s.wlen = pool.wlen;
+            if ((r = pi_run(&s, (len << 3) + 1)) == PI_BAD) {
+                e = -1;
+                break;
+            }
+            e = pi_emit(pG, &pool, s.out, s.outlen);
+        } while (e == PK_OK && r != PI_FINAL &&
+                 (ulg)(*(Uz_Globs *)pG).range_at <= uO.r_last);
+        free((void *)pool.win);
+        free((void *)pool.bytes);
+        free((void *)s.out);
+
+        if (e < 0) {
+            if ((ulg)(*(Uz_Globs *)pG).range_at > uO.r_first)
+                return 2;       /* bad data, after part of the range */
+            /* none of it output yet:  inflate() can say what is wrong */
+            (*(Uz_Globs *)pG).range_at = 0;
+            (*(Uz_Globs *)pG).crc32val = CRCVAL_INITIAL;
+            (*(Uz_Globs *)pG).newfile = TRUE;
+            return -1;
+        }
+    }
+    (*(Uz_Globs *)pG).range_part = TRUE;
+    if (e == PK_OK) {           /* (what is left of it is of no interest) */
+        (*(Uz_Globs *)pG).csize = 0;
+        (*(Uz_Globs *)pG).inptr += (*(Uz_Globs *)pG).incnt;
+        (*(Uz_Globs *)pG).incnt = 0;
+    }
+    return e;
+
+} /* end function range_member() */
+
+#endif /* USE_INFLATE_INDEX */
+
+#endif /* USE_PAR_INFLATE */
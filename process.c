@@ -221,7 +221,11 @@ process_zipfiles (    /* return PK-type error code */
     strings.
   ---------------------------------------------------------------------------*/
 
-    (*(Uz_Globs *)pG).inbuf = (uch *)malloc(INBUFSIZ + 4);    /* 4 extra for hold[] (below) */
+    /* room for the largest read we may want to do (see set_inbufsiz()); a
+     * larger -I size is only allocated by open_input_file() if it is needed */
+    (*(Uz_Globs *)pG).inbuf_max = (uO.I_bufsiz ? uO.I_bufsiz : STRMINBUFSIZ);
+    (*(Uz_Globs *)pG).inbuf_memsiz = MIN((*(Uz_Globs *)pG).inbuf_max, STRMINBUFSIZ);
+    (*(Uz_Globs *)pG).inbuf = (uch *)malloc((*(Uz_Globs *)pG).inbuf_memsiz + 4);    /* 4 extra for hold[] (below) */
     (*(Uz_Globs *)pG).outbuf = (uch *)malloc(OUTBUFSIZ + 1);  /* 1 extra for string term. */
 
     if (((*(Uz_Globs *)pG).inbuf == (uch *)NULL) || ((*(Uz_Globs *)pG).outbuf == (uch *)NULL)) {
@@ -229,7 +233,9 @@ process_zipfiles (    /* return PK-type error code */
           LoadFarString(CannotAllocateBuffers)));
         return(PK_MEM);
     }
+    (*(Uz_Globs *)pG).inbuf_mem = (*(Uz_Globs *)pG).inbuf;
     (*(Uz_Globs *)pG).hold = (*(Uz_Globs *)pG).inbuf + INBUFSIZ;     /* to check for boundary-spanning sigs */
+    set_inbufsiz(pG, (zusz_t)0);
 
 #if 0 /* CRC_32_TAB has been NULLified by CONSTRUCTGLOBALS !!!! */
     /* allocate the CRC table later when we know we can read zipfile data */
@@ -527,9 +533,26 @@ free_G_buffers (     /* releases all memory allocated in global vars */
 
     if ((*(Uz_Globs *)pG).outbuf)
         free((*(Uz_Globs *)pG).outbuf);
-    if ((*(Uz_Globs *)pG).inbuf)
-        free((*(Uz_Globs *)pG).inbuf);
+#ifdef USE_WRITEV
+#  ifdef USE_ASYNC_WRITE
+    free_writer(pG);
+#  endif
+    if ((*(Uz_Globs *)pG).wbuf) {
+        free((*(Uz_Globs *)pG).wbuf);
+        (*(Uz_Globs *)pG).wbuf = (uch *)NULL;
+        (*(Uz_Globs *)pG).wbuf_size = 0;
+    }
+#endif
+#ifdef USE_PREFETCH
+    prefetch_free(pG);
+#endif
+#ifdef USE_IO_URING
+    free_readahead(pG);
+#endif
+    if ((*(Uz_Globs *)pG).inbuf_mem)
+        free((*(Uz_Globs *)pG).inbuf_mem);
     (*(Uz_Globs *)pG).inbuf = (*(Uz_Globs *)pG).outbuf = (uch *)NULL;
+    (*(Uz_Globs *)pG).inbuf_mem = (uch *)NULL;
 
 #ifdef UNICODE_SUPPORT
     if ((*(Uz_Globs *)pG).filename_full) {
@@ -539,12 +562,17 @@ free_G_buffers (     /* releases all memory allocated in global vars */
     }
 #endif /* UNICODE_SUPPORT */
 
-    for (i = 0; i < DIR_BLKSIZ; i++) {
+    for (i = 0; i < (*(Uz_Globs *)pG).info_max; i++) {
         if ((*(Uz_Globs *)pG).info[i].cfilname != (char *)NULL) {
             free((*(Uz_Globs *)pG).info[i].cfilname);
             (*(Uz_Globs *)pG).info[i].cfilname = (char *)NULL;
         }
     }
+    if ((*(Uz_Globs *)pG).info) {
+        free((*(Uz_Globs *)pG).info);
+        (*(Uz_Globs *)pG).info = (min_info *)NULL;
+        (*(Uz_Globs *)pG).info_max = 0;
+    }
 
 #ifdef MALLOC_WORK
     if ((*(Uz_Globs *)pG).area.Slide) {
@@ -650,6 +678,7 @@ do_seekable (        /* return PK-type error code */
   ---------------------------------------------------------------------------*/
 
     (*(Uz_Globs *)pG).cur_zipfile_bufstart = 0;
+    (*(Uz_Globs *)pG).inbuf_len = 0;
     (*(Uz_Globs *)pG).inptr = (*(Uz_Globs *)pG).inbuf;
 
 #if ((!defined(WINDLL) ) || !defined(NO_ZIPINFO))
@@ -873,6 +902,10 @@ do_seekable (        /* return PK-type error code */
 
         if (error > error_in_archive)   /* don't overwrite stronger error */
             error_in_archive = error;   /*  with (for example) a warning */
+#ifdef USE_INFLATE_INDEX
+        if ((error = index_end(pG)) > error_in_archive)   /* -k:  write it */
+            error_in_archive = error;
+#endif
     } /* end if (!too_weird_to_continue) */
 
     CLOSE_INFILE();
@@ -975,10 +1008,8 @@ static int rec_find(pG, searchlen, signature, rec_size)
   ---------------------------------------------------------------------------*/
 
     if ((tail_len = (*(Uz_Globs *)pG).ziplen % INBUFSIZ) > rec_size) {
-        zfseeko((*(Uz_Globs *)pG).zipfd, (*(Uz_Globs *)pG).ziplen-tail_len, SEEK_SET);
-        (*(Uz_Globs *)pG).cur_zipfile_bufstart = zftello((*(Uz_Globs *)pG).zipfd);
-        if (((*(Uz_Globs *)pG).incnt = read((*(Uz_Globs *)pG).zipfd, (char *)(*(Uz_Globs *)pG).inbuf,
-            (unsigned int)tail_len)) != (int)tail_len)
+        if (fill_inbuf_at(pG, (*(Uz_Globs *)pG).ziplen-tail_len,
+            (unsigned int)tail_len) != (int)tail_len)
             return 2;      /* it's expedient... */
 
         /* 'P' must be at least (rec_size+4) bytes from end of zipfile */
@@ -1007,10 +1038,8 @@ static int rec_find(pG, searchlen, signature, rec_size)
     /*               ==amount=   ==done==   ==rounding==    =blksiz=  */
 
     for (i = 1;  !found && (i <= numblks);  ++i) {
-        (*(Uz_Globs *)pG).cur_zipfile_bufstart -= INBUFSIZ;
-        zfseeko((*(Uz_Globs *)pG).zipfd, (*(Uz_Globs *)pG).cur_zipfile_bufstart, SEEK_SET);
-        if (((*(Uz_Globs *)pG).incnt = read((*(Uz_Globs *)pG).zipfd,(char *)(*(Uz_Globs *)pG).inbuf,INBUFSIZ))
-            != INBUFSIZ)
+        if (fill_inbuf_at(pG, (*(Uz_Globs *)pG).cur_zipfile_bufstart - INBUFSIZ,
+            INBUFSIZ) != INBUFSIZ)
             return 2;          /* read error is fatal failure */
 
         for ((*(Uz_Globs *)pG).inptr = (*(Uz_Globs *)pG).inbuf+INBUFSIZ-1;  (*(Uz_Globs *)pG).inptr >= (*(Uz_Globs *)pG).inbuf; --(*(Uz_Globs *)pG).inptr)
@@ -1059,10 +1088,8 @@ static int find_ecrec64(pG, searchlen)         /* return PK-class error */
       /* Seeking would go past beginning, so probably empty archive */
       return PK_COOL;
 
-    zfseeko((*(Uz_Globs *)pG).zipfd, ecloc64_start_offset, SEEK_SET);
-    (*(Uz_Globs *)pG).cur_zipfile_bufstart = zftello((*(Uz_Globs *)pG).zipfd);
-
-    if (((*(Uz_Globs *)pG).incnt = read((*(Uz_Globs *)pG).zipfd, (char *)byterecL, ECLOC64_SIZE+4))
+    /* (positional reads:  the input buffer state is left alone) */
+    if (zipf_pread(pG, byterecL, ECLOC64_SIZE+4, ecloc64_start_offset)
         != (ECLOC64_SIZE+4)) {
       if (uO.qflag || uO.zipinfo_mode)
           Info(slide, 0x401, ((char *)slide, "[%s]\n", (*(Uz_Globs *)pG).zipfn));
@@ -1122,10 +1149,7 @@ static int find_ecrec64(pG, searchlen)         /* return PK-class error */
       return PK_ERR;
     }
 
-    zfseeko((*(Uz_Globs *)pG).zipfd, ecrec64_start_offset, SEEK_SET);
-    (*(Uz_Globs *)pG).cur_zipfile_bufstart = zftello((*(Uz_Globs *)pG).zipfd);
-
-    if (((*(Uz_Globs *)pG).incnt = read((*(Uz_Globs *)pG).zipfd, (char *)byterec, ECREC64_SIZE+4))
+    if (zipf_pread(pG, byterec, ECREC64_SIZE+4, (zoff_t)ecrec64_start_offset)
         != (ECREC64_SIZE+4)) {
       if (uO.qflag || uO.zipinfo_mode)
           Info(slide, 0x401, ((char *)slide, "[%s]\n", (*(Uz_Globs *)pG).zipfn));
@@ -1143,10 +1167,7 @@ static int find_ecrec64(pG, searchlen)         /* return PK-class error */
       /* Make a guess as to where the Zip64 EOCD Record might be */
       ecrec64_start_offset = ecloc64_start_offset - ECREC64_SIZE - 4;
 
-      zfseeko((*(Uz_Globs *)pG).zipfd, ecrec64_start_offset, SEEK_SET);
-      (*(Uz_Globs *)pG).cur_zipfile_bufstart = zftello((*(Uz_Globs *)pG).zipfd);
-
-      if (((*(Uz_Globs *)pG).incnt = read((*(Uz_Globs *)pG).zipfd, (char *)byterec, ECREC64_SIZE+4))
+      if (zipf_pread(pG, byterec, ECREC64_SIZE+4, (zoff_t)ecrec64_start_offset)
           != (ECREC64_SIZE+4)) {
         if (uO.qflag || uO.zipinfo_mode)
             Info(slide, 0x401, ((char *)slide, "[%s]\n", (*(Uz_Globs *)pG).zipfn));
@@ -1262,8 +1283,7 @@ static int find_ecrec(pG, searchlen)          /* return PK-class error */
   ---------------------------------------------------------------------------*/
 
     if ((*(Uz_Globs *)pG).ziplen <= INBUFSIZ) {
-        zfseeko((*(Uz_Globs *)pG).zipfd, 0L, SEEK_SET);
-        if (((*(Uz_Globs *)pG).incnt = read((*(Uz_Globs *)pG).zipfd,(char *)(*(Uz_Globs *)pG).inbuf,(unsigned int)(*(Uz_Globs *)pG).ziplen))
+        if (fill_inbuf_at(pG, 0L, (unsigned int)(*(Uz_Globs *)pG).ziplen)
             == (int)(*(Uz_Globs *)pG).ziplen)
 
             /* 'P' must be at least (ECREC_SIZE+4) bytes from end of zipfile */
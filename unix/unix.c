@@ -784,7 +784,12 @@ int checkdir(pG, pathcomp, flag)
                 /* no room for filenames:  fatal */
                 return MPN_ERR_TOOLONG;
             }
-            if (mkdir((*(Uz_Globs *)pG).buildpath, 0777) == -1) {   /* create the directory */
+            if (mkdir((*(Uz_Globs *)pG).buildpath, 0777) == -1 &&
+                /* another extraction thread (-w) may just have made it */
+                (errno != EEXIST ||
+                 SSTAT((*(Uz_Globs *)pG).buildpath, &(*(Uz_Globs *)pG).statbuf) ||
+                 !S_ISDIR((*(Uz_Globs *)pG).statbuf.st_mode)))
+            {
                 Info(slide, 1, ((char *)slide,
                   "checkdir error:  cannot create %s\n\
                  %s\n\
@@ -177,6 +177,175 @@ typedef struct stat z_stat;
 #  define RESTORE_UIDGID
 #endif /* ?MTS */
 
+/* read seekable zipfiles through a read-only mmap() instead of read() */
+#if (!defined(NO_MMAP_INPUT) && !defined(USE_MMAP_INPUT))
+#  define USE_MMAP_INPUT
+#endif
+#ifdef USE_MMAP_INPUT
+#  include <sys/mman.h>
+#  ifndef MMAP_INPUT_MAX        /* default; UNZIP_MAPMAX=size overrides */
+#    define MMAP_INPUT_MAX (1L << 30)   /* larger ones are read ahead */
+#  endif
+#endif
+
+/* fetch zipfile data with positional pread() rather than lseek()+read() */
+#if (!defined(NO_PREAD) && !defined(USE_PREAD))
+#  define USE_PREAD
+#endif
+#ifdef USE_PREAD
+#  include <unistd.h>
+#endif
+
+/* prefetch member data in a background thread (see prefetch_member()) */
+#if (!defined(NO_PREFETCH) && !defined(USE_PREFETCH) && defined(USE_PREAD))
+#  define USE_PREFETCH
+#endif
+#ifdef USE_PREFETCH
+#  include <pthread.h>
+#  include <signal.h>
+#endif
+
+/* read upcoming members ahead through io_uring (see queue_readahead()) */
+#if (defined(__linux__) && defined(__GNUC__) && !defined(NO_IO_URING))
+#  if (!defined(USE_IO_URING) && defined(__has_include))
+#    if __has_include(<linux/io_uring.h>)
+#      define USE_IO_URING
+#    endif
+#  endif
+#endif
+#ifdef USE_IO_URING
+#  include <linux/io_uring.h>
+#  include <sys/syscall.h>
+#  include <sys/uio.h>
+#  include <sys/mman.h>
+#endif
+
+/* let the kernel copy STORED members into the output (see copy_zipdata()) */
+#if (defined(__linux__) && !defined(NO_COPY_RANGE) && !defined(USE_COPY_RANGE))
+#  define USE_COPY_RANGE
+#endif
+#ifdef USE_COPY_RANGE
+#  include <sys/ioctl.h>
+#  include <linux/fs.h>         /* FICLONERANGE, if there is such a thing */
+#  include <sys/sendfile.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#endif
+
+/* reserve the blocks of large output files up front (see prealloc_outfile());
+ * only with FALLOC_FL_KEEP_SIZE, which leaves the size alone, and called
+ * through syscall() as there is no _GNU_SOURCE for fallocate() */
+#if (defined(__linux__) && defined(__LP64__) && !defined(NO_PREALLOC))
+#  if (!defined(USE_PREALLOC) && defined(__has_include))
+#    if __has_include(<linux/falloc.h>)
+#      define USE_PREALLOC
+#    endif
+#  endif
+#endif
+#ifdef USE_PREALLOC
+#  include <linux/falloc.h>     /* FALLOC_FL_KEEP_SIZE */
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#  ifndef PREALLOC_MIN          /* smaller files are not worth the call */
+#    define PREALLOC_MIN (1L << 20)
+#  endif
+#endif
+
+/* -S:  seek over all-zero blocks of the output instead of writing them, so
+ * that they become holes (see write_sparse()); needs write() to the file
+ * descriptor, not fwrite() */
+#if (!defined(NO_SPARSE) && !defined(USE_SPARSE) && !defined(USE_FWRITE))
+#  define USE_SPARSE
+#endif
+#ifdef USE_SPARSE
+#  include <unistd.h>           /* lseek(), ftruncate() */
+#  ifndef SPARSE_BLOCK          /* hole size if st_blksize is no use */
+#    define SPARSE_BLOCK 4096
+#  endif
+#endif
+
+/* gather the output of each file in a large buffer, written out together
+ * with pieces too big to copy by writev() (see write_outbuf()) */
+#if (!defined(NO_WRITEV) && !defined(USE_WRITEV) && !defined(USE_FWRITE))
+#  define USE_WRITEV
+#endif
+#ifdef USE_WRITEV
+#  include <sys/uio.h>
+#  include <unistd.h>
+#  ifndef WRITE_BUFSIZE         /* default; UNZIP_WRITEBUF=size overrides */
+#    define WRITE_BUFSIZE (4L << 20)
+#  endif
+#  define WRITE_BUFMIN (1L << 20)
+#  define WRITE_BUFMAX (8L << 20)
+#endif
+
+/* ...and have a thread write them, while the next one is being filled (see
+ * queue_outbuf()) */
+#if (defined(USE_WRITEV) && !defined(NO_ASYNC_WRITE) && !defined(USE_ASYNC_WRITE))
+#  define USE_ASYNC_WRITE
+#endif
+#ifdef USE_ASYNC_WRITE
+#  include <pthread.h>
+#  include <signal.h>
+#  ifndef WRITE_BUFS            /* buffers in the writer's ring */
+#    define WRITE_BUFS 3
+#  endif
+#endif
+
+/* inflate large members straight into a mapping of the output file, which
+ * serves as the window (see map_outfile()) */
+#if (!defined(NO_MMAP_OUTPUT) && !defined(USE_MMAP_OUTPUT))
+#  if (!defined(DLL) && !defined(FUNZIP) && !defined(USE_ZLIB))
+#    define USE_MMAP_OUTPUT
+#  endif
+#endif
+#ifdef USE_MMAP_OUTPUT
+#  include <sys/mman.h>
+   /* the blocks are reserved by fallocate() itself:  glibc's emulation of
+    * posix_fallocate() would write them all full of zeros instead (on
+    * 32-bit Linux, where its arguments are split, the mapping is left be) */
+#  if (defined(__linux__) && defined(__LP64__))
+#    include <sys/syscall.h>
+#    include <unistd.h>
+#    define RESERVE_OUTFILE(fd, len) \
+       syscall(__NR_fallocate, (fd), 0, (off_t)0, (off_t)(len))
+#  else
+#    ifdef __linux__
+#      define RESERVE_OUTFILE(fd, len) (-1)
+#    else
+#      include <fcntl.h>        /* posix_fallocate() */
+#      define RESERVE_OUTFILE(fd, len) posix_fallocate((fd), (off_t)0, \
+                                                       (off_t)(len))
+#    endif
+#  endif
+#  ifndef MMAP_OUTPUT_MIN       /* smaller members are not worth mapping */
+#    define MMAP_OUTPUT_MIN (1L << 20)
+#  endif
+#endif
+
+/* extract independent members on several threads (see extract_parallel()) */
+#if (!defined(NO_PARALLEL) && !defined(USE_PARALLEL))
+#  define USE_PARALLEL
+#endif
+#ifdef USE_PARALLEL
+#  include <pthread.h>
+#  include <signal.h>
+#endif
+
+/* inflate one large member on several threads (-H, see parinfl.c) */
+#if (!defined(NO_PAR_INFLATE) && !defined(USE_PAR_INFLATE))
+#  if (defined(USE_PARALLEL) && defined(USE_MMAP_INPUT) && !defined(FUNZIP))
+#    define USE_PAR_INFLATE
+#  endif
+#endif
+
+/* checkpoint index for random access into deflated members (-k, -r) */
+#if (!defined(NO_INFLATE_INDEX) && !defined(USE_INFLATE_INDEX))
+#  ifdef USE_PAR_INFLATE        /* (its inflate starts at any block) */
+#    define USE_INFLATE_INDEX
+#  endif
+#endif
+
 /* Static variables that we have to add to Uz_Globs: */
 #define SYSTEM_SPECIFIC_GLOBALS \
     int created_dir, renamed_fullpath;\
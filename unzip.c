@@ -81,6 +81,11 @@
 /*******************/
 
 static void  help_extended      ();
+static int   scan_size          (char *arg, char **pend, ulg *pval);
+static int   get_sizearg        (int *pargc, char ***pargv, char **ps,
+                                 ulg *pval);
+static int   get_rangearg       (int *pargc, char ***pargv, char **ps,
+                                 ulg *pfirst, ulg *plast);
 static void  show_version_info  (Uz_Globs *pG);
 
 
@@ -109,6 +114,16 @@ static void  show_version_info  (Uz_Globs *pG);
      "error:  must specify directory to which to extract with -d option\n";
    static const char OnlyOneExdir[] =
      "error:  -d option used more than once (only one exdir allowed)\n";
+   static const char MustGiveBufSize[] =
+     "error:  must specify a read size (%lu..%lu, k/m suffix ok) with -I\n";
+   static const char MustGiveThreads[] =
+     "error:  must specify a number of threads (0..%u, 0 = one per CPU) with -w\n";
+   static const char MustGiveSplitSize[] =
+     "error:  must specify a compressed size (k/m/g suffix ok) with -H\n";
+   static const char MustGiveSpacing[] =
+     "error:  must specify a checkpoint spacing (k/m/g suffix ok) with -k\n";
+   static const char MustGiveRange[] =
+     "error:  must specify a byte range (first-last or first-) with -r\n";
 #if (defined(UNICODE_SUPPORT) && !defined(UNICODE_WCHAR))
   static const char UTF8EscapeUnSupp[] =
     "warning:  -U \"escape all non-ASCII UTF-8 chars\" is not supported\n";
@@ -378,6 +393,18 @@ static const char ZipInfoUsageLine3[] = "miscellaneous options:\n\
      static const char UseZlib[] =
      "USE_ZLIB (compiled with version %s; using version %s)";
 #  endif
+#  ifdef EXT_INFLATE
+     static const char ExtInflate[] =
+     "EXT_INFLATE (inflating by %s; UNZIP_INFLATE=builtin to not)";
+#  endif
+#  ifdef USE_PREALLOC
+     static const char UsePrealloc[] =
+     "USE_PREALLOC (large files reserved up front; UNZIP_PREALLOC=no to not)";
+#  endif
+#  ifdef USE_WRITEV
+     static const char UseWritev[] =
+     "USE_WRITEV (files written %lu KB at a time; UNZIP_WRITEBUF=size to change)";
+#  endif
 #  ifdef USE_BZIP2
      static const char UseBZip2[] =
      "USE_BZIP2 (PKZIP 4.6+, using bzip2 lib version %s)";
@@ -574,8 +601,8 @@ unzip (Uz_Globs *pG, int argc, char *argv[])
      */
 #   define UZ_SLIDE_CHUNK (sizeof(shrint)+sizeof(uch)+sizeof(uch))
 #   define UZ_NUMOF_CHUNKS \
-      (unsigned)(((WSIZE+UZ_SLIDE_CHUNK-1)/UZ_SLIDE_CHUNK > HSIZE) ? \
-                 (WSIZE+UZ_SLIDE_CHUNK-1)/UZ_SLIDE_CHUNK : HSIZE)
+      (unsigned)(((WSIZE+SLIDE_SLACK+UZ_SLIDE_CHUNK-1)/UZ_SLIDE_CHUNK > HSIZE) ? \
+                 (WSIZE+SLIDE_SLACK+UZ_SLIDE_CHUNK-1)/UZ_SLIDE_CHUNK : HSIZE)
     (*(Uz_Globs *)pG).area.Slide = (uch *)zcalloc(UZ_NUMOF_CHUNKS, UZ_SLIDE_CHUNK);
 #   undef UZ_SLIDE_CHUNK
 #   undef UZ_NUMOF_CHUNKS
@@ -980,6 +1007,12 @@ int uz_opts(
                     else
                         uO.fflag = uO.uflag = TRUE;
                     break;
+                case ('G'):    /* go through archive in zipfile order */
+                    if (negative)
+                        uO.G_flag = -1, negative = 0;
+                    else
+                        uO.G_flag = TRUE;
+                    break;
                 case ('h'):    /* just print help message and quit */
                     if (showhelp == 0) {
                         if (*s == 'h')
@@ -990,12 +1023,63 @@ int uz_opts(
                         }
                     }
                     break;
+                case ('H'):    /* inflate big members on several threads */
+                    if (negative) {
+                        uO.H_size = 0, negative = 0;
+                    } else {
+                        ulg size;
+
+                        if (get_sizearg(&argc, &argv, &s, &size) ||
+                            size == 0)
+                        {
+                            Info(slide, 0x401, ((char *)slide,
+                              LoadFarString(MustGiveSplitSize)));
+                            return(PK_PARAM);
+                        }
+                        uO.H_size = size;
+                    }
+                    break;
+                case ('I'):    /* fixed zipfile read size */
+                    if (negative) {
+                        uO.I_bufsiz = 0, negative = 0;
+                    } else {
+                        ulg bufsiz;
+
+                        if (get_sizearg(&argc, &argv, &s, &bufsiz) ||
+                            bufsiz < INBUFSIZ || bufsiz > MAXINBUFSIZ)
+                        {
+                            Info(slide, 0x401, ((char *)slide,
+                              LoadFarString(MustGiveBufSize),
+                              (ulg)INBUFSIZ, (ulg)MAXINBUFSIZ));
+                            return(PK_PARAM);
+                        }
+                        /* whole blocks only */
+                        uO.I_bufsiz = (unsigned)
+                          ((bufsiz + (INBUFSIZ-1)) / INBUFSIZ * INBUFSIZ);
+                    }
+                    break;
                 case ('j'):    /* junk pathnames/directory structure */
                     if (negative)
                         uO.jflag = FALSE, negative = 0;
                     else
                         uO.jflag = TRUE;
                     break;
+                case ('k'):    /* checkpoint index of deflated members */
+                    if (negative) {
+                        uO.k_size = 0, negative = 0;
+                    } else {
+                        ulg size;
+
+                        if (get_sizearg(&argc, &argv, &s, &size) ||
+                            size == 0)
+                        {
+                            Info(slide, 0x401, ((char *)slide,
+                              LoadFarString(MustGiveSpacing)));
+                            return(PK_PARAM);
+                        }
+                        uO.k_size = size;
+                    }
+                    break;
                 case ('l'):
                     if (negative) {
                         uO.vflag = MAX(uO.vflag-negative,0);
@@ -1026,6 +1110,28 @@ int uz_opts(
                         uO.qflag += 999;
                     }
                     break;
+                case ('r'):    /* a byte range of members to stdout */
+                    if (negative) {
+                        if (uO.r_flag) {
+                            uO.cflag = FALSE;
+                            uO.qflag = MAX(uO.qflag-999,0);
+                            uO.r_flag = FALSE;
+                        }
+                        negative = 0;
+                    } else {
+                        if (get_rangearg(&argc, &argv, &s, &uO.r_first,
+                                         &uO.r_last)) {
+                            Info(slide, 0x401, ((char *)slide,
+                              LoadFarString(MustGiveRange)));
+                            return(PK_PARAM);
+                        }
+                        if (!uO.r_flag) {   /* as -p */
+                            uO.cflag = TRUE;
+                            uO.qflag += 999;
+                            uO.r_flag = TRUE;
+                        }
+                    }
+                    break;
                 case ('q'):    /* quiet:  fewer comments/messages */
                     if (negative) {
                         uO.qflag = MAX(uO.qflag-negative,0);
@@ -1041,6 +1147,14 @@ int uz_opts(
                         uO.sflag = TRUE;
                     break;
 #endif /* DOS_FLX_NLM_OS2_W32 */
+#ifdef USE_SPARSE
+                case ('S'):    /* sparse output:  skip zero blocks */
+                    if (negative)
+                        uO.S_flag = FALSE, negative = 0;
+                    else
+                        uO.S_flag = TRUE;
+                    break;
+#endif
                 case ('t'):
                     if (negative)
                         uO.tflag = FALSE, negative = 0;
@@ -1080,6 +1194,23 @@ int uz_opts(
                     else
                         uO.vflag = 2;
                     break;
+                case ('w'):    /* extract on several threads */
+                    if (negative) {
+                        uO.w_threads = 0, negative = 0;
+                    } else {
+                        ulg nthreads;
+
+                        if (get_sizearg(&argc, &argv, &s, &nthreads) ||
+                            nthreads > MAX_THREADS)
+                        {
+                            Info(slide, 0x401, ((char *)slide,
+                              LoadFarString(MustGiveThreads),
+                              (unsigned)MAX_THREADS));
+                            return(PK_PARAM);
+                        }
+                        uO.w_threads = (nthreads ? (int)nthreads : -1);
+                    }
+                    break;
 #ifdef WILD_STOP_AT_DIR
                 case ('W'):    /* Wildcard interpretation (stop at '/'?) */
                     if (negative)
@@ -1262,6 +1393,108 @@ int usage(pG, error)   /* return PK-type error code */
 
 
 
+/**************************/
+/* Function get_sizearg() */
+/**************************/
+
+static int scan_size(arg, pend, pval)   /* return 1 if no size at arg */
+    char *arg;
+    char **pend;                        /* where the size ends */
+    ulg *pval;
+{
+    char *end;
+    ulg val;
+    int shift = 0;
+
+    if (!isdigit((uch)*arg))
+        return 1;
+    val = strtoul(arg, &end, 10);
+    switch (*end) {
+        case 'k':
+        case 'K':
+            shift = 10, ++end;
+            break;
+        case 'm':
+        case 'M':
+            shift = 20, ++end;
+            break;
+        case 'g':
+        case 'G':
+            shift = 30, ++end;
+            break;
+    }
+    if (val > (~(ulg)0 >> shift))
+        return 1;
+    *pval = val << shift;
+    *pend = end;
+    return 0;
+
+} /* end function scan_size() */
+
+
+
+
+
+static int get_sizearg(pargc, pargv, ps, pval)   /* return 1 if bad/missing */
+    int *pargc;
+    char ***pargv;
+    char **ps;
+    ulg *pval;
+{
+    char *arg = *ps, *end;
+
+    /* as for -d exdir, accept both "-I256k" and "-I 256k" */
+    if (*arg == '\0') {
+        if (*pargc <= 1)
+            return 1;
+        --*pargc;
+        arg = *++*pargv;
+    }
+    if (scan_size(arg, &end, pval) || *end != '\0')
+        return 1;
+    /* point the option scanner at the end of the argument */
+    *ps = end;
+    return 0;
+
+} /* end function get_sizearg() */
+
+
+
+
+
+static int get_rangearg(pargc, pargv, ps, pfirst, plast)   /* return 1 if */
+    int *pargc;                                             /* bad/missing */
+    char ***pargv;
+    char **ps;
+    ulg *pfirst, *plast;
+{
+    char *arg = *ps, *end;
+    ulg first, last = ~(ulg)0;
+
+    /* "first-last" or "first-" (to the end), byte offsets in the member */
+    if (*arg == '\0') {
+        if (*pargc <= 1)
+            return 1;
+        --*pargc;
+        arg = *++*pargv;
+    }
+    if (scan_size(arg, &end, &first) || *end++ != '-')
+        return 1;
+    if (*end != '\0' && (scan_size(end, &end, &last) || *end != '\0'))
+        return 1;
+    if (last < first)
+        return 1;
+    *pfirst = first;
+    *plast = last;
+    *ps = end;
+    return 0;
+
+} /* end function get_rangearg() */
+
+
+
+
+
 /* Print extended help to stdout. */
 static void help_extended(pG)
     Uz_Globs *pG;
@@ -1341,10 +1574,25 @@ static void help_extended(pG)
   "         restore.",
   "  -F   [Acorn] Suppress removal of NFS filetype extension.  [Non-Acorn if",
   "         ACORN_FTYPE_NFS] Translate filetype and append to name.",
+  "  -G   Process entries in the order they are stored in the archive rather",
+  "         than in central directory order even where unzip may prompt (the",
+  "         default where it cannot, except with -c or -p; --G:  never).",
+  "         Messages keep central directory order unless unzip may prompt.",
+  "  -H n [Unix] Inflate each deflated entry of n or more compressed bytes",
+  "         (k, m or g suffix allowed) on several threads (see -w), in parts",
+  "         that start where its blocks are guessed to start.  The data are",
+  "         inflated on one thread as usual where the guesses do not work out.",
   "  -i   [MacOS] Ignore filenames in MacOS extra field.  Instead, use name in",
   "         standard header.",
+  "  -I n Read the archive in blocks of n bytes (k or m suffix allowed).  By",
+  "         default, small blocks are read while scanning the central directory",
+  "         and large ones while reading the data of big entries.",
   "  -j   Junk paths and deposit all files in extraction directory.",
   "  -J   [BeOS] Junk file attributes.  [MacOS] Ignore MacOS specific info.",
+  "  -k n [Unix] Record a checkpoint about every n bytes (k, m or g suffix",
+  "         allowed) of output of the deflated entries tested or extracted,",
+  "         in an index kept next to the archive as archive.zix.  See -r.",
+  "         --k turns it off.",
   "  -K   [AtheOS, BeOS, Unix] Restore SUID/SGID/Tacky file attributes.",
   "  -L   Convert to lowercase any names from uppercase only file system.",
   "  -LL  Convert all files to lowercase.",
@@ -1356,14 +1604,23 @@ static void help_extended(pG)
   "  -P p Use password p to decrypt files.  THIS IS INSECURE!  Some OS show",
   "         command line to other users.",
   "  -q   Perform operations quietly.  The more q (as in -qq) the quieter.",
+  "  -r f-l Extract bytes f to l (f- to the end, both counted from 0) of",
+  "         entries to pipe, as -p does.  [Unix] Stored entries, and deflated",
+  "         ones from the closest checkpoint of the index (see -k) on, are",
+  "         only read as far as needed.  The CRC cannot be checked.",
   "  -s   [OS/2, NT, MS-DOS] Convert spaces in filenames to underscores.",
-  "  -S   [VMS] Convert text files (-a, -aa) into Stream_LF format.",
+  "  -S   [VMS] Convert text files (-a, -aa) into Stream_LF format.  [Unix]",
+  "         Leave blocks of zeros out of extracted files as holes (sparse",
+  "         files); the file size is unchanged.  Not for text conversion.",
   "  -U   [UNICODE enabled] Show non-local characters as #Uxxxx or #Lxxxxxx ASCII",
   "         text escapes where x is hex digit.  [Old] -U used to leave names",
   "         uppercase if created on MS-DOS, VMS, etc.  See -L.",
   "  -UU  [UNICODE enabled] Disable use of stored UTF-8 paths.  Note that UTF-8",
   "         paths stored as native local paths are still processed as Unicode.",
   "  -V   Retain VMS file version numbers.",
+  "  -w n [Unix] Extract or test members on n threads at once (0: one per",
+  "         CPU).  Only used when no questions can come up (-t, -o or -n).",
+  "         --w turns it off.",
   "  -W   [Only if WILD_STOP_AT_DIR] Modify pattern matching so ? and * do not",
   "         match directory separator /, but ** does.  Allows matching at specific",
   "         directory levels.",
@@ -1661,6 +1918,25 @@ static void show_version_info(Uz_Globs *pG)
           (char *)(slide+256)));
         ++numopts;
 #endif
+#ifdef EXT_INFLATE
+        sprintf((char *)(slide+256), LoadFarStringSmall(ExtInflate),
+          ext_inflate_name());
+        Info(slide, 0, ((char *)slide, LoadFarString(CompileOptFormat),
+          (char *)(slide+256)));
+        ++numopts;
+#endif
+#ifdef USE_PREALLOC
+        Info(slide, 0, ((char *)slide, LoadFarString(CompileOptFormat),
+          LoadFarStringSmall(UsePrealloc)));
+        ++numopts;
+#endif
+#ifdef USE_WRITEV
+        sprintf((char *)(slide+256), LoadFarStringSmall(UseWritev),
+          (unsigned long)(WRITE_BUFSIZE >> 10));
+        Info(slide, 0, ((char *)slide, LoadFarString(CompileOptFormat),
+          (char *)(slide+256)));
+        ++numopts;
+#endif
 #ifdef USE_BZIP2
         sprintf((char *)(slide+256), LoadFarStringSmall(UseBZip2),
           BZ2_bzlibVersion());
@@ -341,11 +341,15 @@ typedef struct _UzpOpts {
     int E_flag;         /* -E: [MacOS] show Mac extra field during restoring */
 #endif
     int fflag;          /* -f: "freshen" (extract only newer files) */
+    int G_flag;         /* -G: zipfile order even if prompting (--G: never) */
     int hflag;          /* -h: header line (zipinfo) */
+    ulg H_size;         /* -H: inflate members this large on threads (0: no) */
+    unsigned I_bufsiz;  /* -I: fixed zipfile read size (0: adaptive) */
 #ifdef MACOS
     int i_flag;         /* -i: [MacOS] ignore filenames stored in Mac e.f. */
 #endif
     int jflag;          /* -j: junk pathnames (unzip) */
+    ulg k_size;         /* -k: index checkpoints this far apart (0: none) */
 #if (defined(__ATHEOS__) || defined(__BEOS__) || defined(MACOS))
     int J_flag;         /* -J: ignore AtheOS/BeOS/MacOS e. f. info (unzip) */
 #endif
@@ -357,15 +361,17 @@ typedef struct _UzpOpts {
     int overwrite_none; /* -n: never overwrite files (no prompting) */
     int overwrite_all;  /* -o: OK to overwrite files without prompting */
     int qflag;          /* -q: produce a lot less output */
+    int r_flag;         /* -r: output only bytes r_first..r_last of members */
+    ulg r_first, r_last;
 #if (defined(MSDOS) || defined(FLEXOS) || defined(OS2) || defined(WIN32))
     int sflag;          /* -s: convert spaces in filenames to underscores */
 #endif
 #if (defined(NLM))
     int sflag;          /* -s: convert spaces in filenames to underscores */
 #endif
-#ifdef VMS
-    int S_flag;         /* -S: use Stream_LF for text files (-a[a]) */
-#endif
+#if (defined(VMS) || defined(UNIX))
+    int S_flag;         /* -S: [VMS] use Stream_LF for text files (-a[a]), */
+#endif                  /*     [Unix] leave zero blocks out as holes */
 #if (defined(MSDOS) || defined(__human68k__) || defined(OS2) || defined(WIN32))
     int volflag;        /* -$: extract volume labels */
 #endif
@@ -377,6 +383,7 @@ typedef struct _UzpOpts {
 #endif
     int vflag;          /* -v: (verbosely) list directory */
     int V_flag;         /* -V: don't strip VMS version numbers */
+    int w_threads;      /* -w: extract/test threads (0: one, <0: one per CPU) */
     int W_flag;         /* -W: wildcard '*' won't match '/' dir separator */
 #if (defined (__ATHEOS__) || defined(__BEOS__) || defined(UNIX))
     int X_flag;         /* -X: restore owner/protection or UID/GID or ACLs */
@@ -31,6 +31,24 @@
 #  define NO_DEFLATE64
 #endif
 
+/* Inflating by an outside library in extinfl.c, with inflate.c kept for
+ * Deflate64 and for whatever that library is not given (USE_ZLIB does all
+ * of it by zlib instead, and wins if both are asked for).
+ */
+#ifdef USE_ZLIB
+#  undef EXT_INFLATE_ZLIB
+#  undef EXT_INFLATE_ZLIBNG
+#  undef EXT_INFLATE_LIBDEFLATE
+#endif
+#if (defined(EXT_INFLATE_ZLIB) || defined(EXT_INFLATE_ZLIBNG) || \
+     defined(EXT_INFLATE_LIBDEFLATE))
+#  ifndef EXT_INFLATE
+#    define EXT_INFLATE
+#  endif
+#else
+#  undef EXT_INFLATE
+#endif
+
 #if (defined(NO_VMS_TEXT_CONV) || defined(VMS))
 #  ifdef VMS_TEXT_CONV
 #    undef VMS_TEXT_CONV
@@ -350,7 +368,11 @@
 #  define DATE_SEPCHAR  '-'
 #endif
 #ifndef CLOSE_INFILE
-#  define CLOSE_INFILE()  close((*(Uz_Globs *)pG).zipfd)
+#  if (defined(USE_MMAP_INPUT) || defined(USE_PREFETCH))
+#    define CLOSE_INFILE()  close_infile(pG)
+#  else
+#    define CLOSE_INFILE()  close((*(Uz_Globs *)pG).zipfd)
+#  endif
 #endif
 #ifndef RETURN
 #  define RETURN        return  /* only used in main() */
@@ -435,6 +457,12 @@
 
 
 # define DIR_BLKSIZ 16384   /* use more memory, to reduce long-range seeks */
+#ifndef MAX_THREADS          /* most extraction threads (-w) */
+#  define MAX_THREADS 256
+#endif
+#ifndef DIR_MAXENTRIES       /* info[] is grown up to this many entries;  */
+#  define DIR_MAXENTRIES 0x400000L  /* larger dirs are done in blocks */
+#endif
 
 #ifndef WSIZE
 #    define WSIZE   65536L  /* window size--must be a power of two, and */
@@ -442,6 +470,9 @@
        /* window size--must be a power of two, and */
                       /*  at least 32K for zip's deflate method */
 #endif
+#ifndef SLIDE_SLACK
+#  define SLIDE_SLACK 32    /* past the window, for copy_match() to overrun */
+#endif
 
 #if (defined(DYNALLOC_CRCTAB) && !defined(DYNAMIC_CRC_TABLE))
 #  undef DYNALLOC_CRCTAB
@@ -471,6 +502,24 @@
 #  endif
 #endif
 
+/* crc32() by slicing-by-16 (tables made at run time), and by carry-less
+ * multiplication on CPUs that have it (PCLMULQDQ, checked at run time) */
+#if (!defined(USE_ZLIB) && defined(DYNAMIC_CRC_TABLE))
+#  if (!defined(NO_CRC_SLICE16) && !defined(IZ_CRC_SLICE16))
+#    define IZ_CRC_SLICE16
+#  endif
+#endif
+#if (defined(IZ_CRC_SLICE16) && !defined(NO_CRC_PCLMUL))
+#  if (defined(__x86_64__) || defined(__i386__))
+#    if (defined(__clang__) || __GNUC__ > 4 || \
+         (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#      ifndef IZ_CRC_PCLMUL
+#        define IZ_CRC_PCLMUL
+#      endif
+#    endif
+#  endif
+#endif
+
 #ifndef INBUFSIZ
 #  if (defined(MED_MEM) || defined(SMALL_MEM))
 #    define INBUFSIZ  2048  /* works for MS-DOS small model */
@@ -478,6 +527,32 @@
 #    define INBUFSIZ  8192  /* larger buffers for real OSes */
 #  endif
 #endif
+/* INBUFSIZ is the block granularity (and the read size while walking the
+ * central directory); member data are streamed in reads of up to
+ * STRMINBUFSIZ bytes unless a fixed read size is given with -I */
+#ifndef STRMINBUFSIZ
+#  if (defined(MED_MEM) || defined(SMALL_MEM))
+#    define STRMINBUFSIZ  INBUFSIZ
+#  else
+#    define STRMINBUFSIZ  0x40000L      /* 256K */
+#  endif
+#endif
+#ifndef PREFETCH_BUFS
+#  define PREFETCH_BUFS   3     /* read-ahead ring:  1 in use + 2 ahead */
+#endif
+#ifndef READAHEAD_SLOTS
+#  define READAHEAD_SLOTS 8     /* member reads queued by queue_readahead() */
+#endif
+#ifndef READAHEAD_BLKMAX        /* largest read ahead by either, */
+#  define READAHEAD_BLKMAX 0x100000L    /*  whatever -I says */
+#endif
+#ifndef MAXINBUFSIZ
+#  if (defined(MED_MEM) || defined(SMALL_MEM))
+#    define MAXINBUFSIZ   INBUFSIZ
+#  else
+#    define MAXINBUFSIZ   0x4000000L    /* 64M:  upper limit for -I */
+#  endif
+#endif
 
 #    define LoadFarString(x)        (char *)(x)
 #    define LoadFarStringSmall(x)   (char *)(x)
@@ -1257,16 +1332,20 @@ typedef struct VMStimbuf {
        uch value[HSIZE];        /* 8KB */
        uch Stack[HSIZE];        /* 8KB */
      } shrink;                  /* total = 32KB minimum; 80KB on Cray/Alpha */
-     uch Slide[WSIZE];        /* explode(), inflate(), unreduce() */
+     uch Slide[WSIZE+SLIDE_SLACK]; /* explode(), inflate(), unreduce() */
    };
 #endif /* ?MALLOC_WORK */
 
 #define slide  (*(Uz_Globs *)pG).area.Slide
 
+/* redirSlack is true if redirSlide has SLIDE_SLACK bytes to spare at the end
+   (a redirect_buffer has not) */
 #if (defined(DLL) && !defined(NO_SLIDE_REDIR))
 #  define redirSlide (*(Uz_Globs *)pG).redirect_sldptr
+#  define redirSlack (!(*(Uz_Globs *)pG).redirect_slide)
 #else
 #  define redirSlide (*(Uz_Globs *)pG).area.Slide
+#  define redirSlack 1
 #endif
 
 /*---------------------------------------------------------------------------
@@ -1491,14 +1570,57 @@ void     fnprint                 ();
   ---------------------------------------------------------------------------*/
 
 int      open_input_file      ();
+#if (defined(USE_MMAP_INPUT) || defined(USE_PREFETCH))
+   int   close_infile         (Uz_Globs *pG);
+#endif
 int      open_outfile         ();
 void     undefer_input        ();
 void     defer_leftover_input ();
 unsigned readbuf              (Uz_Globs *pG, char *buf, register unsigned len);
 int      readbyte             ();
 int      fillinbuf            ();
+#ifdef USE_MMAP_INPUT
+   int   zipmap_covers        (Uz_Globs *pG, zoff_t offset, zoff_t len);
+   int   zipmap_faulted       (Uz_Globs *pG);
+#endif
+int      zipf_pread           (Uz_Globs *pG, uch *buf, unsigned size,
+                               zoff_t offset);
+int      fill_inbuf_at        (Uz_Globs *pG, zoff_t bufstart, unsigned size);
+void     set_inbufsiz         (Uz_Globs *pG, zusz_t streamlen);
+#ifdef USE_PREFETCH
+   void  prefetch_member      (Uz_Globs *pG);
+   void  prefetch_free        (Uz_Globs *pG);
+#endif
+#ifdef USE_IO_URING
+   int   queue_readahead      (Uz_Globs *pG, zoff_t start, zoff_t end);
+   void  submit_readahead     (Uz_Globs *pG);
+   void  drop_readahead       (Uz_Globs *pG);
+   void  free_readahead       (Uz_Globs *pG);
+#endif
 int      seek_zipf            (Uz_Globs *pG, zoff_t abs_offset);
    int   flush                (Uz_Globs *pG, uch *buf, ulg size, int unshrink);
+#ifdef USE_COPY_RANGE
+   int   copy_zipdata         (Uz_Globs *pG, zoff_t offset, zoff_t len,
+                               uch *buf, unsigned bufsize);
+#endif
+#ifdef USE_PREALLOC
+   void  prealloc_outfile     (Uz_Globs *pG);
+   void  trim_outfile         (Uz_Globs *pG);
+#endif
+#ifdef USE_SPARSE
+   void  sparse_outfile       (Uz_Globs *pG);
+   int   finish_sparse        (Uz_Globs *pG);
+#endif
+#ifdef USE_WRITEV
+   int   drain_outfile        (Uz_Globs *pG);
+#  ifdef USE_ASYNC_WRITE
+   void  free_writer          (Uz_Globs *pG);
+#  endif
+#endif
+#ifdef USE_MMAP_OUTPUT
+   int   map_outfile          (Uz_Globs *pG);
+   int   unmap_outfile        (Uz_Globs *pG);
+#endif
 /* static int  disk_error     (); */
 void     handler              (int signal);
 time_t   dos_to_unix_time     (ulg dos_datetime);
@@ -1565,6 +1687,8 @@ int    huft_free                 (struct huft *t);          /* inflate.c */
 int    huft_build                (Uz_Globs *pG, const unsigned *b, unsigned n,
                                      unsigned s, const ush *d, const uch *e,
                                      struct huft **t, unsigned *m);
+void   copy_match                (uch *out, const uch *from,
+                                     unsigned n);                /* inflate.c */
 #ifdef USE_ZLIB
    int    UZinflate              (Uz_Globs *pG, int is_defl64);  /* inflate.c */
 #  define inflate_free(x)        inflateEnd(&((Uz_Globs *)(&(*(Uz_Globs *)pG)))->dstrm)
@@ -1572,6 +1696,18 @@ int    huft_build                (Uz_Globs *pG, const unsigned *b, unsigned n,
    int    inflate                (Uz_Globs *pG, int is_defl64);  /* inflate.c */
    int    inflate_free           ();                  /* inflate.c */
 #endif /* ?USE_ZLIB */
+#ifdef EXT_INFLATE
+   int    ext_inflate            (Uz_Globs *pG, int is_defl64);  /* extinfl.c */
+   const char *ext_inflate_name  (void);                    /* extinfl.c */
+#endif
+#ifdef USE_PAR_INFLATE
+   int    par_inflate            (Uz_Globs *pG, int is_defl64);  /* parinfl.c */
+#endif
+#ifdef USE_INFLATE_INDEX
+   int    index_inflate          (Uz_Globs *pG, int is_defl64);  /* parinfl.c */
+   int    range_member           (Uz_Globs *pG);                 /* parinfl.c */
+   int    index_end              (Uz_Globs *pG);                 /* parinfl.c */
+#endif
 #ifndef COPYRIGHT_CLEAN
    int    unreduce               ();                 /* unreduce.c */
 /* static void  LoadFollowers    OF((Uz_Globs *pG, f_array *follower, uch *Slen));
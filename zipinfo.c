@@ -693,6 +693,7 @@ zipinfo (   /* return PK-type error code */
     int *fn_matched=NULL, *xn_matched=NULL;
     ulg j, members=0L;
     zusz_t tot_csize=0L, tot_ucsize=0L;
+    min_info info;
     zusz_t endprev;   /* buffers end of previous entry for zi_long()'s check
                        *  of extra bytes */
 
@@ -725,7 +726,7 @@ zipinfo (   /* return PK-type error code */
   ---------------------------------------------------------------------------*/
 
     uO.L_flag = FALSE;      /* zipinfo mode: never convert name to lowercase */
-    (*(Uz_Globs *)pG).pInfo = (*(Uz_Globs *)pG).info;       /* (re-)initialize, (just to make sure) */
+    (*(Uz_Globs *)pG).pInfo = &info;       /* (re-)initialize, (just to make sure) */
     (*(Uz_Globs *)pG).pInfo->textmode = 0;  /* so one can read on screen (is this ever used?) */
 
     /* reset endprev for new zipfile; account for multi-part archives (?) */